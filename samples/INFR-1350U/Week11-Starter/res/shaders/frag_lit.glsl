@@ -0,0 +1,88 @@
+#version 410
+
+// Textured Blinn-Phong lighting, using the material's diffuse, second diffuse and specular maps
+#pragma variant LIGHTING
+// Mixes in a reflection of the environment map, by the reflectivity map if lighting is enabled (otherwise it's fully reflective)
+#pragma variant REFLECTIVE
+
+layout(location = 0) in vec3 inPos;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec3 inNormal;
+layout(location = 3) in vec2 inUV;
+
+#ifdef LIGHTING
+uniform sampler2D s_Diffuse;
+uniform sampler2D s_Diffuse2;
+uniform sampler2D s_Specular;
+#endif
+#ifdef REFLECTIVE
+uniform samplerCube s_Environment;
+#endif
+#if defined(LIGHTING) && defined(REFLECTIVE)
+uniform sampler2D s_Reflectivity;
+#endif
+
+#if defined(LIGHTING) || defined(REFLECTIVE)
+// Values that each material sets, see ShaderMaterial
+layout (std140) uniform b_Material {
+#ifdef REFLECTIVE
+	mat3  u_EnvironmentRotation;
+#endif
+#ifdef LIGHTING
+	vec3  u_AmbientCol;
+	float u_AmbientStrength;
+
+	vec3  u_LightPos;
+	vec3  u_LightCol;
+	float u_AmbientLightStrength;
+	float u_SpecularLightStrength;
+	float u_Shininess;
+	float u_LightAttenuationConstant;
+	float u_LightAttenuationLinear;
+	float u_LightAttenuationQuadratic;
+
+	float u_TextureMix;
+#endif
+};
+#endif
+
+uniform vec3  u_CamPos;
+
+out vec4 frag_color;
+
+#ifdef LIGHTING
+#include "include/blinn_phong.glsl"
+#endif
+
+void main() {
+	vec3 N = normalize(inNormal);
+	vec4 color = vec4(inColor, 1.0);
+
+#ifdef LIGHTING
+	// Get the albedo from the diffuse / albedo map
+	vec4 textureColor1 = texture(s_Diffuse, inUV);
+	vec4 textureColor2 = texture(s_Diffuse2, inUV);
+	vec4 textureColor = mix(textureColor1, textureColor2, u_TextureMix);
+
+	// Get the specular power from the specular map
+	float texSpec = texture(s_Specular, inUV).x;
+
+	color = vec4(CalcBlinnPhong(inPos, N, texSpec) * inColor * textureColor.rgb, textureColor.a);
+#endif
+
+#ifdef REFLECTIVE
+	// Calculate the reflected normal, and look up the environment texture
+	vec3 toEye = normalize(inPos - u_CamPos);
+	vec3 reflected = reflect(toEye, N);
+	vec3 environment = texture(s_Environment, u_EnvironmentRotation * reflected).rgb;
+
+	#ifdef LIGHTING
+	color.rgb = mix(color.rgb, environment, texture(s_Reflectivity, inUV).r);
+	#else
+	// Without lighting we're fully reflective!
+	color = vec4(environment, 1.0);
+	#endif
+#endif
+
+	frag_color = color;
+}
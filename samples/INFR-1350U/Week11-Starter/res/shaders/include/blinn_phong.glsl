@@ -0,0 +1,32 @@
+// Blinn-Phong lighting for our single point light, the light values come from the material block
+// https://learnopengl.com/Advanced-Lighting/Advanced-Lighting
+// NEW in week 7, see https://learnopengl.com/Lighting/Light-casters for a good reference on how the attenuation works, or
+// https://developer.valvesoftware.com/wiki/Constant-Linear-Quadratic_Falloff
+vec3 CalcBlinnPhong(vec3 pos, vec3 N, float specularStrength) {
+	// Lecture 5
+	vec3 ambient = u_AmbientLightStrength * u_LightCol;
+
+	// Diffuse
+	vec3 lightDir = normalize(u_LightPos - pos);
+
+	float dif = max(dot(N, lightDir), 0.0);
+	vec3 diffuse = dif * u_LightCol;// add diffuse intensity
+
+	//Attenuation
+	float dist = length(u_LightPos - pos);
+	float attenuation = 1.0f / (
+		u_LightAttenuationConstant + 
+		u_LightAttenuationLinear * dist +
+		u_LightAttenuationQuadratic * dist * dist);
+
+	// Specular
+	vec3 viewDir  = normalize(u_CamPos - pos);
+	vec3 h        = normalize(lightDir + viewDir);
+
+	float spec = pow(max(dot(N, h), 0.0), u_Shininess); // Shininess coefficient (can be a uniform)
+	vec3 specular = u_SpecularLightStrength * specularStrength * spec * u_LightCol; // Can also use a specular color
+
+	return 
+		(u_AmbientCol * u_AmbientStrength) + // global ambient light
+		(ambient + diffuse + specular) * attenuation; // light factors from our single light
+}
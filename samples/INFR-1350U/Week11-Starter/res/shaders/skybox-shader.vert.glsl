@@ -5,7 +5,10 @@ layout(location = 0) in vec3 inPosition;
 layout(location = 0) out vec3 outNormal;
 
 uniform mat4 u_SkyboxMatrix;
-uniform mat3 u_EnvironmentRotation;
+// Values that each material sets, see ShaderMaterial
+layout (std140) uniform b_Material {
+	mat3 u_EnvironmentRotation;
+};
 
 void main() {
     vec4 pos = u_SkyboxMatrix * vec4(inPosition, 1.0);
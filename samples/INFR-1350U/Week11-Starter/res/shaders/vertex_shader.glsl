@@ -1,4 +1,6 @@
-#version 410
+#version 450
+// Lets us use gl_BaseInstanceARB to find which object we are drawing
+#extension GL_ARB_shader_draw_parameters : require
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
@@ -10,23 +12,33 @@ layout(location = 1) out vec3 outColor;
 layout(location = 2) out vec3 outNormal;
 layout(location = 3) out vec2 outUV;
 
-uniform mat4 u_ModelViewProjection;
+// The per-object data for everything drawn this frame, must match ObjectData in RenderQueue.h
+struct ObjectData {
+	mat4 Model;
+	mat3 NormalMatrix;
+};
+layout(std430, binding = 0) readonly buffer b_Objects {
+	ObjectData u_Objects[];
+};
+
+uniform mat4 u_ViewProjection;
 uniform mat4 u_View;
-uniform mat4 u_Model;
-uniform mat3 u_NormalMatrix;
 uniform vec3 u_LightPos;
 
 
 void main() {
-
-	gl_Position = u_ModelViewProjection * vec4(inPosition, 1.0);
+	// The base instance of the draw call is the index of our object in the buffer
+	ObjectData object = u_Objects[gl_BaseInstanceARB + gl_InstanceID];
 
 	// Lecture 5
 	// Pass vertex pos in world space to frag shader
-	outPos = (u_Model * vec4(inPosition, 1.0)).xyz;
+	vec4 worldPos = object.Model * vec4(inPosition, 1.0);
+	outPos = worldPos.xyz;
+
+	gl_Position = u_ViewProjection * worldPos;
 
 	// Normals
-	outNormal = u_NormalMatrix * inNormal;
+	outNormal = object.NormalMatrix * inNormal;
 
 	// Pass our UV coords to the fragment shader
 	outUV = inUV;
@@ -12,6 +12,9 @@ public:
 		_nextPointIx(0) { }
 	~FollowPathBehaviour() override = default;
 
+	// We only move our own transform, so we can be updated in parallel
+	static constexpr bool IsThreadSafe = true;
+
 	std::vector<glm::vec3> Points;
 	float                  Speed;
 
@@ -0,0 +1,19 @@
+#include "BehaviourSystem.h"
+
+#include <chrono>
+
+std::vector<BehaviourSystem::PoolUpdater> BehaviourSystem::_updaters;
+BehaviourSystem::Stats BehaviourSystem::_stats = { 0, 0, 0.0 };
+
+void BehaviourSystem::Update(entt::registry& registry) {
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	_stats.Types = _updaters.size();
+	_stats.Behaviours = 0;
+	// Iterate by index, a behaviour may bind a type we haven't seen yet during it's update
+	for (size_t ix = 0; ix < _updaters.size(); ix++) {
+		_stats.Behaviours += _updaters[ix](registry);
+	}
+
+	_stats.UpdateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
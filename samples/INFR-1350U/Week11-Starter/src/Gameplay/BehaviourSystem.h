@@ -0,0 +1,167 @@
+#pragma once
+#include <algorithm>
+#include <entt.hpp>
+#include <vector>
+
+#include "Logging.h"
+#include "Scene.h"
+#include "Utilities/ThreadPool.h"
+
+/// <summary>
+/// Updates the behaviours in a scene. Each behaviour type is stored in it's own entt pool, so all of the behaviours
+/// of one type sit next to each other in memory and are updated together in a single loop. Since the loop knows
+/// the concrete type, the Update call does not need to go through the vtable.
+///
+/// Behaviour types that declare IsThreadSafe = true are spread across the thread pool. Only do this for behaviours
+/// that touch nothing but their own state and their own entity's Transform
+///
+/// Types are registered automatically the first time they are bound with BehaviourBinding, and are updated in the
+/// order they were registered
+///
+/// A behaviour's Update may bind and unbind behaviours of any type, including it's own, as long as it goes through
+/// BehaviourBinding. New behaviours of the type being updated are not updated until the next frame, and unbinding one
+/// only disables it until the loop over it's type is finished. Removing a behaviour of the type being updated any other
+/// way (ex: entity.remove or destroying the entity) is not allowed, since the pool would swap another behaviour into
+/// the slot the loop is on. Thread safe behaviours may not bind or unbind behaviours of their own type at all
+/// </summary>
+class BehaviourSystem
+{
+public:
+	/// <summary>
+	/// Statistics from the last call to Update
+	/// </summary>
+	struct Stats {
+		size_t Types;
+		size_t Behaviours;
+		double UpdateMs;
+	};
+
+	/// <summary>
+	/// Registers a behaviour type to be updated, and lets the scene copy it when stamping prefabs. Safe to call more than once
+	/// </summary>
+	template <typename T>
+	static void RegisterType() {
+		static bool isRegistered = false;
+		if (!isRegistered) {
+			isRegistered = true;
+			_updaters.push_back(&_UpdatePool<T>);
+			GameScene::RegisterComponentType<T>();
+		}
+	}
+
+	/// <summary>
+	/// Invokes Update on every enabled behaviour in the registry, one type at a time
+	/// </summary>
+	/// <param name="registry">The registry containing the behaviours to update</param>
+	static void Update(entt::registry& registry);
+
+	/// <summary>
+	/// Gets the stats for the last update
+	/// </summary>
+	static const Stats& GetStats() { return _stats; }
+
+	/// <summary>
+	/// Checks whether the behaviours of type T in the given registry are being updated right now
+	/// </summary>
+	template <typename T>
+	static bool IsUpdating(const entt::registry& registry) { return PoolState<T>::Updating == &registry; }
+
+	/// <summary>
+	/// Queues up a behaviour to be removed from an entity once the loop over it's type is done, see BehaviourBinding::Unbind
+	/// </summary>
+	/// <param name="entity">The entity to remove the T from, in the registry that is being updated</param>
+	/// <returns>True if the removal was queued, false if it was already queued</returns>
+	template <typename T>
+	static bool DeferRemove(entt::entity entity) {
+		LOG_ASSERT(!T::IsThreadSafe, "Thread safe behaviours can not be unbound while their type is updating!");
+		std::vector<entt::entity>& pending = PoolState<T>::PendingRemovals;
+		if (std::find(pending.begin(), pending.end(), entity) != pending.end()) {
+			return false;
+		}
+		pending.push_back(entity);
+		return true;
+	}
+
+	/// <summary>
+	/// Cancels a removal queued with DeferRemove, for when a behaviour is bound again in the same update
+	/// </summary>
+	/// <param name="entity">The entity that the T was going to be removed from</param>
+	/// <returns>True if a removal was cancelled, false if none was queued</returns>
+	template <typename T>
+	static bool CancelRemove(entt::entity entity) {
+		std::vector<entt::entity>& pending = PoolState<T>::PendingRemovals;
+		auto it = std::find(pending.begin(), pending.end(), entity);
+		if (it == pending.end()) {
+			return false;
+		}
+		pending.erase(it);
+		return true;
+	}
+
+protected:
+	BehaviourSystem() = default;
+	~BehaviourSystem() = default;
+
+	typedef size_t(*PoolUpdater)(entt::registry& registry);
+
+	// Behaviours are handed to the workers in batches, so that grabbing work costs far less than the updates
+	static constexpr size_t BATCH_SIZE = 1024;
+
+	static std::vector<PoolUpdater> _updaters;
+	static Stats _stats;
+
+	/// <summary>
+	/// Tracks which registry a behaviour type is being updated in, and the behaviours unbound during that update
+	/// </summary>
+	template <typename T>
+	struct PoolState {
+		inline static const entt::registry* Updating = nullptr;
+		inline static std::vector<entt::entity> PendingRemovals;
+	};
+
+	/// <summary>
+	/// Updates all of the behaviours of a single type, returning how many there were
+	/// </summary>
+	template <typename T>
+	static size_t _UpdatePool(entt::registry& registry) {
+		const size_t count = registry.size<T>();
+		if (count == 0) {
+			return 0;
+		}
+		PoolState<T>::Updating = &registry;
+
+		// Calling T::Update directly skips the virtual dispatch, since we already know the exact type
+		if constexpr (T::IsThreadSafe) {
+			// These can't change the pool, so we can hold on to it's arrays
+			T* behaviours = registry.raw<T>();
+			const entt::entity* entities = registry.data<T>();
+			const size_t batches = (count + BATCH_SIZE - 1) / BATCH_SIZE;
+			ThreadPool::Instance().ParallelFor(batches, [&](size_t batch) {
+				const size_t end = std::min(count, (batch + 1) * BATCH_SIZE);
+				for (size_t ix = batch * BATCH_SIZE; ix < end; ix++) {
+					if (behaviours[ix].Enabled) {
+						behaviours[ix].T::Update(entt::handle(registry, entities[ix]));
+					}
+				}
+			});
+		} else {
+			// Binding a T can grow the pool and move it, so we look the arrays up again for every behaviour. Anything bound
+			// during the loop lands past count, and removals are held back until the end, so the indices stay put
+			for (size_t ix = 0; ix < count; ix++) {
+				T& behaviour = registry.raw<T>()[ix];
+				if (behaviour.Enabled) {
+					behaviour.T::Update(entt::handle(registry, registry.data<T>()[ix]));
+				}
+			}
+		}
+
+		PoolState<T>::Updating = nullptr;
+		for (entt::entity entity : PoolState<T>::PendingRemovals) {
+			if (registry.valid(entity) && registry.has<T>(entity)) {
+				registry.remove<T>(entity);
+			}
+		}
+		PoolState<T>::PendingRemovals.clear();
+		return count;
+	}
+};
@@ -0,0 +1,268 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+
+#include "Logging.h"
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(float margin) :
+	_root(NULL_NODE),
+	_freeList(NULL_NODE),
+	_proxyCount(0),
+	_margin(margin)
+{ }
+
+int32_t BoundingVolumeHierarchy::_AllocateNode() {
+	if (_freeList == NULL_NODE) {
+		_nodes.emplace_back();
+		_freeList = static_cast<int32_t>(_nodes.size() - 1);
+		_nodes[_freeList].Parent = NULL_NODE;
+	}
+	const int32_t node = _freeList;
+	_freeList = _nodes[node].Parent;
+	_nodes[node].Parent = NULL_NODE;
+	_nodes[node].Child1 = NULL_NODE;
+	_nodes[node].Child2 = NULL_NODE;
+	_nodes[node].Height = 0;
+	_nodes[node].UserData = 0;
+	return node;
+}
+
+void BoundingVolumeHierarchy::_FreeNode(int32_t node) {
+	_nodes[node].Parent = _freeList;
+	_nodes[node].Height = -1;
+	_freeList = node;
+}
+
+int32_t BoundingVolumeHierarchy::Insert(const AABB& bounds, uint32_t userData) {
+	const int32_t proxy = _AllocateNode();
+	_nodes[proxy].Bounds = AABB(bounds.Min - glm::vec3(_margin), bounds.Max + glm::vec3(_margin));
+	_nodes[proxy].UserData = userData;
+	_InsertLeaf(proxy);
+	_proxyCount++;
+	return proxy;
+}
+
+void BoundingVolumeHierarchy::Remove(int32_t proxy) {
+	LOG_ASSERT(proxy >= 0 && proxy < (int32_t)_nodes.size() && _nodes[proxy].IsLeaf(), "Invalid BVH proxy!");
+	_RemoveLeaf(proxy);
+	_FreeNode(proxy);
+	_proxyCount--;
+}
+
+bool BoundingVolumeHierarchy::Move(int32_t proxy, const AABB& bounds) {
+	LOG_ASSERT(proxy >= 0 && proxy < (int32_t)_nodes.size() && _nodes[proxy].IsLeaf(), "Invalid BVH proxy!");
+	if (_nodes[proxy].Bounds.Contains(bounds)) {
+		return false;
+	}
+	_RemoveLeaf(proxy);
+	_nodes[proxy].Bounds = AABB(bounds.Min - glm::vec3(_margin), bounds.Max + glm::vec3(_margin));
+	_InsertLeaf(proxy);
+	return true;
+}
+
+void BoundingVolumeHierarchy::_InsertLeaf(int32_t leaf) {
+	if (_root == NULL_NODE) {
+		_root = leaf;
+		_nodes[leaf].Parent = NULL_NODE;
+		return;
+	}
+
+	// Walk down the tree to find the best sibling for the leaf. At each node we can either pair the leaf with the
+	// node itself, or push it down into one of the children, and we pick whichever grows the total surface area least
+	const AABB leafBounds = _nodes[leaf].Bounds;
+	int32_t index = _root;
+	while (!_nodes[index].IsLeaf()) {
+		const Node& node = _nodes[index];
+		const float area = node.Bounds.GetSurfaceArea();
+		const float combinedArea = AABB::Union(node.Bounds, leafBounds).GetSurfaceArea();
+
+		// The cost of making a new parent for this node and the leaf
+		const float cost = 2.0f * combinedArea;
+		// Pushing the leaf further down will grow this node's box by at least this much
+		const float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto descendCost = [&](int32_t child) {
+			const AABB& childBounds = _nodes[child].Bounds;
+			const float childArea = AABB::Union(childBounds, leafBounds).GetSurfaceArea();
+			return (_nodes[child].IsLeaf() ? childArea : childArea - childBounds.GetSurfaceArea()) + inheritanceCost;
+		};
+		const float cost1 = descendCost(node.Child1);
+		const float cost2 = descendCost(node.Child2);
+
+		if (cost < cost1 && cost < cost2) {
+			break;
+		}
+		index = cost1 < cost2 ? node.Child1 : node.Child2;
+	}
+	const int32_t sibling = index;
+
+	// Make a new parent for the sibling and the leaf, in the sibling's old spot
+	const int32_t oldParent = _nodes[sibling].Parent;
+	const int32_t newParent = _AllocateNode();
+	_nodes[newParent].Parent = oldParent;
+	_nodes[newParent].Bounds = AABB::Union(leafBounds, _nodes[sibling].Bounds);
+	_nodes[newParent].Height = _nodes[sibling].Height + 1;
+	_nodes[newParent].Child1 = sibling;
+	_nodes[newParent].Child2 = leaf;
+	_nodes[sibling].Parent = newParent;
+	_nodes[leaf].Parent = newParent;
+
+	if (oldParent != NULL_NODE) {
+		if (_nodes[oldParent].Child1 == sibling) {
+			_nodes[oldParent].Child1 = newParent;
+		} else {
+			_nodes[oldParent].Child2 = newParent;
+		}
+	} else {
+		_root = newParent;
+	}
+
+	_RefitFrom(_nodes[leaf].Parent);
+}
+
+void BoundingVolumeHierarchy::_RemoveLeaf(int32_t leaf) {
+	if (leaf == _root) {
+		_root = NULL_NODE;
+		return;
+	}
+
+	// The leaf's parent goes away, and the leaf's sibling takes it's place
+	const int32_t parent = _nodes[leaf].Parent;
+	const int32_t grandParent = _nodes[parent].Parent;
+	const int32_t sibling = _nodes[parent].Child1 == leaf ? _nodes[parent].Child2 : _nodes[parent].Child1;
+
+	if (grandParent != NULL_NODE) {
+		if (_nodes[grandParent].Child1 == parent) {
+			_nodes[grandParent].Child1 = sibling;
+		} else {
+			_nodes[grandParent].Child2 = sibling;
+		}
+		_nodes[sibling].Parent = grandParent;
+		_FreeNode(parent);
+		_RefitFrom(grandParent);
+	} else {
+		_root = sibling;
+		_nodes[sibling].Parent = NULL_NODE;
+		_FreeNode(parent);
+	}
+}
+
+void BoundingVolumeHierarchy::_RefitFrom(int32_t node) {
+	for (int32_t index = node; index != NULL_NODE; index = _nodes[index].Parent) {
+		index = _Balance(index);
+		Node& current = _nodes[index];
+		const Node& child1 = _nodes[current.Child1];
+		const Node& child2 = _nodes[current.Child2];
+		current.Height = 1 + std::max(child1.Height, child2.Height);
+		current.Bounds = AABB::Union(child1.Bounds, child2.Bounds);
+	}
+}
+
+int32_t BoundingVolumeHierarchy::_Balance(int32_t iA) {
+	Node& a = _nodes[iA];
+	if (a.IsLeaf() || a.Height < 2) {
+		return iA;
+	}
+
+	const int32_t iB = a.Child1;
+	const int32_t iC = a.Child2;
+	Node& b = _nodes[iB];
+	Node& c = _nodes[iC];
+	const int32_t balance = c.Height - b.Height;
+
+	// Moves node iUp (one of A's children) into A's place, with A becoming it's first child. A keeps it's other child
+	// (iKeep), and takes whichever of iUp's children is shorter, the taller one stays with iUp
+	auto rotateUp = [&](int32_t iUp, int32_t iKeep, bool upWasChild1) {
+		Node& up = _nodes[iUp];
+		const int32_t iF = up.Child1;
+		const int32_t iG = up.Child2;
+		Node& f = _nodes[iF];
+		Node& g = _nodes[iG];
+
+		up.Child1 = iA;
+		up.Parent = a.Parent;
+		a.Parent = iUp;
+		if (up.Parent != NULL_NODE) {
+			Node& parent = _nodes[up.Parent];
+			if (parent.Child1 == iA) {
+				parent.Child1 = iUp;
+			} else {
+				parent.Child2 = iUp;
+			}
+		} else {
+			_root = iUp;
+		}
+
+		const int32_t iTall = f.Height > g.Height ? iF : iG;
+		const int32_t iShort = f.Height > g.Height ? iG : iF;
+		up.Child2 = iTall;
+		if (upWasChild1) {
+			a.Child1 = iShort;
+		} else {
+			a.Child2 = iShort;
+		}
+		_nodes[iShort].Parent = iA;
+
+		const Node& keep = _nodes[iKeep];
+		a.Bounds = AABB::Union(keep.Bounds, _nodes[iShort].Bounds);
+		a.Height = 1 + std::max(keep.Height, _nodes[iShort].Height);
+		up.Bounds = AABB::Union(a.Bounds, _nodes[iTall].Bounds);
+		up.Height = 1 + std::max(a.Height, _nodes[iTall].Height);
+		return iUp;
+	};
+
+	if (balance > 1) {
+		return rotateUp(iC, iB, false);
+	}
+	if (balance < -1) {
+		return rotateUp(iB, iC, true);
+	}
+	return iA;
+}
+
+size_t BoundingVolumeHierarchy::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const {
+	if (_root == NULL_NODE) {
+		return 0;
+	}
+
+	size_t tested = 0;
+	// The tree is kept balanced, so it's height is small and a fixed stack is plenty
+	int32_t stack[256];
+	int32_t top = 0;
+	stack[top++] = _root;
+	while (top > 0) {
+		const int32_t index = stack[--top];
+		const Node& node = _nodes[index];
+		tested++;
+
+		const Frustum::TestResult result = frustum.Test(node.Bounds);
+		if (result == Frustum::TestResult::Outside) {
+			continue;
+		}
+		if (node.IsLeaf()) {
+			results.push_back(node.UserData);
+		} else if (result == Frustum::TestResult::Inside) {
+			_CollectLeaves(index, results);
+		} else {
+			LOG_ASSERT(top + 2 <= 256, "BVH is too deep to query!");
+			stack[top++] = node.Child1;
+			stack[top++] = node.Child2;
+		}
+	}
+	return tested;
+}
+
+void BoundingVolumeHierarchy::_CollectLeaves(int32_t node, std::vector<uint32_t>& results) const {
+	int32_t stack[256];
+	int32_t top = 0;
+	stack[top++] = node;
+	while (top > 0) {
+		const Node& current = _nodes[stack[--top]];
+		if (current.IsLeaf()) {
+			results.push_back(current.UserData);
+		} else {
+			stack[top++] = current.Child1;
+			stack[top++] = current.Child2;
+		}
+	}
+}
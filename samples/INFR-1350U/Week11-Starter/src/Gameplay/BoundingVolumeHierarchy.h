@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Frustum.h"
+#include "Utilities/Bounds.h"
+
+/// <summary>
+/// A dynamic bounding volume hierarchy (an AABB tree), for quickly finding which objects are inside of a frustum.
+/// Objects can be added, removed and moved at any time, and the tree is kept balanced with tree rotations as it
+/// changes, similar to Box2D's b2DynamicTree.
+///
+/// Each leaf stores a slightly bigger ("fat") box than the object it holds, so objects that move a little bit don't
+/// need to touch the tree at all. When an object leaves it's fat box it's removed and re-inserted, refitting the
+/// boxes of all the nodes above it
+/// </summary>
+class BoundingVolumeHierarchy final
+{
+public:
+	static constexpr int32_t NULL_NODE = -1;
+
+	/// <summary>
+	/// Creates an empty tree
+	/// </summary>
+	/// <param name="margin">How far (in world units) to grow each object's box by, so that small movements don't need to update the tree</param>
+	BoundingVolumeHierarchy(float margin = 0.1f);
+	~BoundingVolumeHierarchy() = default;
+
+	/// <summary>
+	/// Adds an object to the tree
+	/// </summary>
+	/// <param name="bounds">The world space bounds of the object</param>
+	/// <param name="userData">A value to return from queries when this object is found (ex: an entity ID)</param>
+	/// <returns>The ID of the proxy for this object, for moving or removing it later</returns>
+	int32_t Insert(const AABB& bounds, uint32_t userData);
+	/// <summary>
+	/// Removes an object from the tree
+	/// </summary>
+	/// <param name="proxy">The proxy ID returned by Insert</param>
+	void Remove(int32_t proxy);
+	/// <summary>
+	/// Updates the bounds of an object in the tree
+	/// </summary>
+	/// <param name="proxy">The proxy ID returned by Insert</param>
+	/// <param name="bounds">The new world space bounds of the object</param>
+	/// <returns>True if the tree had to change, false if the object was still inside of it's fat box</returns>
+	bool Move(int32_t proxy, const AABB& bounds);
+
+	/// <summary>
+	/// Finds all of the objects whose fat boxes touch the frustum. Subtrees that are completely inside of the frustum
+	/// are added without testing any of their children
+	/// </summary>
+	/// <param name="frustum">The frustum to test against</param>
+	/// <param name="results">The list to append the user data of each visible object to</param>
+	/// <returns>The number of nodes that were tested against the frustum</returns>
+	size_t QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const;
+
+	/// <summary>
+	/// Gets the user data for a proxy
+	/// </summary>
+	uint32_t GetUserData(int32_t proxy) const { return _nodes[proxy].UserData; }
+	/// <summary>
+	/// Gets the fat box stored for a proxy
+	/// </summary>
+	const AABB& GetFatBounds(int32_t proxy) const { return _nodes[proxy].Bounds; }
+	/// <summary>
+	/// Gets the number of objects in the tree
+	/// </summary>
+	size_t GetProxyCount() const { return _proxyCount; }
+	/// <summary>
+	/// Gets the height of the tree, 0 if it's empty or has a single object
+	/// </summary>
+	int32_t GetHeight() const { return _root != NULL_NODE ? _nodes[_root].Height : 0; }
+
+private:
+	struct Node {
+		AABB     Bounds;
+		// The parent of this node, or the next free node if this node is in the free list
+		int32_t  Parent;
+		int32_t  Child1;
+		int32_t  Child2;
+		// Leaves have a height of 0, free nodes have a height of -1
+		int32_t  Height;
+		uint32_t UserData;
+
+		bool IsLeaf() const { return Child1 == NULL_NODE; }
+	};
+
+	std::vector<Node> _nodes;
+	int32_t _root;
+	int32_t _freeList;
+	size_t  _proxyCount;
+	float   _margin;
+
+	int32_t _AllocateNode();
+	void _FreeNode(int32_t node);
+	void _InsertLeaf(int32_t leaf);
+	void _RemoveLeaf(int32_t leaf);
+	/// <summary>
+	/// Recalculates the bounds and heights of every node from the given node to the root, balancing them on the way up
+	/// </summary>
+	void _RefitFrom(int32_t node);
+	/// <summary>
+	/// Rotates the tree at the given node if one side is more than one level taller than the other, returning the
+	/// node that is now in it's place
+	/// </summary>
+	int32_t _Balance(int32_t node);
+	void _CollectLeaves(int32_t node, std::vector<uint32_t>& results) const;
+};
@@ -0,0 +1,232 @@
+#include "CullingSystem.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "BoundingVolumeHierarchy.h"
+#include "Frustum.h"
+#include "OccluderComponent.h"
+#include "OcclusionBuffer.h"
+#include "RendererComponent.h"
+#include "Transform.h"
+#include "Utilities/ThreadPool.h"
+
+namespace {
+	// The culling state for a registry, stored in the registry's context
+	struct CullingContext {
+		BoundingVolumeHierarchy   Tree;
+		// Renderers without bounds, which are always visible
+		std::vector<entt::entity> Unbounded;
+		std::vector<entt::entity> Visible;
+		std::vector<uint32_t>     Found;
+		std::vector<entt::entity> NewRenderers;
+		OcclusionBuffer           Occlusion;
+		std::vector<uint8_t>      Hidden;
+		CullingSystem::Stats      Stats = {};
+		bool                      IsEnabled = true;
+		bool                      IsOcclusionEnabled = false;
+	};
+
+	/*
+	 * Adds a proxy to either the tree or the unbounded list, depending on whether the renderer's mesh has bounds and
+	 * whether the renderer can be culled
+	 */
+	void AddProxy(CullingContext& context, entt::entity entity, CullingProxy& proxy, const RendererComponent& renderer, const Transform& transform) {
+		proxy.Mesh = renderer.Mesh.get();
+		proxy.WorldVersion = transform.GetWorldVersion();
+		proxy.IsNeverCulled = renderer.IsNeverCulled;
+		if (!renderer.IsNeverCulled && renderer.Mesh != nullptr && renderer.Mesh->HasBounds()) {
+			proxy.Node = context.Tree.Insert(renderer.Mesh->GetBounds().Transformed(transform.WorldTransform()), entt::to_integral(entity));
+		} else {
+			proxy.Node = BoundingVolumeHierarchy::NULL_NODE;
+			context.Unbounded.push_back(entity);
+		}
+	}
+
+	void RemoveProxy(CullingContext& context, entt::entity entity, const CullingProxy& proxy) {
+		if (proxy.Node != BoundingVolumeHierarchy::NULL_NODE) {
+			context.Tree.Remove(proxy.Node);
+		} else {
+			// There are only ever a handful of these, so a search is fine
+			auto it = std::find(context.Unbounded.begin(), context.Unbounded.end(), entity);
+			if (it != context.Unbounded.end()) {
+				*it = context.Unbounded.back();
+				context.Unbounded.pop_back();
+			}
+		}
+	}
+
+	/*
+	 * Draws the visible occluders into the occlusion buffer, then removes everything hidden behind them from the
+	 * visible list. Only renderers from the BVH are tested, the unbounded ones at the end of the list are kept
+	 */
+	void CullOccluded(entt::registry& registry, CullingContext& context, const glm::mat4& viewProjection) {
+		OcclusionBuffer& buffer = context.Occlusion;
+		buffer.Begin(viewProjection);
+		// Occluders that are out of view can't hide anything that's in view
+		for (entt::entity entity : context.Visible) {
+			const OccluderComponent* occluder = registry.try_get<OccluderComponent>(entity);
+			if (occluder != nullptr && occluder->Mesh != nullptr) {
+				buffer.AddOccluder(*occluder->Mesh, registry.get<Transform>(entity).WorldTransform());
+			}
+		}
+		buffer.Rasterize();
+		if (buffer.GetStats().Triangles == 0) {
+			return;
+		}
+
+		// The tests only read from the buffer, so we can spread them across the pool
+		const size_t count = context.Found.size();
+		const size_t batchSize = 1024;
+		context.Hidden.assign(count, 0);
+		ThreadPool::Instance().ParallelFor((count + batchSize - 1) / batchSize, [&](size_t batch) {
+			const size_t end = std::min(count, (batch + 1) * batchSize);
+			for (size_t ix = batch * batchSize; ix < end; ix++) {
+				const entt::entity entity = context.Visible[ix];
+				// Occluders would hide themselves if their simplified mesh pokes out of their bounds
+				if (registry.has<OccluderComponent>(entity)) {
+					continue;
+				}
+				const CullingProxy& proxy = registry.get<CullingProxy>(entity);
+				context.Hidden[ix] = buffer.IsOccluded(context.Tree.GetFatBounds(proxy.Node)) ? 1 : 0;
+			}
+		});
+
+		size_t kept = 0;
+		for (size_t ix = 0; ix < context.Visible.size(); ix++) {
+			if (ix >= count || context.Hidden[ix] == 0) {
+				context.Visible[kept++] = context.Visible[ix];
+			}
+		}
+		buffer.AddTestResults(count, context.Visible.size() - kept);
+		context.Visible.resize(kept);
+	}
+}
+
+void CullingSystem::Initialize(entt::registry& registry) {
+	if (registry.try_ctx<CullingContext>() != nullptr) {
+		return;
+	}
+	registry.set<CullingContext>();
+	registry.on_destroy<CullingProxy>().connect<&CullingSystem::_OnProxyDestroyed>();
+	registry.on_destroy<RendererComponent>().connect<&CullingSystem::_OnRendererDestroyed>();
+}
+
+void CullingSystem::_OnProxyDestroyed(entt::registry& registry, entt::entity entity) {
+	RemoveProxy(registry.ctx<CullingContext>(), entity, registry.get<CullingProxy>(entity));
+}
+
+void CullingSystem::_OnRendererDestroyed(entt::registry& registry, entt::entity entity) {
+	// If only the renderer is being removed, the proxy needs to go with it
+	registry.remove_if_exists<CullingProxy>(entity);
+}
+
+void CullingSystem::Update(entt::registry& registry) {
+	typedef std::chrono::high_resolution_clock Clock;
+	const Clock::time_point start = Clock::now();
+	Initialize(registry);
+	CullingContext& context = registry.ctx<CullingContext>();
+
+	// Find the renderers that don't have proxies yet, we can't add components while iterating the view
+	context.NewRenderers.clear();
+	for (entt::entity entity : registry.view<RendererComponent, Transform>(entt::exclude<CullingProxy>)) {
+		context.NewRenderers.push_back(entity);
+	}
+	for (entt::entity entity : context.NewRenderers) {
+		CullingProxy& proxy = registry.emplace<CullingProxy>(entity);
+		AddProxy(context, entity, proxy, registry.get<RendererComponent>(entity), registry.get<Transform>(entity));
+	}
+
+	// Refit anything that has moved, and re-add anything that has changed meshes or been marked as never culled
+	size_t moved = 0;
+	registry.view<CullingProxy, RendererComponent, Transform>().each([&](entt::entity entity, CullingProxy& proxy, const RendererComponent& renderer, const Transform& transform) {
+		if (proxy.Mesh != renderer.Mesh.get() || proxy.IsNeverCulled != renderer.IsNeverCulled) {
+			RemoveProxy(context, entity, proxy);
+			AddProxy(context, entity, proxy, renderer, transform);
+			moved++;
+		}
+		else if (proxy.WorldVersion != transform.GetWorldVersion()) {
+			proxy.WorldVersion = transform.GetWorldVersion();
+			if (proxy.Node != BoundingVolumeHierarchy::NULL_NODE) {
+				moved += context.Tree.Move(proxy.Node, renderer.Mesh->GetBounds().Transformed(transform.WorldTransform())) ? 1 : 0;
+			}
+		}
+	});
+
+	context.Stats.Renderers = registry.size<CullingProxy>();
+	context.Stats.ProxiesMoved = moved;
+	context.Stats.TreeHeight = context.Tree.GetHeight();
+	context.Stats.UpdateMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void CullingSystem::Cull(entt::registry& registry, const glm::mat4& viewProjection) {
+	typedef std::chrono::high_resolution_clock Clock;
+	const Clock::time_point start = Clock::now();
+	Initialize(registry);
+	CullingContext& context = registry.ctx<CullingContext>();
+
+	context.Visible.clear();
+	context.Occlusion.Begin(viewProjection);
+	context.Stats.OcclusionMs = 0.0;
+	if (context.IsEnabled) {
+		context.Found.clear();
+		context.Stats.NodesTested = context.Tree.QueryFrustum(Frustum(viewProjection), context.Found);
+		context.Visible.reserve(context.Found.size() + context.Unbounded.size());
+		for (uint32_t id : context.Found) {
+			context.Visible.push_back(static_cast<entt::entity>(id));
+		}
+		context.Visible.insert(context.Visible.end(), context.Unbounded.begin(), context.Unbounded.end());
+
+		if (context.IsOcclusionEnabled) {
+			const Clock::time_point occlusionStart = Clock::now();
+			CullOccluded(registry, context, viewProjection);
+			context.Stats.OcclusionMs = std::chrono::duration<double, std::milli>(Clock::now() - occlusionStart).count();
+		}
+	} else {
+		const auto view = registry.view<CullingProxy>();
+		context.Visible.assign(view.begin(), view.end());
+		context.Stats.NodesTested = 0;
+	}
+
+	const OcclusionBuffer::Stats& occlusionStats = context.Occlusion.GetStats();
+	context.Stats.Occluders = occlusionStats.Occluders;
+	context.Stats.OccluderTriangles = occlusionStats.Triangles;
+	context.Stats.Occluded = occlusionStats.Occluded;
+	context.Stats.Visible = context.Visible.size();
+	context.Stats.CullMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+const std::vector<entt::entity>& CullingSystem::GetVisible(entt::registry& registry) {
+	Initialize(registry);
+	return registry.ctx<CullingContext>().Visible;
+}
+
+void CullingSystem::SetEnabled(entt::registry& registry, bool enabled) {
+	Initialize(registry);
+	registry.ctx<CullingContext>().IsEnabled = enabled;
+}
+
+bool CullingSystem::IsEnabled(entt::registry& registry) {
+	Initialize(registry);
+	return registry.ctx<CullingContext>().IsEnabled;
+}
+
+void CullingSystem::SetOcclusionEnabled(entt::registry& registry, bool enabled) {
+	Initialize(registry);
+	registry.ctx<CullingContext>().IsOcclusionEnabled = enabled;
+}
+
+bool CullingSystem::IsOcclusionEnabled(entt::registry& registry) {
+	Initialize(registry);
+	return registry.ctx<CullingContext>().IsOcclusionEnabled;
+}
+
+const OcclusionBuffer& CullingSystem::GetOcclusionBuffer(entt::registry& registry) {
+	Initialize(registry);
+	return registry.ctx<CullingContext>().Occlusion;
+}
+
+const CullingSystem::Stats& CullingSystem::GetStats(entt::registry& registry) {
+	Initialize(registry);
+	return registry.ctx<CullingContext>().Stats;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <entt.hpp>
+#include <GLM/glm.hpp>
+
+class OcclusionBuffer;
+class VertexArrayObject;
+
+/// <summary>
+/// Added to renderers by the CullingSystem to track where they are in the scene's BVH
+/// </summary>
+struct CullingProxy {
+	// The proxy in the BVH, or BoundingVolumeHierarchy::NULL_NODE if the mesh has no bounds or is never culled
+	int32_t                  Node;
+	// The world matrix version, mesh and never culled flag that the proxy was last calculated from
+	uint32_t                 WorldVersion;
+	const VertexArrayObject* Mesh;
+	bool                     IsNeverCulled;
+};
+
+/// <summary>
+/// Finds which renderers in a scene can be seen by a camera. Every RendererComponent with a mesh that has bounds (see
+/// VertexArrayObject::GetBounds) is stored in a BVH, which is refit as transforms move. Renderers whose meshes
+/// have no bounds, or that are marked with RendererComponent::IsNeverCulled, are always visible.
+///
+/// Occlusion culling can also be turned on, which draws the visible OccluderComponents into a small software depth
+/// buffer and then drops anything that is completely hidden behind them
+/// </summary>
+class CullingSystem
+{
+public:
+	struct Stats {
+		size_t Renderers;
+		size_t Visible;
+		size_t NodesTested;
+		size_t ProxiesMoved;
+		int    TreeHeight;
+		size_t Occluders;
+		size_t OccluderTriangles;
+		size_t Occluded;
+		double UpdateMs;
+		double CullMs;      // The total time of the last Cull, including occlusion
+		double OcclusionMs;
+	};
+
+	/// <summary>
+	/// Hooks the system up to a registry, so that renderers can be removed from the BVH when they are destroyed.
+	/// This is called automatically by Update
+	/// </summary>
+	/// <param name="registry">The registry to attach to</param>
+	static void Initialize(entt::registry& registry);
+
+	/// <summary>
+	/// Adds any new renderers to the BVH, and updates the bounds of any whose transform or mesh has changed.
+	/// World matrices should be up to date before calling this, see TransformSystem
+	/// </summary>
+	/// <param name="registry">The registry containing the renderers</param>
+	static void Update(entt::registry& registry);
+
+	/// <summary>
+	/// Finds the renderers that are visible to a camera, which can then be read with GetVisible
+	/// </summary>
+	/// <param name="registry">The registry containing the renderers</param>
+	/// <param name="viewProjection">The camera's view projection matrix (ex: Camera::GetViewProjection)</param>
+	static void Cull(entt::registry& registry, const glm::mat4& viewProjection);
+
+	/// <summary>
+	/// Gets the entities that were found to be visible by the last call to Cull
+	/// </summary>
+	static const std::vector<entt::entity>& GetVisible(entt::registry& registry);
+
+	/// <summary>
+	/// Enables or disables culling for a registry, when disabled every renderer is visible (enabled by default)
+	/// </summary>
+	static void SetEnabled(entt::registry& registry, bool enabled);
+	static bool IsEnabled(entt::registry& registry);
+
+	/// <summary>
+	/// Enables or disables the occlusion culling stage for a registry (disabled by default). This has no effect if
+	/// culling is disabled
+	/// </summary>
+	static void SetOcclusionEnabled(entt::registry& registry, bool enabled);
+	static bool IsOcclusionEnabled(entt::registry& registry);
+	/// <summary>
+	/// Gets the depth buffer that the occluders were drawn into by the last call to Cull, for debugging
+	/// </summary>
+	static const OcclusionBuffer& GetOcclusionBuffer(entt::registry& registry);
+
+	/// <summary>
+	/// Gets the stats from the last Update and Cull
+	/// </summary>
+	static const Stats& GetStats(entt::registry& registry);
+
+protected:
+	CullingSystem() = default;
+	~CullingSystem() = default;
+
+	static void _OnProxyDestroyed(entt::registry& registry, entt::entity entity);
+	static void _OnRendererDestroyed(entt::registry& registry, entt::entity entity);
+};
@@ -0,0 +1,74 @@
+#include "Frustum.h"
+
+// SSE is always available on x64, MSVC only tells us about it through _M_IX86_FP on 32 bit builds
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_TEST_SSE
+#include <xmmintrin.h>
+#endif
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+	// Gribb & Hartmann, each plane is the last row of the matrix plus or minus one of the other rows
+	// https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
+	const glm::vec4 rows[4] = {
+		glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]),
+		glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]),
+		glm::vec4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]),
+		glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3])
+	};
+	const glm::vec4 planes[6] = {
+		rows[3] + rows[0], // Left
+		rows[3] - rows[0], // Right
+		rows[3] + rows[1], // Bottom
+		rows[3] - rows[1], // Top
+		rows[3] + rows[2], // Near
+		rows[3] - rows[2]  // Far
+	};
+
+	for (int ix = 0; ix < PLANE_SLOTS; ix++) {
+		glm::vec4 plane = planes[ix < 6 ? ix : 5];
+		const float length = glm::length(glm::vec3(plane));
+		plane /= length > 0.0f ? length : 1.0f;
+		_normalX[ix] = plane.x;
+		_normalY[ix] = plane.y;
+		_normalZ[ix] = plane.z;
+		_distance[ix] = plane.w;
+	}
+}
+
+Frustum::TestResult Frustum::Test(const AABB& box) const {
+	const glm::vec3 center = box.GetCenter();
+	const glm::vec3 extents = box.GetExtents();
+	bool isIntersecting = false;
+
+	// For each plane, the distance from the plane to the center of the box, and how far the box reaches towards the
+	// plane. If the center is further behind the plane than the box reaches, the whole box is behind it
+#ifdef FRUSTUM_TEST_SSE
+	const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+	const __m128 ex = _mm_set1_ps(extents.x), ey = _mm_set1_ps(extents.y), ez = _mm_set1_ps(extents.z);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps();
+	for (int group = 0; group < PLANE_SLOTS; group += 4) {
+		const __m128 nx = _mm_load_ps(_normalX + group);
+		const __m128 ny = _mm_load_ps(_normalY + group);
+		const __m128 nz = _mm_load_ps(_normalZ + group);
+		const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+			_mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(_distance + group)));
+		const __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex), _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+			_mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+		if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, reach), zero)) != 0) {
+			return TestResult::Outside;
+		}
+		isIntersecting |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, reach), zero)) != 0;
+	}
+#else
+	for (int ix = 0; ix < PLANE_SLOTS; ix++) {
+		const float distance = _normalX[ix] * center.x + _normalY[ix] * center.y + _normalZ[ix] * center.z + _distance[ix];
+		const float reach = glm::abs(_normalX[ix]) * extents.x + glm::abs(_normalY[ix]) * extents.y + glm::abs(_normalZ[ix]) * extents.z;
+		if (distance + reach < 0.0f) {
+			return TestResult::Outside;
+		}
+		isIntersecting |= distance - reach < 0.0f;
+	}
+#endif
+	return isIntersecting ? TestResult::Intersecting : TestResult::Inside;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <GLM/glm.hpp>
+
+#include "Utilities/Bounds.h"
+
+/// <summary>
+/// The 6 planes of a camera's view volume, for testing whether things can be seen. The planes are stored as
+/// structure-of-arrays, so that a box can be tested against 4 planes at once with SSE
+/// </summary>
+class Frustum final
+{
+public:
+	enum class TestResult {
+		Outside,      // The box is completely outside of at least one plane
+		Intersecting, // The box may be partially visible
+		Inside        // The box is completely inside all of the planes
+	};
+
+	Frustum() = default;
+	/// <summary>
+	/// Extracts the planes from a view-projection matrix (ex: Camera::GetViewProjection)
+	/// </summary>
+	/// <param name="viewProjection">The combined projection * view matrix, with OpenGL's -1 to 1 clip depth</param>
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	/// <summary>
+	/// Tests a world space box against the frustum
+	/// </summary>
+	TestResult Test(const AABB& box) const;
+	/// <summary>
+	/// Returns true if any part of the box could be visible
+	/// </summary>
+	bool Intersects(const AABB& box) const { return Test(box) != TestResult::Outside; }
+
+private:
+	// We pad the 6 planes out to 8 by repeating the last one, so every group of 4 is full
+	static constexpr int PLANE_SLOTS = 8;
+
+	// Plane i is NormalX[i] * x + NormalY[i] * y + NormalZ[i] * z + Distance[i] >= 0 for points inside
+	alignas(16) float _normalX[PLANE_SLOTS] = {};
+	alignas(16) float _normalY[PLANE_SLOTS] = {};
+	alignas(16) float _normalZ[PLANE_SLOTS] = {};
+	alignas(16) float _distance[PLANE_SLOTS] = {};
+};
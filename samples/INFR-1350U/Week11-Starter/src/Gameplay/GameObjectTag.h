@@ -4,6 +4,10 @@
 
 /// <summary>
 /// Represents information associated with a game object within our scene
+///
+/// Scenes index their objects by name, so to rename an object use registry.replace or registry.patch instead of
+/// editing the tag directly, otherwise FindFirst and FindAll will not see the change. The HashedName is recomputed
+/// from the Name whenever the tag is updated, so a patch only needs to set the Name
 /// </summary>
 struct GameObjectTag
 {
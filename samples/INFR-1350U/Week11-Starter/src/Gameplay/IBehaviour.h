@@ -1,8 +1,10 @@
 #pragma once
 #include <memory>
 #include <entt.hpp>
-#include <typeindex>
-struct BehaviourBinding;
+#include <typeinfo>
+
+#include "Logging.h"
+#include "BehaviourSystem.h"
 
 /*
  * Represents a behaviour that can be tied to a single GameObject
@@ -13,6 +15,11 @@ public:
 	 * Whether or not this component will fire it's events
 	 */
 	bool    Enabled = true;
+	/*
+	 * Behaviour types can hide this with true if their Update only touches the behaviour itself and it's entity's
+	 * Transform, which lets BehaviourSystem update them in parallel
+	 */
+	static constexpr bool IsThreadSafe = false;
 	virtual ~IBehaviour() = default;
 
 	/*
@@ -54,100 +61,97 @@ protected:
 };
 
 /*
- * The component added to an entt entity to connect a behaviour to a specific entity
+ * Binds behaviours to entities. Each behaviour is stored as an entt component of it's own type, so an entity can
+ * have at most one behaviour of each type, and looking one up is a constant time pool lookup.
+ * See BehaviourSystem for how they are updated
+ *
+ * The pointers returned here point into the behaviour's pool, and will move when more behaviours of the same type are
+ * added or removed. DO NOT STORE POINTER!
  */
 struct BehaviourBinding {
-	std::vector<std::shared_ptr<IBehaviour>> Behaviours;
-
 	/*
 	 * Binds an IBehaviour interface to the given entt entity
 	 * @param T The type of behaviour to add
 	 * @param TArgs The argument types to forward to the behaviour's constructor
-	 * @param registry The registry that the entity is part of
 	 * @param entity The entity to add the behaviour to
 	 * @param args The arguments to forward to the behaviour's constructor
+	 * @returns The behaviour that was added, or the existing one if the entity already had a T
 	 */
 	template <typename T, typename ... TArgs, typename = typename std::enable_if<std::is_base_of<IBehaviour, T>::value>::type>
-	static std::shared_ptr<T> Bind(entt::handle entity, TArgs&&... args) {
-		// Get the binding component
-		BehaviourBinding& binding = entity.get_or_emplace<BehaviourBinding>();
-		// Make a new behaviour, forwarding the arguments
-		const std::shared_ptr<IBehaviour> behaviour = std::make_shared<T>(std::forward<TArgs>(args)...);
-		// Append it to the binding component's storage, and invoke the OnLoad
-		binding.Behaviours.push_back(behaviour);
-		behaviour->OnLoad(entity);
-		return std::dynamic_pointer_cast<T>(behaviour);
+	static T* Bind(entt::handle entity, TArgs&&... args) {
+		if (entity.has<T>()) {
+			// If it was unbound earlier in this update it's still in the pool, so we reuse it's slot
+			if (BehaviourSystem::IsUpdating<T>(entity.registry()) && BehaviourSystem::CancelRemove<T>(entity.entity())) {
+				T& behaviour = entity.replace<T>(std::forward<TArgs>(args)...);
+				behaviour.OnLoad(entity);
+				return &behaviour;
+			}
+			LOG_WARN("Entity already has a behaviour of type {}, only one of each type is allowed", typeid(T).name());
+			return &entity.get<T>();
+		}
+		BehaviourSystem::RegisterType<T>();
+		// Make a new behaviour in the type's pool, forwarding the arguments, and invoke the OnLoad
+		T& behaviour = entity.emplace<T>(std::forward<TArgs>(args)...);
+		behaviour.OnLoad(entity);
+		return &behaviour;
 	}
 
 	/*
 	 * Binds an IBehaviour interface to the given entt entity, setting it to disabled by default
 	 * @param T The type of behaviour to add
 	 * @param TArgs The argument types to forward to the behaviour's constructor
-	 * @param registry The registry that the entity is part of
 	 * @param entity The entity to add the behaviour to
 	 * @param args The arguments to forward to the behaviour's constructor
+	 * @returns The behaviour that was added, or the existing one if the entity already had a T
 	 */
 	template <typename T, typename ... TArgs, typename = typename std::enable_if<std::is_base_of<IBehaviour, T>::value>::type>
-	static std::shared_ptr<T> BindDisabled(entt::handle entity, TArgs&&... args) {
-		// Get the binding component
-		BehaviourBinding& binding = entity.get_or_emplace<BehaviourBinding>();
-		// Make a new behaviour, forwarding the arguments
-		const std::shared_ptr<IBehaviour> behaviour = std::make_shared<T>(std::forward<TArgs>(args)...);
+	static T* BindDisabled(entt::handle entity, TArgs&&... args) {
+		T* behaviour = Bind<T>(entity, std::forward<TArgs>(args)...);
 		behaviour->Enabled = false;
-		// Append it to the binding component's storage, and invoke the OnLoad
-		binding.Behaviours.push_back(behaviour);
-		behaviour->OnLoad(entity);
-		return std::dynamic_pointer_cast<T>(behaviour);
+		return behaviour;
+	}
+
+	/*
+	 * Removes the behaviour with the given type from the entity, invoking it's OnUnload. If behaviours of this type are
+	 * being updated right now, the behaviour is disabled and removed once that update is done
+	 * @param T The type of behaviour to remove
+	 * @param entity The entity to remove the behaviour from
+	 */
+	template <typename T, typename = typename std::enable_if<std::is_base_of<IBehaviour, T>::value>::type>
+	static void Unbind(entt::handle entity) {
+		if (T* behaviour = entity.try_get<T>()) {
+			if (BehaviourSystem::IsUpdating<T>(entity.registry())) {
+				// Removing it now would swap another behaviour into the slot the system is on, so it gets removed after the loop
+				if (BehaviourSystem::DeferRemove<T>(entity.entity())) {
+					behaviour->OnUnload(entity);
+					behaviour->Enabled = false;
+				}
+			} else {
+				behaviour->OnUnload(entity);
+				entity.remove<T>();
+			}
+		}
 	}
 
-	
 	/*
 	 * Checks whether the given entity has a behaviour of the given type
 	 * @param T The type of behaviour to check for
-	 * @param registry The registry that the entity is part of
 	 * @param entity The entity to check
 	 * @returns True if a behaviour of type T is attached to entity, or false if otherwise
 	 */
 	template <typename T, typename = typename std::enable_if<std::is_base_of<IBehaviour, T>::value>::type>
 	static bool Has(entt::handle entity) {
-		// Check to see if the entity has a behaviour binding attached
-		if (entity.has<BehaviourBinding>()) {
-			// Get the binding component
-			const auto& binding = entity.get<BehaviourBinding>();
-			// Iterate over all the pointers in the binding list
-			for (const auto& ptr : binding.Behaviours) {
-				// If the pointer type matches T, we return true
-				if (std::type_index(typeid(*ptr.get())) == std::type_index(typeid(T))) {
-					return true;
-				}
-			}
-			return false;
-		}
-		else return false;
+		return entity.has<T>();
 	}
 
 	/*
 	 * Gets the behaviour with the given type from the entity, or nullptr if none exists
 	 * @param T The type of behaviour to check for
-	 * @param registry The registry that the entity is part of
 	 * @param entity The entity to search
 	 * @returns The behaviour of type T that is attached to entity, or nullptr if no behaviour of that type is attached
 	 */
 	template <typename T, typename = typename std::enable_if<std::is_base_of<IBehaviour, T>::value>::type>
-	static std::shared_ptr<T> Get(entt::handle entity) {
-		// Check to see if the entity has a behaviour binding attached
-		if (entity.has<BehaviourBinding>()) {
-			// Get the binding component
-			const auto& binding = entity.get<BehaviourBinding>();
-			// Iterate over all the pointers in the binding list
-			for (const auto& ptr : binding.Behaviours) {
-				// If the pointer type matches T, we return that behaviour, making sure to cast it back to the requested type
-				if (std::type_index(typeid(*ptr.get())) == std::type_index(typeid(T))) {
-					return std::dynamic_pointer_cast<T>(ptr);
-				}
-			}
-			return nullptr;
-		}
-		else return nullptr;
+	static T* Get(entt::handle entity) {
+		return entity.try_get<T>();
 	}
-};
\ No newline at end of file
+};
@@ -0,0 +1,13 @@
+#pragma once
+#include "Gameplay/OcclusionBuffer.h"
+
+/// <summary>
+/// Marks an object as something that hides the objects behind it. When occlusion culling is enabled (see
+/// CullingSystem::SetOcclusionEnabled), occluders that are in view are drawn into an OcclusionBuffer, and anything
+/// completely behind them is skipped. Many objects can share the same occluder mesh
+/// </summary>
+struct OccluderComponent {
+	OccluderMesh::sptr Mesh;
+
+	OccluderComponent& SetMesh(const OccluderMesh::sptr& mesh) { Mesh = mesh; return *this; }
+};
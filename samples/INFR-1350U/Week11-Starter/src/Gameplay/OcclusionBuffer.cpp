@@ -0,0 +1,260 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+
+#include "Utilities/ThreadPool.h"
+
+// SSE is always available on x64, MSVC only tells us about it through _M_IX86_FP on 32 bit builds
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_RASTER_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+	// The number of rows each task rasterizes, every task owns it's rows so no two threads ever write the same pixel
+	constexpr int BAND_HEIGHT = 16;
+	// The number of occluders each task projects
+	constexpr size_t SETUP_BATCH_SIZE = 64;
+}
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) :
+	_width((std::max(width, 4) + 3) & ~3),
+	_height(std::max(height, 1)),
+	_viewProjection(1.0f),
+	_stats({ 0, 0, 0, 0, 0.0 })
+{
+	int levelWidth = _width;
+	int levelHeight = _height;
+	while (true) {
+		_levels.push_back({ levelWidth, levelHeight, std::vector<float>((size_t)levelWidth * levelHeight, 1.0f) });
+		if (levelWidth == 1 && levelHeight == 1) {
+			break;
+		}
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+}
+
+void OcclusionBuffer::Begin(const glm::mat4& viewProjection) {
+	_viewProjection = viewProjection;
+	_occluders.clear();
+	_stats = { 0, 0, 0, 0, 0.0 };
+}
+
+void OcclusionBuffer::AddOccluder(const OccluderMesh& mesh, const glm::mat4& world) {
+	_occluders.push_back({ &mesh, _viewProjection * world });
+}
+
+void OcclusionBuffer::Rasterize() {
+	typedef std::chrono::high_resolution_clock Clock;
+	const Clock::time_point start = Clock::now();
+	ThreadPool& pool = ThreadPool::Instance();
+
+	// Project all of the triangles, most occluders are only a handful of triangles so we do a batch per task
+	if (_triangles.size() < _occluders.size()) {
+		_triangles.resize(_occluders.size());
+	}
+	const size_t count = _occluders.size();
+	pool.ParallelFor((count + SETUP_BATCH_SIZE - 1) / SETUP_BATCH_SIZE, [&](size_t batch) {
+		const size_t end = std::min(count, (batch + 1) * SETUP_BATCH_SIZE);
+		for (size_t ix = batch * SETUP_BATCH_SIZE; ix < end; ix++) {
+			_triangles[ix].clear();
+			_SetupTriangles(_occluders[ix], _triangles[ix]);
+		}
+	});
+	_stats.Occluders = count;
+	for (size_t ix = 0; ix < count; ix++) {
+		_stats.Triangles += _triangles[ix].size();
+	}
+
+	// Each band of rows walks every triangle, and only touches the pixels in it's own rows
+	std::fill(_levels[0].Depths.begin(), _levels[0].Depths.end(), 1.0f);
+	const size_t bands = (_height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+	pool.ParallelFor(bands, [&](size_t band) {
+		const int firstRow = static_cast<int>(band) * BAND_HEIGHT;
+		_RasterizeRows(firstRow, std::min(firstRow + BAND_HEIGHT, _height));
+	});
+
+	_BuildHierarchy();
+	_stats.RasterMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void OcclusionBuffer::_SetupTriangles(const Occluder& occluder, std::vector<ScreenTriangle>& results) const {
+	// Scratch space for the projected vertices, one per thread so that occluders can be set up in parallel. Vertices
+	// get projected to pixels with depth remapped to 0 to 1, we use a negative depth to flag ones in front of the near plane
+	static thread_local std::vector<glm::vec3> projected;
+	const OccluderMesh& mesh = *occluder.Mesh;
+	const float halfWidth = _width * 0.5f;
+	const float halfHeight = _height * 0.5f;
+	projected.resize(mesh.Positions.size());
+	for (size_t ix = 0; ix < mesh.Positions.size(); ix++) {
+		const glm::vec4 clip = occluder.ModelViewProjection * glm::vec4(mesh.Positions[ix], 1.0f);
+		if (clip.z < -clip.w) {
+			projected[ix] = glm::vec3(0.0f, 0.0f, -1.0f);
+			continue;
+		}
+		const float invW = 1.0f / clip.w;
+		projected[ix] = glm::vec3((clip.x * invW + 1.0f) * halfWidth, (clip.y * invW + 1.0f) * halfHeight, clip.z * invW * 0.5f + 0.5f);
+	}
+
+	for (size_t ix = 0; ix + 2 < mesh.Indices.size(); ix += 3) {
+		const glm::vec3& p0 = projected[mesh.Indices[ix]];
+		const glm::vec3& p1 = projected[mesh.Indices[ix + 1]];
+		const glm::vec3& p2 = projected[mesh.Indices[ix + 2]];
+
+		// We don't clip, triangles that cross the near plane are just dropped. That only ever makes the buffer see less
+		// than it could, so it can never hide something that's visible
+		if (p0.z < 0.0f || p1.z < 0.0f || p2.z < 0.0f) {
+			continue;
+		}
+
+		// Twice the signed area, triangles facing away from us (or with no area) are behind the front faces anyways
+		const float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+		if (area <= 0.0f) {
+			continue;
+		}
+
+		ScreenTriangle tri;
+		tri.MinX = std::max(0, static_cast<int>(glm::floor(glm::min(p0.x, glm::min(p1.x, p2.x)))));
+		tri.MaxX = std::min(_width - 1, static_cast<int>(glm::ceil(glm::max(p0.x, glm::max(p1.x, p2.x)))));
+		tri.MinY = std::max(0, static_cast<int>(glm::floor(glm::min(p0.y, glm::min(p1.y, p2.y)))));
+		tri.MaxY = std::min(_height - 1, static_cast<int>(glm::ceil(glm::max(p0.y, glm::max(p1.y, p2.y)))));
+		if (tri.MinX > tri.MaxX || tri.MinY > tri.MaxY) {
+			continue;
+		}
+
+		const glm::vec3* verts[3] = { &p0, &p1, &p2 };
+		for (int edge = 0; edge < 3; edge++) {
+			const glm::vec3& a = *verts[edge];
+			const glm::vec3& b = *verts[(edge + 1) % 3];
+			tri.EdgeA[edge] = a.y - b.y;
+			tri.EdgeB[edge] = b.x - a.x;
+			tri.EdgeC[edge] = a.x * b.y - a.y * b.x;
+		}
+
+		// Depth divided by w is linear in screen space, so we can step it across the triangle as a plane
+		const glm::vec3 d1 = p1 - p0;
+		const glm::vec3 d2 = p2 - p0;
+		tri.DepthA = (d1.z * d2.y - d1.y * d2.z) / area;
+		tri.DepthB = (d1.x * d2.z - d1.z * d2.x) / area;
+		tri.DepthC = p0.z - tri.DepthA * p0.x - tri.DepthB * p0.y;
+		results.push_back(tri);
+	}
+}
+
+void OcclusionBuffer::_RasterizeRows(int firstRow, int lastRow) {
+	float* depths = _levels[0].Depths.data();
+	for (size_t occluder = 0; occluder < _occluders.size(); occluder++) {
+		for (const ScreenTriangle& tri : _triangles[occluder]) {
+			const int minY = std::max(tri.MinY, firstRow);
+			const int maxY = std::min(tri.MaxY, lastRow - 1);
+			// Start on a multiple of 4 so every group of pixels is inside of the row
+			const int minX = tri.MinX & ~3;
+
+			for (int y = minY; y <= maxY; y++) {
+				const float py = y + 0.5f;
+				float* row = depths + (size_t)y * _width;
+			#ifdef OCCLUSION_RASTER_SSE
+				const __m128 zero = _mm_setzero_ps();
+				const __m128 a0 = _mm_set1_ps(tri.EdgeA[0]), a1 = _mm_set1_ps(tri.EdgeA[1]), a2 = _mm_set1_ps(tri.EdgeA[2]);
+				const __m128 r0 = _mm_set1_ps(tri.EdgeB[0] * py + tri.EdgeC[0]);
+				const __m128 r1 = _mm_set1_ps(tri.EdgeB[1] * py + tri.EdgeC[1]);
+				const __m128 r2 = _mm_set1_ps(tri.EdgeB[2] * py + tri.EdgeC[2]);
+				const __m128 depthA = _mm_set1_ps(tri.DepthA);
+				const __m128 depthRow = _mm_set1_ps(tri.DepthB * py + tri.DepthC);
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)minX), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+				const __m128 step = _mm_set1_ps(4.0f);
+				for (int x = minX; x <= tri.MaxX; x += 4, px = _mm_add_ps(px, step)) {
+					const __m128 inside = _mm_and_ps(_mm_and_ps(
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), r0), zero),
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), r1), zero)),
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), r2), zero));
+					if (_mm_movemask_ps(inside) == 0) {
+						continue;
+					}
+					const __m128 current = _mm_loadu_ps(row + x);
+					const __m128 nearest = _mm_min_ps(current, _mm_add_ps(_mm_mul_ps(depthA, px), depthRow));
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+				}
+			#else
+				for (int x = minX; x <= tri.MaxX; x++) {
+					const float px = x + 0.5f;
+					if (tri.EdgeA[0] * px + tri.EdgeB[0] * py + tri.EdgeC[0] >= 0.0f &&
+						tri.EdgeA[1] * px + tri.EdgeB[1] * py + tri.EdgeC[1] >= 0.0f &&
+						tri.EdgeA[2] * px + tri.EdgeB[2] * py + tri.EdgeC[2] >= 0.0f) {
+						row[x] = glm::min(row[x], tri.DepthA * px + tri.DepthB * py + tri.DepthC);
+					}
+				}
+			#endif
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::_BuildHierarchy() {
+	for (size_t level = 1; level < _levels.size(); level++) {
+		const Level& source = _levels[level - 1];
+		Level& target = _levels[level];
+		for (int y = 0; y < target.Height; y++) {
+			// Odd sized levels repeat their last row or column
+			const float* row0 = source.Depths.data() + (size_t)(y * 2) * source.Width;
+			const float* row1 = source.Depths.data() + (size_t)std::min(y * 2 + 1, source.Height - 1) * source.Width;
+			for (int x = 0; x < target.Width; x++) {
+				const int x0 = x * 2;
+				const int x1 = std::min(x * 2 + 1, source.Width - 1);
+				target.Depths[(size_t)y * target.Width + x] = glm::max(glm::max(row0[x0], row0[x1]), glm::max(row1[x0], row1[x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::IsOccluded(const AABB& bounds) const {
+	// Project the corners of the box to find the rectangle it covers, and the closest it gets to the camera
+	glm::vec2 minPos = glm::vec2(FLT_MAX);
+	glm::vec2 maxPos = glm::vec2(-FLT_MAX);
+	float nearest = FLT_MAX;
+	for (int corner = 0; corner < 8; corner++) {
+		const glm::vec4 point = glm::vec4(
+			corner & 1 ? bounds.Max.x : bounds.Min.x,
+			corner & 2 ? bounds.Max.y : bounds.Min.y,
+			corner & 4 ? bounds.Max.z : bounds.Min.z, 1.0f);
+		const glm::vec4 clip = _viewProjection * point;
+		// Boxes that reach past the near plane are right in front of the camera, we'll always draw those
+		if (clip.w <= 0.0f || clip.z < -clip.w) {
+			return false;
+		}
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		minPos = glm::min(minPos, glm::vec2(ndc));
+		maxPos = glm::max(maxPos, glm::vec2(ndc));
+		nearest = glm::min(nearest, ndc.z);
+	}
+
+	const int x0 = std::max(0, static_cast<int>(glm::floor((minPos.x + 1.0f) * 0.5f * _width)));
+	const int x1 = std::min(_width - 1, static_cast<int>(glm::floor((maxPos.x + 1.0f) * 0.5f * _width)));
+	const int y0 = std::max(0, static_cast<int>(glm::floor((minPos.y + 1.0f) * 0.5f * _height)));
+	const int y1 = std::min(_height - 1, static_cast<int>(glm::floor((maxPos.y + 1.0f) * 0.5f * _height)));
+	if (x0 > x1 || y0 > y1) {
+		return false;
+	}
+	const float nearestDepth = nearest * 0.5f + 0.5f;
+
+	// Pick the level where the rectangle covers at most a few texels each way
+	const int size = std::max(x1 - x0, y1 - y0) + 1;
+	size_t level = 0;
+	while ((size >> level) > 2 && level + 1 < _levels.size()) {
+		level++;
+	}
+
+	// The box is hidden if it's closest point is behind the furthest occluder depth everywhere it covers
+	const Level& hiZ = _levels[level];
+	for (int y = y0 >> level; y <= (y1 >> level); y++) {
+		for (int x = x0 >> level; x <= (x1 >> level); x++) {
+			if (nearestDepth <= hiZ.Depths[(size_t)y * hiZ.Width + x]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <GLM/glm.hpp>
+
+#include "Utilities/Bounds.h"
+#include "Utilities/MeshBuilder.h"
+
+/// <summary>
+/// A simplified mesh that is drawn into an OcclusionBuffer, only the positions are kept. Occluders should be closed,
+/// counter-clockwise wound, and fit inside of the object they stand in for (ex: the walls of a room, or a box inside
+/// of a building), otherwise they may hide things that can actually be seen
+/// </summary>
+class OccluderMesh final
+{
+public:
+	typedef std::shared_ptr<OccluderMesh> sptr;
+	static inline sptr Create() {
+		return std::make_shared<OccluderMesh>();
+	}
+
+	std::vector<glm::vec3> Positions;
+	std::vector<uint32_t>  Indices;
+
+	/// <summary>
+	/// Copies the positions and triangles out of a mesh builder, ideally one that has already been simplified
+	/// (see MeshSimplifier::Simplify)
+	/// </summary>
+	template <typename VertType>
+	static sptr FromMesh(const MeshBuilder<VertType>& mesh) {
+		sptr result = Create();
+		const VertType* vertices = mesh.GetVertexDataPtr();
+		result->Positions.resize(mesh.GetVertexCount());
+		for (size_t ix = 0; ix < mesh.GetVertexCount(); ix++) {
+			result->Positions[ix] = vertices[ix].Position;
+		}
+		if (mesh.GetIndexCount() > 0) {
+			result->Indices.assign(mesh.GetIndexDataPtr(), mesh.GetIndexDataPtr() + mesh.GetIndexCount());
+		} else {
+			result->Indices.resize(mesh.GetVertexCount());
+			for (size_t ix = 0; ix < result->Indices.size(); ix++) {
+				result->Indices[ix] = static_cast<uint32_t>(ix);
+			}
+		}
+		return result;
+	}
+
+	OccluderMesh() = default;
+	~OccluderMesh() = default;
+};
+
+/// <summary>
+/// A small software depth buffer for occlusion culling. Occluders are rasterized into it on the CPU, four pixels at a
+/// time with SSE, with the rows split into bands across the thread pool. A hierarchy of max depths (a Hi-Z pyramid)
+/// is then built from it, so that a box can be tested against just a few texels no matter how big it is on screen.
+///
+/// Depths are stored as window depths from 0 (near) to 1 (far), with the nearest depth kept in each pixel
+/// </summary>
+class OcclusionBuffer final
+{
+public:
+	struct Stats {
+		size_t Occluders;
+		size_t Triangles;   // Triangles that passed setup and were rasterized
+		size_t Tested;
+		size_t Occluded;
+		double RasterMs;    // Setup, rasterization and building the Hi-Z pyramid
+	};
+
+	/// <summary>
+	/// Creates a new occlusion buffer
+	/// </summary>
+	/// <param name="width">The width of the buffer in pixels, will be rounded up to a multiple of 4</param>
+	/// <param name="height">The height of the buffer in pixels</param>
+	OcclusionBuffer(int width = 256, int height = 128);
+	~OcclusionBuffer() = default;
+
+	/// <summary>
+	/// Clears the buffer and the list of occluders, and sets up the camera to draw from
+	/// </summary>
+	/// <param name="viewProjection">The camera's view projection matrix, with OpenGL's -1 to 1 clip depth</param>
+	void Begin(const glm::mat4& viewProjection);
+	/// <summary>
+	/// Adds an occluder to be drawn by the next call to Rasterize. The mesh must stay alive until then
+	/// </summary>
+	/// <param name="mesh">The occluder to draw</param>
+	/// <param name="world">The occluder's world matrix</param>
+	void AddOccluder(const OccluderMesh& mesh, const glm::mat4& world);
+	/// <summary>
+	/// Draws all of the occluders that have been added since Begin, then builds the Hi-Z pyramid
+	/// </summary>
+	void Rasterize();
+
+	/// <summary>
+	/// Tests whether a world space box is completely hidden behind the occluders. Boxes that cross the near plane
+	/// are never occluded. This only reads from the buffer, so it's safe to call from many threads at once
+	/// </summary>
+	bool IsOccluded(const AABB& bounds) const;
+
+	/// <summary>
+	/// Updates the test counters in the stats, since IsOccluded can't do so without racing
+	/// </summary>
+	void AddTestResults(size_t tested, size_t occluded) { _stats.Tested += tested; _stats.Occluded += occluded; }
+
+	int GetWidth() const { return _width; }
+	int GetHeight() const { return _height; }
+	/// <summary>
+	/// Gets the full resolution depths, row by row from the bottom of the screen up
+	/// </summary>
+	const float* GetDepths() const { return _levels[0].Depths.data(); }
+	const Stats& GetStats() const { return _stats; }
+
+private:
+	// A triangle that has been projected to pixel coordinates, with edge and depth equations ready to step across it
+	struct ScreenTriangle {
+		// Edge i is EdgeA[i] * x + EdgeB[i] * y + EdgeC[i], which is positive inside the triangle
+		float EdgeA[3], EdgeB[3], EdgeC[3];
+		// Depth is DepthA * x + DepthB * y + DepthC
+		float DepthA, DepthB, DepthC;
+		int   MinX, MaxX, MinY, MaxY;
+	};
+	struct Occluder {
+		const OccluderMesh* Mesh;
+		glm::mat4           ModelViewProjection;
+	};
+	struct Level {
+		int Width, Height;
+		std::vector<float> Depths;
+	};
+
+	int _width, _height;
+	glm::mat4 _viewProjection;
+	std::vector<Occluder> _occluders;
+	// The set up triangles for each occluder, kept around so we don't reallocate them every frame
+	std::vector<std::vector<ScreenTriangle>> _triangles;
+	// Level 0 is the full buffer, each level after stores the max depth of 2x2 texels in the level before
+	std::vector<Level> _levels;
+	Stats _stats;
+
+	void _SetupTriangles(const Occluder& occluder, std::vector<ScreenTriangle>& results) const;
+	void _RasterizeRows(int firstRow, int lastRow);
+	void _BuildHierarchy();
+};
@@ -0,0 +1,183 @@
+#include "RenderQueue.h"
+
+#include <cstring>
+#include <utility>
+
+RenderQueue::RenderQueue() :
+	_isOrderDirty(false),
+	_isInstancingEnabled(true),
+	_stats(Stats())
+{
+	_objectBuffer = StreamingBuffer::Create(GL_SHADER_STORAGE_BUFFER, sizeof(ObjectData) * 256);
+}
+
+uint64_t RenderQueue::_MakeKey(const ShaderMaterial* material, const VertexArrayObject* mesh) {
+	// Higher layers are drawn last, we offset by 128 so that negative layers still sort first
+	const uint64_t layer = static_cast<uint64_t>(glm::clamp(material->RenderLayer + 128, 0, 255));
+	// The IDs get masked down to fit, if two of them end up sharing a value we just batch slightly less well
+	const uint64_t shader = material->Shader->GetHandle() & 0xFFF;
+	const uint64_t mat    = material->GetId() & 0xFFFF;
+	const uint64_t vao    = mesh->GetHandle() & 0xFFFFF;
+
+	return (layer << 56) | (shader << 44) | (mat << 28) | (vao << 8);
+}
+
+uint64_t RenderQueue::_GetDepthBucket(float viewDepth) {
+	// The bits of a positive float sort the same as the float itself, so taking the exponent and the top 4 bits of
+	// the mantissa gives us 16 buckets per doubling of distance. We start at a depth of 0.25, giving us 256 buckets
+	// that cover up to ~16000 units from the camera. Coarse buckets mean a moving camera rarely changes any keys
+	uint32_t depthBits;
+	viewDepth = glm::max(viewDepth, 0.0f);
+	memcpy(&depthBits, &viewDepth, sizeof(float));
+	const int64_t bucket = static_cast<int64_t>(depthBits >> 19) - (125 << 4);
+	return static_cast<uint64_t>(glm::clamp<int64_t>(bucket, 0, 255));
+}
+
+void RenderQueue::_Push(const DrawItem& item, uint64_t key) {
+	const size_t slot = _items.size();
+	_items.push_back(item);
+	// We check against what this slot had last frame as we go, so Flush knows right away if last frame's order still works
+	if (slot >= _keys.size()) {
+		_keys.push_back(key);
+		_isOrderDirty = true;
+	} else if (_keys[slot] != key) {
+		_keys[slot] = key;
+		_isOrderDirty = true;
+	}
+}
+
+void RenderQueue::Submit(const ShaderMaterial::sptr& material, const VertexArrayObject::sptr& mesh, const Transform& transform, float viewDepth) {
+	_Push({ material.get(), mesh.get(), &transform }, _MakeKey(material.get(), mesh.get()) | _GetDepthBucket(viewDepth));
+}
+
+void RenderQueue::Submit(RendererComponent& renderer, const VertexArrayObject::sptr& mesh, const Transform& transform, float viewDepth) {
+	ShaderMaterial* material = renderer.Material.get();
+	RendererComponent::SortKeyCache& cache = renderer.SortKey;
+	// The mesh can change from frame to frame when the renderer has LODs, so we check the one we're actually drawing
+	if (!cache.IsValid || cache.MaterialId != material->GetId() || cache.MeshId != mesh->GetId() ||
+		cache.ShaderId != material->Shader->GetId() || cache.RenderLayer != material->RenderLayer) {
+		cache.Key         = _MakeKey(material, mesh.get());
+		cache.IsValid     = true;
+		cache.MaterialId  = material->GetId();
+		cache.ShaderId    = material->Shader->GetId();
+		cache.RenderLayer = material->RenderLayer;
+		cache.MeshId      = mesh->GetId();
+	}
+	_Push({ material, mesh.get(), &transform }, cache.Key | _GetDepthBucket(viewDepth));
+}
+
+void RenderQueue::_Sort() {
+	const size_t count = _items.size();
+	_sortBuffer.resize(count);
+	_sortScratch.resize(count);
+
+	// Count how many keys have each value for every byte of the key in a single pass
+	uint32_t histograms[8][256] = { };
+	for (size_t ix = 0; ix < count; ix++) {
+		const uint64_t key = _keys[ix];
+		_sortBuffer[ix] = { key, static_cast<uint32_t>(ix) };
+		for (int byte = 0; byte < 8; byte++) {
+			histograms[byte][(key >> (byte * 8)) & 0xFF]++;
+		}
+	}
+
+	// LSD radix sort, one byte at a time from the lowest. Each pass is stable, so after the last pass the entries
+	// are sorted by the whole key, and equal keys stay in the order they were submitted
+	SortEntry* src = _sortBuffer.data();
+	SortEntry* dst = _sortScratch.data();
+	for (int byte = 0; byte < 8; byte++) {
+		const int shift = byte * 8;
+		uint32_t* counts = histograms[byte];
+		// Most bytes are the same for every key (ex: everything is on the same layer), those passes wouldn't move anything
+		if (counts[(src[0].Key >> shift) & 0xFF] == count) {
+			continue;
+		}
+		// Turn the counts into the offset where each value starts
+		uint32_t offset = 0;
+		for (int value = 0; value < 256; value++) {
+			const uint32_t valueCount = counts[value];
+			counts[value] = offset;
+			offset += valueCount;
+		}
+		for (size_t ix = 0; ix < count; ix++) {
+			dst[counts[(src[ix].Key >> shift) & 0xFF]++] = src[ix];
+		}
+		std::swap(src, dst);
+	}
+
+	_order.resize(count);
+	for (size_t ix = 0; ix < count; ix++) {
+		_order[ix] = src[ix].Index;
+	}
+}
+
+void RenderQueue::Flush(const std::function<void(const Shader::sptr&)>& setupShader) {
+	_stats = Stats();
+	_stats.Objects = _items.size();
+	if (_items.empty()) {
+		return;
+	}
+
+	// The keys are ordered by render layer first (higher numbers get drawn last), then by shader and material so we
+	// minimize context switches. Mesh comes next, which puts everything that can be drawn together right next to each
+	// other. If every slot got the same key as last frame, last frame's order is still correct
+	if (_keys.size() != _items.size()) {
+		_keys.resize(_items.size());
+		_isOrderDirty = true;
+	}
+	if (_isOrderDirty) {
+		_Sort();
+		_stats.Resorted = true;
+		_isOrderDirty = false;
+	}
+
+	// Grab this frame's slice of the object buffer, with room for every object
+	ObjectData* objects = _objectBuffer->BeginFrame<ObjectData>(_items.size());
+	_objectBuffer->BindFrame(OBJECT_BUFFER_BINDING);
+
+	Shader* currentShader = nullptr;
+	ShaderMaterial* currentMaterial = nullptr;
+	for (size_t first = 0; first < _order.size();) {
+		const DrawItem& item = _items[_order[first]];
+		// If the shader has changed, set up it's uniforms
+		if (item.Material->Shader.get() != currentShader) {
+			currentShader = item.Material->Shader.get();
+			currentShader->Bind();
+			setupShader(item.Material->Shader);
+			_stats.ShaderChanges++;
+		}
+		// If the material has changed, apply it
+		if (item.Material != currentMaterial) {
+			currentMaterial = item.Material;
+			currentMaterial->Apply();
+			_stats.MaterialChanges++;
+		}
+
+		// Find the run of objects that we can draw along with this one
+		size_t last = first + 1;
+		if (_isInstancingEnabled) {
+			while (last < _order.size() && _items[_order[last]].Material == item.Material && _items[_order[last]].Mesh == item.Mesh) {
+				last++;
+			}
+		}
+
+		// This points into mapped GPU memory, so we should only ever write to it (reading back can be very slow)
+		for (size_t ix = first; ix < last; ix++) {
+			const Transform& transform = *_items[_order[ix]].ObjectTransform;
+			const glm::mat3& normalMatrix = transform.WorldNormalMatrix();
+			ObjectData& data = objects[ix];
+			data.Model = transform.WorldTransform();
+			data.NormalMatrix[0] = glm::vec4(normalMatrix[0], 0.0f);
+			data.NormalMatrix[1] = glm::vec4(normalMatrix[1], 0.0f);
+			data.NormalMatrix[2] = glm::vec4(normalMatrix[2], 0.0f);
+		}
+
+		// The shader finds each instance's data using the base instance, so the whole run is one draw call
+		item.Mesh->RenderInstanced(static_cast<GLsizei>(last - first), static_cast<GLuint>(first));
+		_stats.DrawCalls++;
+		first = last;
+	}
+
+	_objectBuffer->EndFrame();
+	_items.clear();
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <functional>
+#include <vector>
+
+#include "Gameplay/RendererComponent.h"
+#include "Gameplay/ShaderMaterial.h"
+#include "Gameplay/Transform.h"
+#include "Graphics/StreamingBuffer.h"
+#include "Graphics/VertexArrayObject.h"
+#include "Utilities/Macros.h"
+
+/// <summary>
+/// Collects everything that needs to be drawn in a frame, then sorts it to minimize state changes and draws objects
+/// that share a mesh and material with a single instanced draw call. The matrices for each object are streamed to
+/// the shaders through a storage buffer (see ObjectData in vertex_shader.glsl)
+/// 
+/// Each submitted object gets a 64 bit sort key. Renderers keep the material and mesh part of their key between frames,
+/// and only rebuild it when those change. The keys live in a flat array with one slot per submission, and the sorted
+/// order is kept between frames. We only re-sort (with a radix sort) when a slot's key changes or the number of
+/// objects does, so static scenes don't pay for sorting at all
+/// </summary>
+class RenderQueue final
+{
+	SMART_MEMORY_MANAGED(RenderQueue)
+public:
+	/// <summary>
+	/// The data for a single object that our vertex shaders read from the object buffer, this must match the
+	/// std430 layout of ObjectData in vertex_shader.glsl (mat3 columns are padded out to vec4s)
+	/// </summary>
+	struct ObjectData {
+		glm::mat4 Model;
+		glm::vec4 NormalMatrix[3];
+	};
+
+	/// <summary>
+	/// The binding index that the per-object data is bound to in our shaders
+	/// </summary>
+	static constexpr GLuint OBJECT_BUFFER_BINDING = 0;
+
+	/// <summary>
+	/// Counters for the last frame that was flushed, for showing in the debug UI
+	/// </summary>
+	struct Stats {
+		size_t Objects = 0;
+		size_t DrawCalls = 0;
+		size_t ShaderChanges = 0;
+		size_t MaterialChanges = 0;
+		bool   Resorted = false;
+	};
+
+	RenderQueue();
+	~RenderQueue() = default;
+
+	/// <summary>
+	/// Queues an object to be drawn in the next flush. The material, mesh and transform must stay alive until then
+	/// </summary>
+	/// <param name="material">The material to draw the object with</param>
+	/// <param name="mesh">The mesh to draw</param>
+	/// <param name="transform">The transform of the object, it's world matrix should already be up to date</param>
+	/// <param name="viewDepth">The distance from the camera to the object, objects that otherwise match are drawn front to back</param>
+	void Submit(const ShaderMaterial::sptr& material, const VertexArrayObject::sptr& mesh, const Transform& transform, float viewDepth = 0.0f);
+	/// <summary>
+	/// Queues a renderer to be drawn in the next flush, reusing the sort key stored on the renderer unless it's material
+	/// or mesh has changed (the renderer's SortKey is updated otherwise). The renderer, it's material, the mesh and the
+	/// transform must stay alive until then
+	/// </summary>
+	/// <param name="renderer">The renderer to draw, which provides the material</param>
+	/// <param name="mesh">The mesh to draw, either the renderer's mesh or one of it's LODs</param>
+	/// <param name="transform">The transform of the object, it's world matrix should already be up to date</param>
+	/// <param name="viewDepth">The distance from the camera to the object, objects that otherwise match are drawn front to back</param>
+	void Submit(RendererComponent& renderer, const VertexArrayObject::sptr& mesh, const Transform& transform, float viewDepth = 0.0f);
+
+	/// <summary>
+	/// Draws everything that has been submitted since the last flush, and empties the queue
+	/// </summary>
+	/// <param name="setupShader">Invoked whenever we switch to a new shader, to set up it's per-frame uniforms</param>
+	void Flush(const std::function<void(const Shader::sptr&)>& setupShader);
+
+	/// <summary>
+	/// Sets whether objects that share a mesh and material are merged into instanced draws. If disabled, every
+	/// object gets it's own draw call (mostly useful for comparing performance)
+	/// </summary>
+	void SetInstancingEnabled(bool value) { _isInstancingEnabled = value; }
+	bool IsInstancingEnabled() const { return _isInstancingEnabled; }
+
+	/// <summary>
+	/// Gets the counters for the last frame that was flushed
+	/// </summary>
+	const Stats& GetStats() const { return _stats; }
+
+private:
+	struct DrawItem {
+		ShaderMaterial*    Material;
+		VertexArrayObject* Mesh;
+		const Transform*   ObjectTransform;
+	};
+	struct SortEntry {
+		uint64_t Key;
+		uint32_t Index;
+	};
+
+	std::vector<DrawItem> _items;
+	// The sort key for each slot in _items, kept between frames so that Submit can tell when a slot changes
+	std::vector<uint64_t> _keys;
+	bool                  _isOrderDirty;
+	// The indices into _items in the order that we draw them, kept between frames
+	std::vector<uint32_t> _order;
+	std::vector<SortEntry> _sortBuffer;
+	std::vector<SortEntry> _sortScratch;
+	StreamingBuffer::sptr _objectBuffer;
+	bool                  _isInstancingEnabled;
+	Stats                 _stats;
+
+	/// <summary>
+	/// Packs the render layer, shader, material and mesh into the top 56 bits of a key, in order of priority
+	/// </summary>
+	static uint64_t _MakeKey(const ShaderMaterial* material, const VertexArrayObject* mesh);
+	/// <summary>
+	/// Gets the depth bucket for the bottom 8 bits of a key
+	/// </summary>
+	static uint64_t _GetDepthBucket(float viewDepth);
+	/// <summary>
+	/// Adds an item to the queue, marking the order as dirty if it's key doesn't match what it's slot had last frame
+	/// </summary>
+	void _Push(const DrawItem& item, uint64_t key);
+	/// <summary>
+	/// Rebuilds _order by radix sorting the current keys
+	/// </summary>
+	void _Sort();
+};
@@ -1,12 +1,65 @@
 #pragma once
+#include <vector>
 #include "Graphics/VertexArrayObject.h"
 #include "Gameplay/ShaderMaterial.h"
 
 class RendererComponent {
 public:
+	/// <summary>
+	/// A lower detail version of the mesh, which is used when the object is smaller than MaxScreenSize on screen
+	/// </summary>
+	struct LodLevel {
+		VertexArrayObject::sptr Mesh;
+		/// <summary>
+		/// The largest size on screen (as a fraction of the screen's height) where this level can be used
+		/// </summary>
+		float MaxScreenSize;
+	};
+
+	/// <summary>
+	/// The draw order key that RenderQueue made for this renderer, and the IDs of what it was made from. The queue only
+	/// remakes it when the material (or it's shader or render layer) or the mesh being drawn changes. We track IDs instead
+	/// of pointers since IDs are never reused, so a new object at a freed object's address can't match. Only RenderQueue
+	/// should touch this
+	/// </summary>
+	struct SortKeyCache {
+		uint64_t Key         = 0;
+		bool     IsValid     = false;
+		uint32_t MaterialId  = 0;
+		uint32_t ShaderId    = 0;
+		int      RenderLayer = 0;
+		uint32_t MeshId      = 0;
+	};
+
 	VertexArrayObject::sptr Mesh;
 	ShaderMaterial::sptr    Material;
+	// Optional lower detail meshes, from most to least detailed
+	std::vector<LodLevel>   Lods;
+	// The radius of the mesh's bounding sphere around it's origin, used to figure out how big it is on screen
+	float                   BoundingRadius = 0.0f;
+	// If set, the CullingSystem treats this renderer as if it had no bounds, so it's always drawn (ex: a skybox that
+	// is drawn around the camera no matter where it's mesh is)
+	bool                    IsNeverCulled = false;
+	// Filled in by RenderQueue::Submit, so anything submitting renderers needs write access to them
+	SortKeyCache            SortKey;
 
 	RendererComponent& SetMesh(const VertexArrayObject::sptr& mesh) { Mesh = mesh; return *this; }
 	RendererComponent& SetMaterial(const ShaderMaterial::sptr& material) { Material = material; return *this; }
-};
\ No newline at end of file
+	RendererComponent& SetBoundingRadius(float radius) { BoundingRadius = radius; return *this; }
+	RendererComponent& SetNeverCulled(bool neverCulled) { IsNeverCulled = neverCulled; return *this; }
+	RendererComponent& AddLod(const VertexArrayObject::sptr& mesh, float maxScreenSize) { Lods.push_back({ mesh, maxScreenSize }); return *this; }
+
+	/// <summary>
+	/// Gets the mesh to draw for an object that covers the given fraction of the screen's height
+	/// </summary>
+	const VertexArrayObject::sptr& GetMeshForScreenSize(float screenSize) const {
+		const VertexArrayObject::sptr* result = &Mesh;
+		for (const LodLevel& lod : Lods) {
+			if (screenSize > lod.MaxScreenSize) {
+				break;
+			}
+			result = &lod.Mesh;
+		}
+		return *result;
+	}
+};
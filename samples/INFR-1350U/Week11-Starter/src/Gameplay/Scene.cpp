@@ -1,16 +1,46 @@
 #include "Scene.h"
 
 #include "Transform.h"
+#include "TransformSystem.h"
 #include "GameObjectTag.h"
 #include "Logging.h"
 
 entt::registry GameScene::_prefabRegistry;
-std::unordered_map<entt::id_type, StampFunction> GameScene::_stampFunctions;
+std::unordered_map<entt::id_type, GameScene::ComponentStamper> GameScene::_stampFunctions;
+
+namespace {
+	/*
+	 * Transforms hold a handle to their own entity and links to other entities in the hierarchy, so we can't copy them
+	 * as is. Instead we make a new root transform and copy the local position, rotation and scale over
+	 */
+	void StampTransform(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity dst) {
+		const Transform& source = from.get<Transform>(src);
+		to.emplace_or_replace<Transform>(dst, entt::handle(to, dst))
+			.SetLocalPosition(source.GetLocalPosition())
+			.SetLocalRotation(source.GetLocalRotationQuat())
+			.SetLocalScale(source.GetLocalScale());
+	}
+
+	void StampTransforms(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity* first, const entt::entity* last) {
+		const Transform& source = from.get<Transform>(src);
+		to.reserve<Transform>(to.size<Transform>() + (last - first));
+		for (const entt::entity* dst = first; dst != last; dst++) {
+			to.emplace<Transform>(*dst, entt::handle(to, *dst))
+				.SetLocalPosition(source.GetLocalPosition())
+				.SetLocalRotation(source.GetLocalRotationQuat())
+				.SetLocalScale(source.GetLocalScale());
+		}
+	}
+}
 
 GameScene::GameScene(const std::string& name) {
 	Name = name;
+	TransformSystem::Initialize(_registry);
+	_registry.on_construct<GameObjectTag>().connect<&GameScene::_OnTagAdded>(*this);
+	_registry.on_update<GameObjectTag>().connect<&GameScene::_OnTagUpdated>(*this);
+	_registry.on_destroy<GameObjectTag>().connect<&GameScene::_OnTagRemoved>(*this);
 
-	RegisterComponentType<Transform>();
+	RegisterComponentType<Transform>(&StampTransform, &StampTransforms);
 	RegisterComponentType<GameObjectTag>();
 }
 
@@ -30,25 +60,109 @@ entt::handle GameScene::CreateEntity(entt::entity prefab, const std::string& nam
 	return entt::handle(_registry, instance);
 }
 
+std::vector<entt::entity> GameScene::CreateEntities(entt::entity prefab, size_t count) {
+	LOG_ASSERT(_prefabRegistry.valid(prefab), "Entity is not a valid prefab! You may need to call CreatePrefab(entity_id) first!");
+
+	// Look up how to copy each of the prefab's components once, instead of once per entity
+	std::vector<const ComponentStamper*> plan;
+	_prefabRegistry.visit(prefab, [&](const auto typeId) {
+		auto it = _stampFunctions.find(typeId);
+		if (it != _stampFunctions.end()) {
+			plan.push_back(&it->second);
+		} else {
+			LOG_WARN("Prefab has a component type that was not registered with RegisterComponentType, it will not be copied");
+		}
+	});
+
+	std::vector<entt::entity> result(count);
+	_registry.create(result.begin(), result.end());
+	const entt::entity* first = result.data();
+	const entt::entity* last = first + count;
+	for (const ComponentStamper* stamper : plan) {
+		if (stamper->Batch != nullptr) {
+			stamper->Batch(_prefabRegistry, prefab, _registry, first, last);
+		} else {
+			for (const entt::entity* dst = first; dst != last; dst++) {
+				stamper->Single(_prefabRegistry, prefab, _registry, *dst);
+			}
+		}
+	}
+	return result;
+}
+
 entt::handle GameScene::FindFirst(const std::string& name)
 {
-	entt::entity result = entt::null;
-	uint32_t hash = entt::hashed_string::value(name.c_str());
-	const auto view = _registry.view<GameObjectTag>();
-	
-	for(const entt::entity& entity : view) {
-		const GameObjectTag& tag = _registry.get<GameObjectTag>(entity);
-		if (tag.HashedName == hash && tag.Name == name) {
-			return entt::handle(_registry, entity);
+	std::vector<entt::entity>* list = _FindNameList(name);
+	if (list != nullptr) {
+		for (entt::entity entity : *list) {
+			// Different names can have the same hash, so we still need to check the actual name
+			if (_registry.get<GameObjectTag>(entity).Name == name) {
+				return entt::handle(_registry, entity);
+			}
 		}
 	}
 	return entt::handle(_registry, entt::null);
 }
 
+std::vector<entt::handle> GameScene::FindAll(const std::string& name)
+{
+	std::vector<entt::handle> result;
+	std::vector<entt::entity>* list = _FindNameList(name);
+	if (list != nullptr) {
+		for (entt::entity entity : *list) {
+			if (_registry.get<GameObjectTag>(entity).Name == name) {
+				result.emplace_back(_registry, entity);
+			}
+		}
+	}
+	return result;
+}
+
+std::vector<entt::entity>* GameScene::_FindNameList(const std::string& name) {
+	auto it = _nameIndex.find(entt::hashed_string::value(name.c_str()));
+	return it != _nameIndex.end() ? &it->second : nullptr;
+}
+
+void GameScene::_OnTagAdded(entt::registry& registry, entt::entity entity) {
+	const uint32_t hash = registry.get<GameObjectTag>(entity).HashedName;
+	std::vector<entt::entity>& list = _nameIndex[hash];
+
+	const size_t slot = entt::to_integral(entity) & entt::entt_traits<entt::entity>::entity_mask;
+	if (slot >= _nameSlots.size()) {
+		_nameSlots.resize(slot + 1);
+	}
+	_nameSlots[slot] = { hash, static_cast<uint32_t>(list.size()) };
+	list.push_back(entity);
+}
+
+void GameScene::_OnTagRemoved(entt::registry&, entt::entity entity) {
+	const NameSlot slot = _nameSlots[entt::to_integral(entity) & entt::entt_traits<entt::entity>::entity_mask];
+	auto it = _nameIndex.find(slot.HashedName);
+	std::vector<entt::entity>& list = it->second;
+
+	// Swap the last entity into our spot, so removing is constant time
+	const entt::entity last = list.back();
+	list[slot.Index] = last;
+	_nameSlots[entt::to_integral(last) & entt::entt_traits<entt::entity>::entity_mask].Index = slot.Index;
+	list.pop_back();
+	if (list.empty()) {
+		_nameIndex.erase(it);
+	}
+}
+
+void GameScene::_OnTagUpdated(entt::registry& registry, entt::entity entity) {
+	// registry.patch only changes the name, so the hash has to be brought up to date from it
+	GameObjectTag& tag = registry.get<GameObjectTag>(entity);
+	tag.HashedName = entt::hashed_string::value(tag.Name.c_str());
+	// The slot still has the old hash, so we can take it out of the old list before adding it to the new one
+	_OnTagRemoved(registry, entity);
+	_OnTagAdded(registry, entity);
+}
+
 entt::handle GameScene::StampEntity(const entt::registry& from, entt::entity src, entt::registry& to) {
 	entt::entity dst = to.create();
 	from.visit(src, [&from, &to, src, dst](const auto type_id) {
-		_stampFunctions[type_id](from, src, to, dst);
+		_stampFunctions[type_id].Single(from, src, to, dst);
 	});
 	return entt::handle(to, dst);
 }
@@ -1,11 +1,16 @@
 #pragma once
 #include "entt.hpp"
 #include "Utilities/Macros.h"
+#include "SystemScheduler.h"
 
 /// <summary>
 /// Represents a callback that may be used to customize how entity stamping works between registries
 /// </summary>
 typedef void(*StampFunction)(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity dst);
+/// <summary>
+/// Represents a callback that stamps one component from <i>src</i> onto every entity in [first, last) at once
+/// </summary>
+typedef void(*BatchStampFunction)(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity* first, const entt::entity* last);
 
 typedef entt::handle GameObject;
 
@@ -21,11 +26,39 @@ public:
 	
 	entt::handle CreateEntity(const std::string& name = "");
 	entt::handle CreateEntity(entt::entity prefab, const std::string& name = "");
+	/// <summary>
+	/// Creates many copies of a prefab at once. The list of components to copy is worked out once, the entities are
+	/// created together, and each component type is added to all of them in one go
+	/// </summary>
+	/// <param name="prefab">The entity in the prefab registry to copy</param>
+	/// <param name="count">The number of copies to make</param>
+	/// <returns>The new entities, in the order they were created</returns>
+	std::vector<entt::entity> CreateEntities(entt::entity prefab, size_t count);
 
+	/// <summary>
+	/// Finds an entity with the given name, or a null handle if there are none. This is a hash lookup, so it's fine to
+	/// call every frame
+	/// </summary>
+	/// <param name="name">The name to search for</param>
 	entt::handle FindFirst(const std::string& name);
+	/// <summary>
+	/// Finds every entity with the given name
+	/// </summary>
+	/// <param name="name">The name to search for</param>
+	/// <returns>Handles to all the entities with the name, in no particular order</returns>
+	std::vector<entt::handle> FindAll(const std::string& name);
 
 	entt::registry& Registry() { return _registry; }
 
+	/// <summary>
+	/// Gets the systems that run on this scene each frame, add to this with SystemScheduler::AddSystem
+	/// </summary>
+	SystemScheduler& Systems() { return _systems; }
+	/// <summary>
+	/// Runs all of the scene's systems once, see SystemScheduler::Run
+	/// </summary>
+	void RunSystems() { _systems.Run(_registry); }
+
 	/// <summary>
 	/// Perform any tasks that should happen at the end of a loop, such as deleting queued objects
 	/// </summary>
@@ -45,21 +78,56 @@ public:
 	/// <returns>A handle for the newly created entity</returns>
 	static entt::handle StampEntity(const entt::registry& from, entt::entity src, entt::registry& to);
 
+	/// <summary>
+	/// Lets the scene copy a component type from prefabs
+	/// </summary>
+	/// <param name="stampOverride">A custom function for copying the component, or nullptr to copy it as is</param>
+	/// <param name="batchOverride">A custom function for copying the component to many entities, if this is nullptr and
+	/// stampOverride is not, stampOverride will be called for each entity</param>
 	template <typename Type>
-	static void RegisterComponentType(StampFunction stampOverride = nullptr) {
-		_stampFunctions[entt::type_info<Type>::id()] = stampOverride != nullptr ? stampOverride : &_DefaultComponentStamp<Type>;
+	static void RegisterComponentType(StampFunction stampOverride = nullptr, BatchStampFunction batchOverride = nullptr) {
+		ComponentStamper& stamper = _stampFunctions[entt::type_info<Type>::id()];
+		stamper.Single = stampOverride != nullptr ? stampOverride : &_DefaultComponentStamp<Type>;
+		stamper.Batch = batchOverride != nullptr ? batchOverride : stampOverride != nullptr ? nullptr : &_DefaultBatchStamp<Type>;
 	}
 	static entt::registry& Prefabs() { return _prefabRegistry; }
 	
 private:
+	// Where an entity sits in the name index, so that it can be removed without searching
+	struct NameSlot {
+		uint32_t HashedName;
+		uint32_t Index;
+	};
+
+	// Entities by the hash of their name, kept up to date by the GameObjectTag signals. These are declared before the
+	// registry so that they outlive it
+	std::unordered_map<uint32_t, std::vector<entt::entity>> _nameIndex;
+	std::vector<NameSlot> _nameSlots; // By entity index
+	
 	entt::registry _registry;
+	SystemScheduler _systems;
 	std::vector<entt::entity> _deletionQueue;
 
+	struct ComponentStamper {
+		StampFunction      Single;
+		BatchStampFunction Batch;
+	};
+
 	static entt::registry _prefabRegistry;
-	static std::unordered_map<entt::id_type, StampFunction> _stampFunctions;
+	static std::unordered_map<entt::id_type, ComponentStamper> _stampFunctions;
+
+	void _OnTagAdded(entt::registry& registry, entt::entity entity);
+	void _OnTagRemoved(entt::registry& registry, entt::entity entity);
+	void _OnTagUpdated(entt::registry& registry, entt::entity entity);
+	std::vector<entt::entity>* _FindNameList(const std::string& name);
 
 	template <typename T>
 	static void _DefaultComponentStamp(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity dst) {
 		to.emplace_or_replace<T>(dst, from.get<T>(src));
 	}
+	template <typename T>
+	static void _DefaultBatchStamp(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity* first, const entt::entity* last) {
+		// The entities are brand new, so they can all go on the end of the pool together
+		to.insert<T>(first, last, from.get<T>(src));
+	}
 };
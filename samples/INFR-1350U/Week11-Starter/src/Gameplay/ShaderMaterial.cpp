@@ -1,92 +1,132 @@
 #include "ShaderMaterial.h"
 
-template<typename T>
-void SubmitUniforms(const Shader::sptr& shader, const std::unordered_map<ShaderParamName, T>& values) {
-	for (auto& kvp : values) {
-		shader->SetUniform(kvp.first.Location, kvp.second);
-	}
-}
+#include <cstring>
 
-template<typename T>
-void SubmitUniformsMat(const Shader::sptr& shader, const std::unordered_map<ShaderParamName, T>& values) {
-	for (auto& kvp : values) {
-		shader->SetUniformMatrix(kvp.first.Location, kvp.second);
-	}
-}
+#include "Graphics/GLState.h"
+
+uint32_t ShaderMaterial::_nextId = 0;
 
 ShaderMaterial::ShaderMaterial()
-	: Shader(nullptr),  RenderLayer(0)
+	: Shader(nullptr),  RenderLayer(0), _id(_nextId++),
+	_layoutShader(nullptr), _blockBuffer(0), _isBlockDirty(false)
 {
 }
 
 ShaderMaterial::~ShaderMaterial() {
 	LOG_INFO("Deleting material");
+	if (_blockBuffer != 0) {
+		GLState::OnBufferDeleted(_blockBuffer);
+		glDeleteBuffers(1, &_blockBuffer);
+		_blockBuffer = 0;
+	}
 }
 
 void ShaderMaterial::Apply()
-{	
-	int slot = 1;
-	for (auto& kvp : Textures) {
-		if (kvp.first.Location != -1 && kvp.second != nullptr) {
-			Shader->SetUniform(kvp.first.Location, slot);
-			kvp.second->Bind(slot);
-			slot++;
+{
+	if (_layoutShader != Shader) {
+		_UpdateLayout();
+	}
+
+	// Only upload the block when a value has changed, otherwise it's already sitting on the GPU
+	if (_blockBuffer != 0) {
+		if (_isBlockDirty) {
+			glNamedBufferSubData(_blockBuffer, 0, _blockData.size(), _blockData.data());
+			_isBlockDirty = false;
 		}
+		GLState::BindBufferRange(GL_UNIFORM_BUFFER, Shader::MATERIAL_BLOCK_BINDING, _blockBuffer, 0, _blockData.size());
+	}
+
+	// Textures can recreate their handle when they are reloaded (ex: at a new size), so we look the handles up each time
+	for (size_t ix = 0; ix < _textures.size(); ix++) {
+		_textureHandles[ix] = _textures[ix] != nullptr ? _textures[ix]->GetHandle() : 0;
+	}
+	// The shader gives each sampler it's own unit starting from 0, so we can bind all our textures at once. Units that
+	// already hold the right texture (ex: from the last material with this shader) are skipped
+	GLState::BindTextures(0, static_cast<GLsizei>(_textureHandles.size()), _textureHandles.data());
+}
+
+void ShaderMaterial::SetShaderVariant(const ShaderVariantSet::sptr& variants, uint32_t features) {
+	Shader = variants->Get(features);
+}
+
+void ShaderMaterial::_UpdateLayout() {
+	_layoutShader = Shader;
+
+	if (_blockBuffer != 0) {
+		GLState::OnBufferDeleted(_blockBuffer);
+		glDeleteBuffers(1, &_blockBuffer);
+		_blockBuffer = 0;
+	}
+	_blockData.assign(Shader != nullptr ? Shader->GetMaterialBlockSize() : 0, 0);
+	if (!_blockData.empty()) {
+		glCreateBuffers(1, &_blockBuffer);
+		glNamedBufferStorage(_blockBuffer, _blockData.size(), nullptr, GL_DYNAMIC_STORAGE_BIT);
 	}
+	_isBlockDirty = true;
 
-	SubmitUniforms(Shader, FloatParams);
-	SubmitUniforms(Shader, Vec2Params);
-	SubmitUniforms(Shader, Vec3Params);
-	SubmitUniforms(Shader, Vec4Params);
-	SubmitUniformsMat(Shader, Mat4Params);
-	SubmitUniformsMat(Shader, Mat3Params);
+	const int unitCount = Shader != nullptr ? Shader->GetTextureUnitCount() : 0;
+	_textures.assign(unitCount, nullptr);
+	_textureHandles.assign(unitCount, 0);
+}
+
+void ShaderMaterial::_SetBlockValue(const std::string& name, GLenum type, const float* data, int columns, int rows) {
+	LOG_ASSERT(Shader != nullptr, "Must set Material shader before setting params");
+	if (_layoutShader != Shader) {
+		_UpdateLayout();
+	}
+
+	const Shader::BlockUniform* uniform = Shader->GetMaterialUniform(name);
+	if (uniform == nullptr) {
+		LOG_WARN("Ignoring material value \"{}\", it is not in the shader's {} block", name, Shader::MATERIAL_BLOCK_NAME);
+		return;
+	}
+	if (uniform->Type != type) {
+		LOG_WARN("Ignoring material value \"{}\", the type does not match the shader", name);
+		return;
+	}
+
+	// Matrix columns are padded out in std140 (a mat3 column takes up a vec4), so copy them one at a time
+	const int stride = columns > 1 ? uniform->MatrixStride : 0;
+	for (int col = 0; col < columns; col++) {
+		memcpy(_blockData.data() + uniform->Offset + col * stride, data + col * rows, rows * sizeof(float));
+	}
+	_isBlockDirty = true;
 }
 
 void ShaderMaterial::Set(const std::string& name, const ITexture::sptr& texture) {
 	LOG_ASSERT(Shader != nullptr, "Must set Material shader before setting params");
-	ShaderParamName pName = name;
-	pName.Location = Shader->GetUniformLocation(name);
-	Textures[pName] = texture;
+	if (_layoutShader != Shader) {
+		_UpdateLayout();
+	}
+
+	const int unit = Shader->GetTextureUnit(name);
+	if (unit == -1) {
+		LOG_WARN("Ignoring texture \"{}\", the shader has no sampler with that name", name);
+		return;
+	}
+	_textures[unit] = texture;
 }
 
 void ShaderMaterial::Set(const std::string& name, float value) {
-	LOG_ASSERT(Shader != nullptr, "Must set Material shader before setting params");
-	ShaderParamName pName = name;
-	pName.Location = Shader->GetUniformLocation(name);
-	FloatParams[pName] = value;
+	_SetBlockValue(name, GL_FLOAT, &value, 1, 1);
 }
 
 void ShaderMaterial::Set(const std::string& name, const glm::vec2& value) {
-	LOG_ASSERT(Shader != nullptr, "Must set Material shader before setting params");
-	ShaderParamName pName = name;
-	pName.Location = Shader->GetUniformLocation(name);
-	Vec2Params[pName] = value;
+	_SetBlockValue(name, GL_FLOAT_VEC2, glm::value_ptr(value), 1, 2);
 }
 
 void ShaderMaterial::Set(const std::string& name, const glm::vec3& value) {
-	LOG_ASSERT(Shader != nullptr, "Must set Material shader before setting params");
-	ShaderParamName pName = name;
-	pName.Location = Shader->GetUniformLocation(name);
-	Vec3Params[pName] = value;
+	_SetBlockValue(name, GL_FLOAT_VEC3, glm::value_ptr(value), 1, 3);
 }
 
 void ShaderMaterial::Set(const std::string& name, const glm::vec4& value) {
-	LOG_ASSERT(Shader != nullptr, "Must set Material shader before setting params");
-	ShaderParamName pName = name;
-	pName.Location = Shader->GetUniformLocation(name);
-	Vec4Params[pName] = value;
+	_SetBlockValue(name, GL_FLOAT_VEC4, glm::value_ptr(value), 1, 4);
 }
 
 void ShaderMaterial::Set(const std::string& name, const glm::mat4& value) {
-	LOG_ASSERT(Shader != nullptr, "Must set Material shader before setting params");
-	ShaderParamName pName = name;
-	pName.Location = Shader->GetUniformLocation(name);
-	Mat4Params[pName] = value;
+	_SetBlockValue(name, GL_FLOAT_MAT4, glm::value_ptr(value), 4, 4);
 }
 
 void ShaderMaterial::Set(const std::string& name, const glm::mat3& value) {
-	LOG_ASSERT(Shader != nullptr, "Must set Material shader before setting params");
-	ShaderParamName pName = name;
-	pName.Location = Shader->GetUniformLocation(name);
-	Mat3Params[pName] = value;
+	_SetBlockValue(name, GL_FLOAT_MAT3, glm::value_ptr(value), 3, 3);
 }
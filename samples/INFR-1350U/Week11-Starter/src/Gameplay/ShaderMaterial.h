@@ -1,35 +1,17 @@
 #pragma once
 #include <string>
+#include <vector>
 #include "Graphics/Shader.h"
+#include "Graphics/ShaderVariantSet.h"
 #include "Graphics/ITexture.h"
 #include "Utilities/Macros.h"
 #include <EnumToString.h>
 
-struct ShaderParamName {
-	std::string Name;
-	int         Location;
-
-	ShaderParamName(const std::string& name) :
-		Name(name), Location(-1) {}
-
-	bool operator ==(const ShaderParamName& r) const {
-		return Name == r.Name;
-	}
-	bool operator !=(const ShaderParamName& r) const {
-		return Name != r.Name;
-	}
-};
-
-namespace  std
-{
-	template<>
-	struct hash<ShaderParamName> {
-		std::size_t operator()(const ShaderParamName& p) const noexcept {
-			return std::hash<std::string>()(p.Name);
-		}
-	};
-}
-
+/// <summary>
+/// A shader along with the values for it's material block and the textures for it's samplers. The values are
+/// packed into a std140 buffer using the layout reflected from the shader (see Shader::MATERIAL_BLOCK_NAME), so
+/// applying a material is a single uniform buffer bind and a single texture bind, no matter how many values it has
+/// </summary>
 class ShaderMaterial {
 	SMART_MEMORY_MANAGED(ShaderMaterial)
 public:
@@ -38,19 +20,19 @@ public:
 	virtual ~ShaderMaterial();
 
 	Shader::sptr Shader;
-	std::unordered_map<ShaderParamName, ITexture::sptr> Textures;
-	std::unordered_map<ShaderParamName, float> FloatParams;
-	std::unordered_map<ShaderParamName, glm::vec2> Vec2Params;
-	std::unordered_map<ShaderParamName, glm::vec3> Vec3Params;
-	std::unordered_map<ShaderParamName, glm::vec4> Vec4Params;
-	std::unordered_map<ShaderParamName, glm::mat4> Mat4Params;
-	std::unordered_map<ShaderParamName, glm::mat3> Mat3Params;
 
 	int RenderLayer;
 	std::string DebugName;
 
 	void Apply();
 
+	/// <summary>
+	/// Sets our shader to a variant from a variant set, compiling it if nobody has requested it yet
+	/// </summary>
+	/// <param name="variants">The variant set to pick the shader from</param>
+	/// <param name="features">The feature bits of the variant (see ShaderVariantSet::GetFeature)</param>
+	void SetShaderVariant(const ShaderVariantSet::sptr& variants, uint32_t features);
+
 	void Set(const std::string& name, const ITexture::sptr& texture);
 	void Set(const std::string& name, float value);
 	void Set(const std::string& name, const glm::vec2& value);
@@ -59,5 +41,37 @@ public:
 	void Set(const std::string& name, const glm::mat4& value);
 	void Set(const std::string& name, const glm::mat3& value);
 
+	/// <summary>
+	/// Gets a small unique number for this material, used to build sort keys when drawing
+	/// </summary>
+	uint32_t GetId() const { return _id; }
+
 protected:
+	uint32_t _id;
+
+	// The shader that our block data and textures are laid out for
+	Shader::sptr _layoutShader;
+	std::vector<char> _blockData;
+	GLuint _blockBuffer;
+	bool   _isBlockDirty;
+	// The textures for each texture unit, indexed by unit
+	std::vector<ITexture::sptr> _textures;
+	// The handles of _textures, filled in by Apply so we can hand them to OpenGL in one call
+	std::vector<GLuint> _textureHandles;
+
+	static uint32_t _nextId;
+
+	/// <summary>
+	/// Resizes our block and texture list to match the current shader, if it has changed since we last laid them out
+	/// </summary>
+	void _UpdateLayout();
+	/// <summary>
+	/// Copies a value into the block at the location reflected from the shader
+	/// </summary>
+	/// <param name="name">The name of the uniform in the material block</param>
+	/// <param name="type">The GLSL type of the value (ex: GL_FLOAT_VEC3), which must match the shader</param>
+	/// <param name="data">The floats making up the value, in column-major order</param>
+	/// <param name="columns">The number of columns in the value (1 for scalars and vectors)</param>
+	/// <param name="rows">The number of floats in each column</param>
+	void _SetBlockValue(const std::string& name, GLenum type, const float* data, int columns, int rows);
 };
@@ -0,0 +1,148 @@
+#include "SystemScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "Utilities/ThreadPool.h"
+
+namespace {
+	/*
+	 * Checks whether two lists of component type IDs have any types in common
+	 */
+	bool Overlaps(const std::vector<entt::id_type>& a, const std::vector<entt::id_type>& b) {
+		for (entt::id_type type : a) {
+			if (std::find(b.begin(), b.end(), type) != b.end()) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+bool SystemScheduler::_Conflicts(const System& a, const System& b) {
+	if ((a.Flags & Exclusive) || (b.Flags & Exclusive)) {
+		return true;
+	}
+	return Overlaps(a.Writes, b.Writes) || Overlaps(a.Writes, b.Reads) || Overlaps(a.Reads, b.Writes);
+}
+
+void SystemScheduler::_BuildGraph() {
+	for (System& system : _systems) {
+		system.Dependents.clear();
+		system.DependencyCount = 0;
+	}
+	// Systems only ever wait on systems that were added before them, so the graph can't have any cycles
+	for (size_t ix = 0; ix < _systems.size(); ix++) {
+		for (size_t before = 0; before < ix; before++) {
+			if (_Conflicts(_systems[before], _systems[ix])) {
+				_systems[before].Dependents.push_back(ix);
+				_systems[ix].DependencyCount++;
+			}
+		}
+	}
+	_timings.resize(_systems.size());
+	for (size_t ix = 0; ix < _systems.size(); ix++) {
+		_timings[ix].Name = _systems[ix].Name;
+	}
+	_isGraphDirty = false;
+}
+
+void SystemScheduler::Run(entt::registry& registry) {
+	typedef std::chrono::high_resolution_clock Clock;
+	if (_isGraphDirty) {
+		_BuildGraph();
+	}
+	if (_systems.empty()) {
+		_frameMs = 0.0;
+		return;
+	}
+	for (const System& system : _systems) {
+		for (PoolPreparer prepare : system.Prepares) {
+			prepare(registry);
+		}
+	}
+
+	ThreadPool& pool = ThreadPool::Instance();
+	const Clock::time_point start = Clock::now();
+	const std::thread::id mainThread = std::this_thread::get_id();
+
+	// All of this is guarded by the mutex
+	std::mutex mutex;
+	std::condition_variable signal;
+	std::vector<size_t> remaining(_systems.size());
+	std::deque<size_t> mainQueue;
+	size_t completed = 0;
+
+	std::function<void(size_t)> runSystem;
+	// Hands a system that's ready to go to the right thread, must be called with the mutex held
+	auto launch = [&](size_t ix) {
+		if (_systems[ix].Flags & MainThread) {
+			mainQueue.push_back(ix);
+		} else {
+			pool.Enqueue([&runSystem, ix]() { runSystem(ix); }, &remaining);
+		}
+	};
+	runSystem = [&](size_t ix) {
+		const Clock::time_point systemStart = Clock::now();
+		_systems[ix].Func(registry);
+		const Clock::time_point systemEnd = Clock::now();
+
+		// Each system only writes it's own timing, so this doesn't need the lock
+		SystemTiming& timing = _timings[ix];
+		timing.StartMs = std::chrono::duration<double, std::milli>(systemStart - start).count();
+		timing.DurationMs = std::chrono::duration<double, std::milli>(systemEnd - systemStart).count();
+		timing.OnMainThread = std::this_thread::get_id() == mainThread;
+
+		// We signal while holding the lock, so Run can't return and tear down our stack while we're still using it
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t dependent : _systems[ix].Dependents) {
+			if (--remaining[dependent] == 0) {
+				launch(dependent);
+			}
+		}
+		completed++;
+		signal.notify_all();
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t ix = 0; ix < _systems.size(); ix++) {
+			remaining[ix] = _systems[ix].DependencyCount;
+		}
+		for (size_t ix = 0; ix < _systems.size(); ix++) {
+			if (remaining[ix] == 0) {
+				launch(ix);
+			}
+		}
+	}
+
+	// The calling thread runs the main thread systems, and helps out with our own systems that are queued on the pool in
+	// between. Other work on the pool (ex: texture decoding) is left to the workers, so it can't stall the frame
+	while (true) {
+		size_t next = SIZE_MAX;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (completed == _systems.size()) {
+				break;
+			}
+			if (!mainQueue.empty()) {
+				next = mainQueue.front();
+				mainQueue.pop_front();
+			}
+		}
+		if (next != SIZE_MAX) {
+			runSystem(next);
+		}
+		else if (!pool.TryRunPendingTask(&remaining)) {
+			std::unique_lock<std::mutex> lock(mutex);
+			signal.wait(lock, [&]() { return completed == _systems.size() || !mainQueue.empty(); });
+		}
+	}
+
+	_frameMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <entt.hpp>
+
+/// <summary>
+/// Runs a list of systems over a registry each frame. Every system declares the component types it reads and writes,
+/// and two systems conflict if either one writes a type that the other touches. A system waits for every conflicting
+/// system that was added before it, and anything that does not conflict runs at the same time on the thread pool.
+///
+/// Systems must only touch the component types they declare. Systems that create or destroy entities, add or remove
+/// components, or touch types they can't list up front should be added with the Exclusive flag, and systems that need
+/// the GL context or GLFW input should be added with the MainThread flag
+/// </summary>
+class SystemScheduler final
+{
+public:
+	typedef std::function<void(entt::registry&)> SystemFunc;
+
+	/// <summary>
+	/// Lists the component types a system reads, ex: SystemScheduler::Read<Transform, RendererComponent>()
+	/// </summary>
+	template <typename... T>
+	struct Read {};
+	/// <summary>
+	/// Lists the component types a system writes, ex: SystemScheduler::Write<Transform>()
+	/// </summary>
+	template <typename... T>
+	struct Write {};
+
+	enum SystemFlags : uint32_t {
+		None       = 0,
+		MainThread = 1 << 0, // The system runs on the thread that called Run
+		Exclusive  = 1 << 1  // The system waits for everything before it, and everything after it waits for the system
+	};
+
+	/// <summary>
+	/// When a system ran in the last frame, relative to the start of Run
+	/// </summary>
+	struct SystemTiming {
+		std::string Name;
+		double      StartMs;
+		double      DurationMs;
+		bool        OnMainThread;
+	};
+
+	SystemScheduler() = default;
+	~SystemScheduler() = default;
+
+	/// <summary>
+	/// Adds a system to the end of the schedule
+	/// </summary>
+	/// <param name="name">The name of the system, for the timings</param>
+	/// <param name="func">The function to invoke each frame</param>
+	/// <param name="flags">Any SystemFlags for the system</param>
+	template <typename... TRead, typename... TWrite>
+	void AddSystem(const std::string& name, Read<TRead...>, Write<TWrite...>, const SystemFunc& func, uint32_t flags = None) {
+		System system;
+		system.Name = name;
+		system.Func = func;
+		system.Flags = flags;
+		system.Reads = { entt::type_info<TRead>::id()... };
+		system.Writes = { entt::type_info<TWrite>::id()... };
+		system.Prepares = { &_PreparePool<TRead>..., &_PreparePool<TWrite>... };
+		_systems.push_back(std::move(system));
+		_isGraphDirty = true;
+	}
+
+	/// <summary>
+	/// Runs every system once, returning when they have all finished
+	/// </summary>
+	/// <param name="registry">The registry to run the systems on</param>
+	void Run(entt::registry& registry);
+
+	/// <summary>
+	/// Gets the number of systems that have been added
+	/// </summary>
+	size_t GetSystemCount() const { return _systems.size(); }
+	/// <summary>
+	/// Gets the timing of each system from the last Run, in the order the systems were added
+	/// </summary>
+	const std::vector<SystemTiming>& GetTimings() const { return _timings; }
+	/// <summary>
+	/// Gets how long the last Run took from start to finish, in milliseconds
+	/// </summary>
+	double GetFrameMs() const { return _frameMs; }
+
+private:
+	typedef void(*PoolPreparer)(entt::registry& registry);
+
+	struct System {
+		std::string                Name;
+		SystemFunc                 Func;
+		uint32_t                   Flags;
+		std::vector<entt::id_type> Reads;
+		std::vector<entt::id_type> Writes;
+		std::vector<PoolPreparer>  Prepares;
+		// The systems that have to wait for this one, and how many systems this one waits for
+		std::vector<size_t>        Dependents;
+		size_t                     DependencyCount;
+	};
+
+	std::vector<System>       _systems;
+	std::vector<SystemTiming> _timings;
+	double                    _frameMs = 0.0;
+	bool                      _isGraphDirty = true;
+
+	/// <summary>
+	/// Rebuilds the dependencies between systems, this only needs to happen when the list of systems changes
+	/// </summary>
+	void _BuildGraph();
+	/// <summary>
+	/// Returns true if system b has to wait for system a
+	/// </summary>
+	static bool _Conflicts(const System& a, const System& b);
+
+	// Creating a pool resizes the registry's list of pools, so we do it for every declared type before any system runs
+	template <typename T>
+	static void _PreparePool(entt::registry& registry) {
+		registry.prepare<T>();
+	}
+};
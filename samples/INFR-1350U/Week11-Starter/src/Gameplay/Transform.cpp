@@ -5,13 +5,13 @@
 #include <GLM/gtx/quaternion.hpp>
 
 #include "Logging.h"
-
-const glm::mat4 IDENTITY = glm::mat4(1.0f);
+#include "TransformSystem.h"
 
 Transform& Transform::SetLocalRotation(const glm::vec3 eulerDegrees) {
 	_rotationEulerDeg = eulerDegrees;
 	_rotation = glm::quat(glm::radians(eulerDegrees));
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
@@ -19,6 +19,7 @@ Transform& Transform::SetLocalRotation(const glm::quat& quaternion) {
 	_rotation = quaternion;
 	_rotationEulerDeg = glm::degrees(glm::eulerAngles(_rotation));
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
@@ -28,6 +29,7 @@ Transform& Transform::SetLocalRotation(float yawDeg, float pitchDeg, float rollD
 	_rotationEulerDeg.z = rollDeg;
 	_rotation = glm::quat(glm::radians(_rotationEulerDeg));
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
@@ -36,6 +38,7 @@ Transform& Transform::SetLocalPosition(float x, float y, float z) {
 	_position.y = y;
 	_position.z = z;
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
@@ -44,6 +47,7 @@ Transform& Transform::SetLocalScale(float x, float y, float z) {
 	_scale.y = y;
 	_scale.z = z;
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
@@ -56,6 +60,7 @@ Transform& Transform::RotateLocalFixed(const glm::vec3& rotationDeg) {
 	_rotation = glm::quat(glm::radians(rotationDeg)) * _rotation;
 	_rotationEulerDeg = glm::degrees(glm::eulerAngles(_rotation));
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
@@ -67,12 +72,14 @@ Transform& Transform::RotateLocalFixed(float yawDeg, float pitchDeg, float rollD
 Transform& Transform::SetLocalPosition(const glm::vec3 value) {
 	_position = value;
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
 Transform& Transform::SetLocalScale(const glm::vec3 value) {
 	_scale = value;
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
@@ -80,6 +87,7 @@ Transform& Transform::RotateLocal(const glm::vec3& rotation) {
 	_rotation = _rotation * glm::quat(glm::radians(rotation));
 	_rotationEulerDeg = glm::degrees(glm::eulerAngles(_rotation));
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
@@ -87,6 +95,7 @@ Transform& Transform::MoveLocal(const glm::vec3& localMovement)
 {
 	_position += _rotation * localMovement;
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
@@ -99,6 +108,7 @@ Transform& Transform::MoveLocalFixed(const glm::vec3& localMovement)
 {
 	_position += localMovement;
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
@@ -107,6 +117,7 @@ Transform& Transform::MoveLocalFixed(float x, float y, float z) {
 	_position.y += y;
 	_position.z += z;
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
@@ -115,6 +126,7 @@ Transform& Transform::LookAt(const glm::vec3& localSpace)
 	_rotation = glm::quatLookAt(-glm::normalize(_position - localSpace), glm::normalize(_rotation * glm::vec3(0, 0, 1)));
 	_rotationEulerDeg = glm::degrees(glm::eulerAngles(_rotation));
 	_isLocalDirty = true;
+	_isWorldDirty = true;
 	return *this;
 }
 
@@ -134,44 +146,139 @@ const glm::mat3& Transform::NormalMatrix() const {
 
 void Transform::SetParent(entt::handle parent)
 {
-	_parent = parent;
+	entt::registry& registry = _gameObject.registry();
+	const entt::entity self = _gameObject.entity();
+
+	entt::entity newParent = entt::null;
 	// If we passed in a handle, make sure it has a transform and belongs to the same scene
 	if (&parent.registry() != nullptr && parent.entity() != entt::null) {
 		LOG_ASSERT(parent.has<Transform>(), "Parent entity must have a transform component");
-		LOG_ASSERT(&parent.registry() == &_gameObject.registry(), "Parent entity must be in same registry!");
-		_hierarchyDepth = parent.get<Transform>()._hierarchyDepth + 1;
+		LOG_ASSERT(&parent.registry() == &registry, "Parent entity must be in same registry!");
+		newParent = parent.entity();
+		// Walk up from the new parent to make sure we aren't about to create a loop
+		for (entt::entity ancestor = newParent; ancestor != entt::null; ancestor = registry.get<Transform>(ancestor)._parent) {
+			LOG_ASSERT(ancestor != self, "Cannot parent a transform to itself or one of its children!");
+		}
+	}
+	if (newParent == _parent) {
+		return;
+	}
+
+	_Unlink();
+	_parent = newParent;
+	_isWorldDirty = true;
+
+	const int oldDepth = _hierarchyDepth;
+	if (newParent != entt::null) {
+		// Insert ourselves at the front of our new parent's list of children
+		Transform& parentTransform = registry.get<Transform>(newParent);
+		_nextSibling = parentTransform._firstChild;
+		if (_nextSibling != entt::null) {
+			registry.get<Transform>(_nextSibling)._prevSibling = self;
+		}
+		parentTransform._firstChild = self;
+		_hierarchyDepth = parentTransform._hierarchyDepth + 1;
 	} else {
 		_hierarchyDepth = 0;
 	}
-	
-	// Re-calculate hierarchy depth for all children recursively
-	_gameObject.registry().view<Transform>().each([&](entt::entity entity, Transform& t) {
-		if (t._parent == _gameObject) {
-			t.SetParent(entt::handle(parent.registry(), _gameObject));
-		}
-	});
-	// Re-sort components
-	_gameObject.registry().sort<Transform>([](const Transform& l, const Transform& r) {
-		return l.GetHierarchyDepth() < r.GetHierarchyDepth();
-	});
+
+	// Our children only need to be visited if we actually moved to a different level
+	if (_hierarchyDepth != oldDepth) {
+		_UpdateChildDepths();
+	}
+	TransformSystem::MarkHierarchyDirty(registry);
 }
 
 void Transform::UpdateWorldMatrix() const {
 	if (_parent != entt::null) {
-		_worldTransform = _gameObject.registry().get<Transform>(_parent)._worldTransform * LocalTransform();
-		_worldNormalMatrix = glm::mat3(glm::transpose(glm::inverse(_worldTransform)));
+		const Transform& parent = _gameObject.registry().get<Transform>(_parent);
+		// We only need to re-calculate if we've moved, or our parent's world matrix has changed since we last looked at it
+		if (!_isWorldDirty && parent._worldVersion == _parentWorldVersion) {
+			return;
+		}
+		_worldTransform = parent._worldTransform * LocalTransform();
+		// The inverse transpose of a product is the product of the inverse transposes, so we can skip the inverse
+		_worldNormalMatrix = parent._worldNormalMatrix * _normalMatrix;
+		_parentWorldVersion = parent._worldVersion;
 	} else {
+		if (!_isWorldDirty) {
+			return;
+		}
 		_worldTransform = LocalTransform();
 		_worldNormalMatrix = _normalMatrix;
 	}
+	_isWorldDirty = false;
+	_worldVersion++;
 }
 
 void Transform::_UpdateLocalTransformIfDirty() const {
 	if (_isLocalDirty) {
-		// TRS
-		_localTransform = glm::translate(IDENTITY, _position) * glm::toMat4(_rotation) * glm::scale(IDENTITY, _scale);
-		_normalMatrix = glm::mat3(glm::transpose(glm::inverse(_localTransform)));
+		// TRS, built directly rather than multiplying three 4x4 matrices together
+		const glm::mat3 rotation = glm::mat3_cast(_rotation);
+		_localTransform[0] = glm::vec4(rotation[0] * _scale.x, 0.0f);
+		_localTransform[1] = glm::vec4(rotation[1] * _scale.y, 0.0f);
+		_localTransform[2] = glm::vec4(rotation[2] * _scale.z, 0.0f);
+		_localTransform[3] = glm::vec4(_position, 1.0f);
+		// Rotations are orthonormal, so the inverse transpose of R * S is just R * S^-1
+		_normalMatrix[0] = rotation[0] / _scale.x;
+		_normalMatrix[1] = rotation[1] / _scale.y;
+		_normalMatrix[2] = rotation[2] / _scale.z;
 
 		_isLocalDirty = false;
 	}
 }
+
+void Transform::_Unlink() {
+	if (_parent == entt::null) {
+		return;
+	}
+	entt::registry& registry = _gameObject.registry();
+	if (_prevSibling != entt::null) {
+		registry.get<Transform>(_prevSibling)._nextSibling = _nextSibling;
+	} else {
+		registry.get<Transform>(_parent)._firstChild = _nextSibling;
+	}
+	if (_nextSibling != entt::null) {
+		registry.get<Transform>(_nextSibling)._prevSibling = _prevSibling;
+	}
+	_prevSibling = entt::null;
+	_nextSibling = entt::null;
+}
+
+void Transform::_UpdateChildDepths() {
+	entt::registry& registry = _gameObject.registry();
+	const entt::entity self = _gameObject.entity();
+
+	// Depth first walk of our subtree using the parent and sibling links, so that deep hierarchies don't need
+	// a stack (or recursion) proportional to their depth
+	entt::entity current = _firstChild;
+	while (current != entt::null) {
+		Transform& transform = registry.get<Transform>(current);
+		transform._hierarchyDepth = registry.get<Transform>(transform._parent)._hierarchyDepth + 1;
+		if (transform._firstChild != entt::null) {
+			current = transform._firstChild;
+			continue;
+		}
+		// Move to the next sibling, climbing back up until we find one or get back to where we started
+		while (current != self && registry.get<Transform>(current)._nextSibling == entt::null) {
+			current = registry.get<Transform>(current)._parent;
+		}
+		current = current == self ? entt::null : registry.get<Transform>(current)._nextSibling;
+	}
+}
+
+void Transform::_DetachChildren() {
+	entt::registry& registry = _gameObject.registry();
+	while (_firstChild != entt::null) {
+		Transform& child = registry.get<Transform>(_firstChild);
+		_firstChild = child._nextSibling;
+		child._parent = entt::null;
+		child._prevSibling = entt::null;
+		child._nextSibling = entt::null;
+		child._isWorldDirty = true;
+		if (child._hierarchyDepth != 0) {
+			child._hierarchyDepth = 0;
+			child._UpdateChildDepths();
+		}
+	}
+}
@@ -5,7 +5,9 @@
 #include <GLM/gtc/quaternion.hpp>
 
 /// <summary>
-/// A simple transformation class, without parent/child relationships
+/// A transformation class, which may be parented to other transforms to build a scene hierarchy.
+/// Children are stored as an intrusive list (first child, next sibling), so walking or modifying the
+/// hierarchy never needs to touch unrelated transforms
 /// </summary>
 class Transform final
 {
@@ -19,11 +21,16 @@ public:
 		_isWorldDirty(true),
 		_worldTransform(glm::mat4(1.0f)),
 		_worldNormalMatrix(glm::mat3(1.0f)),
+		_worldVersion(0),
+		_parentWorldVersion(0),
 		_rotation(glm::quat(1.0f, 0.0f, 0.0f, 0.0f)),
 		_rotationEulerDeg(glm::vec3(0.0f)),
 		_position(glm::vec3(0.0f)),
 		_scale(glm::vec3(1.0f)),
 		_parent(entt::null),
+		_firstChild(entt::null),
+		_prevSibling(entt::null),
+		_nextSibling(entt::null),
 		_gameObject(gameObject),
 		_hierarchyDepth(0)
 	{}
@@ -188,12 +195,38 @@ public:
 	/// </summary>
 	const glm::mat3& NormalMatrix() const;
 
+	/// <summary>
+	/// Attaches this transform to a new parent, or detaches it if the handle is null. This costs time proportional
+	/// to the size of this transform's subtree, since the depths of all of our children need to be updated
+	/// </summary>
+	/// <param name="parent">The game object to parent to, must have a transform and be in the same registry</param>
 	void SetParent(entt::handle parent);
+	/// <summary>
+	/// Gets the entity that this transform is parented to, or entt::null if it is a root
+	/// </summary>
+	entt::entity GetParent() const { return _parent; }
+	/// <summary>
+	/// Gets the first child of this transform, or entt::null if it has no children
+	/// </summary>
+	entt::entity GetFirstChild() const { return _firstChild; }
+	/// <summary>
+	/// Gets the next child of this transform's parent, or entt::null if this is the last child
+	/// </summary>
+	entt::entity GetNextSibling() const { return _nextSibling; }
 
+	/// <summary>
+	/// Re-calculates the world matrix for this transform if it or its parent have changed since the last update.
+	/// The parent's world matrix must already be up to date, see TransformSystem for updating a whole scene
+	/// </summary>
 	void UpdateWorldMatrix() const;
 
 	const glm::mat4& WorldTransform() const { return _worldTransform; }
 	const glm::mat3& WorldNormalMatrix() const { return _worldNormalMatrix; };
+	/// <summary>
+	/// Gets a number that changes every time the world matrix is recalculated, so that other systems can tell when a
+	/// transform has moved without comparing matrices
+	/// </summary>
+	uint32_t GetWorldVersion() const { return _worldVersion; }
 
 	/// <summary>
 	/// Gets the depth of this transform within the scene hierarchy (ie. how many parents
@@ -210,6 +243,10 @@ private:
 	mutable bool _isWorldDirty;
 	mutable glm::mat4 _worldTransform;
 	mutable glm::mat3 _worldNormalMatrix;
+	// Incremented whenever the world matrix changes, so children can tell if they need to update
+	mutable uint32_t _worldVersion;
+	// The version of our parent's world matrix that our world matrix was calculated from
+	mutable uint32_t _parentWorldVersion;
 	
 	glm::quat _rotation;
 	glm::vec3 _rotationEulerDeg;
@@ -217,8 +254,26 @@ private:
 	glm::vec3 _scale;
 
 	entt::entity _parent;
+	entt::entity _firstChild;
+	entt::entity _prevSibling;
+	entt::entity _nextSibling;
 	entt::handle _gameObject;
 	int _hierarchyDepth;
 
 	void _UpdateLocalTransformIfDirty() const;
+	/// <summary>
+	/// Removes this transform from its parent's list of children, without touching our own children
+	/// </summary>
+	void _Unlink();
+	/// <summary>
+	/// Updates the hierarchy depth of every transform beneath this one to match our depth
+	/// </summary>
+	void _UpdateChildDepths();
+	/// <summary>
+	/// Detaches all of our children, turning them into roots. Called when this transform is destroyed, so that
+	/// they aren't left pointing at a dead entity
+	/// </summary>
+	void _DetachChildren();
+
+	friend class TransformSystem;
 };
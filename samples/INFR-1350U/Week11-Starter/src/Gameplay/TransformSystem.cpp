@@ -0,0 +1,283 @@
+#include "TransformSystem.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "Transform.h"
+#include "Utilities/ThreadPool.h"
+
+// SSE is always available on x64, MSVC only tells us about it through _M_IX86_FP on 32 bit builds
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRANSFORM_KERNEL_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+	// Transforms are handed to the workers in batches, so that grabbing work costs far less than the matrix math
+	constexpr size_t BATCH_SIZE = 512;
+
+	// The transforms at each depth of the hierarchy, stored in the registry's context. The pointers are into the
+	// registry's storage, so we rebuild them whenever a transform is added or removed
+	struct TransformLevels {
+		std::vector<std::vector<const Transform*>> Levels;
+		bool IsDirty = true;
+	};
+
+	// The number of transforms that the kernel processes at once
+	constexpr size_t LANE_COUNT = 4;
+
+#ifdef TRANSFORM_KERNEL_SSE
+	// One float for each transform in a batch, which are all operated on together
+	struct Lanes {
+		__m128 Value;
+		static Lanes Load(const float* values) { return { _mm_load_ps(values) }; }
+		static Lanes Set(float value) { return { _mm_set1_ps(value) }; }
+		void Store(float* values) const { _mm_store_ps(values, Value); }
+	};
+	inline Lanes operator +(Lanes l, Lanes r) { return { _mm_add_ps(l.Value, r.Value) }; }
+	inline Lanes operator -(Lanes l, Lanes r) { return { _mm_sub_ps(l.Value, r.Value) }; }
+	inline Lanes operator *(Lanes l, Lanes r) { return { _mm_mul_ps(l.Value, r.Value) }; }
+	inline Lanes operator /(Lanes l, Lanes r) { return { _mm_div_ps(l.Value, r.Value) }; }
+#else
+	// Scalar fallback for platforms without SSE, the kernel is written the same way for both
+	struct Lanes {
+		float Value[LANE_COUNT];
+		static Lanes Load(const float* values) { Lanes result; for (size_t ix = 0; ix < LANE_COUNT; ix++) { result.Value[ix] = values[ix]; } return result; }
+		static Lanes Set(float value) { Lanes result; for (size_t ix = 0; ix < LANE_COUNT; ix++) { result.Value[ix] = value; } return result; }
+		void Store(float* values) const { for (size_t ix = 0; ix < LANE_COUNT; ix++) { values[ix] = Value[ix]; } }
+	};
+	inline Lanes operator +(Lanes l, Lanes r) { for (size_t ix = 0; ix < LANE_COUNT; ix++) { l.Value[ix] += r.Value[ix]; } return l; }
+	inline Lanes operator -(Lanes l, Lanes r) { for (size_t ix = 0; ix < LANE_COUNT; ix++) { l.Value[ix] -= r.Value[ix]; } return l; }
+	inline Lanes operator *(Lanes l, Lanes r) { for (size_t ix = 0; ix < LANE_COUNT; ix++) { l.Value[ix] *= r.Value[ix]; } return l; }
+	inline Lanes operator /(Lanes l, Lanes r) { for (size_t ix = 0; ix < LANE_COUNT; ix++) { l.Value[ix] /= r.Value[ix]; } return l; }
+#endif
+
+	// The inputs and outputs for a batch of transforms, stored as structure-of-arrays so that each row holds the same
+	// value for every transform. Affine matrices are 4 columns of 3 floats (the last row is always 0, 0, 0, 1), and
+	// normal matrices are 3 columns of 3 floats
+	struct alignas(16) TransformBatch {
+		float Position[3][LANE_COUNT];
+		float Rotation[4][LANE_COUNT];
+		float Scale[3][LANE_COUNT];
+		float ParentWorld[12][LANE_COUNT];
+		float ParentNormal[9][LANE_COUNT];
+		float Local[12][LANE_COUNT];
+		float LocalNormal[9][LANE_COUNT];
+		float World[12][LANE_COUNT];
+		float WorldNormal[9][LANE_COUNT];
+	};
+
+	/*
+	 * Composes the local matrices for a batch of transforms from their TRS, then combines them with their parents.
+	 * Since rotations are orthonormal, the normal matrix is just the rotation with each axis divided by the scale,
+	 * and the world normal matrix is the parent's normal matrix times ours, so we never need a general inverse
+	 * @param batch The batch to process, the local and world matrices will be filled in
+	 */
+	void ComposeBatch(TransformBatch& batch) {
+		const Lanes one = Lanes::Set(1.0f);
+		const Lanes two = Lanes::Set(2.0f);
+
+		// Quaternion to rotation matrix, matching glm::mat3_cast
+		const Lanes x = Lanes::Load(batch.Rotation[0]);
+		const Lanes y = Lanes::Load(batch.Rotation[1]);
+		const Lanes z = Lanes::Load(batch.Rotation[2]);
+		const Lanes w = Lanes::Load(batch.Rotation[3]);
+		const Lanes xx = x * x, yy = y * y, zz = z * z;
+		const Lanes xy = x * y, xz = x * z, yz = y * z;
+		const Lanes wx = w * x, wy = w * y, wz = w * z;
+		const Lanes rotation[9] = {
+			one - two * (yy + zz), two * (xy + wz), two * (xz - wy),
+			two * (xy - wz), one - two * (xx + zz), two * (yz + wx),
+			two * (xz + wy), two * (yz - wx), one - two * (xx + yy)
+		};
+
+		Lanes local[12];
+		Lanes localNormal[9];
+		for (int col = 0; col < 3; col++) {
+			const Lanes scale = Lanes::Load(batch.Scale[col]);
+			const Lanes inverseScale = one / scale;
+			for (int row = 0; row < 3; row++) {
+				local[col * 3 + row] = rotation[col * 3 + row] * scale;
+				localNormal[col * 3 + row] = rotation[col * 3 + row] * inverseScale;
+			}
+			local[9 + col] = Lanes::Load(batch.Position[col]);
+		}
+
+		Lanes parent[12];
+		for (int ix = 0; ix < 12; ix++) {
+			parent[ix] = Lanes::Load(batch.ParentWorld[ix]);
+		}
+		Lanes parentNormal[9];
+		for (int ix = 0; ix < 9; ix++) {
+			parentNormal[ix] = Lanes::Load(batch.ParentNormal[ix]);
+		}
+
+		for (int col = 0; col < 4; col++) {
+			for (int row = 0; row < 3; row++) {
+				Lanes value = parent[row] * local[col * 3] + parent[3 + row] * local[col * 3 + 1] + parent[6 + row] * local[col * 3 + 2];
+				// Only the translation column picks up the parent's translation
+				if (col == 3) {
+					value = value + parent[9 + row];
+				}
+				value.Store(batch.World[col * 3 + row]);
+				local[col * 3 + row].Store(batch.Local[col * 3 + row]);
+			}
+		}
+		for (int col = 0; col < 3; col++) {
+			for (int row = 0; row < 3; row++) {
+				const Lanes value = parentNormal[row] * localNormal[col * 3] + parentNormal[3 + row] * localNormal[col * 3 + 1] + parentNormal[6 + row] * localNormal[col * 3 + 2];
+				value.Store(batch.WorldNormal[col * 3 + row]);
+				localNormal[col * 3 + row].Store(batch.LocalNormal[col * 3 + row]);
+			}
+		}
+	}
+
+	/*
+	 * Listener for transforms being added to a registry, adding to the storage may re-allocate it
+	 */
+	void OnTransformAdded(entt::registry& registry, entt::entity) {
+		registry.ctx<TransformLevels>().IsDirty = true;
+	}
+}
+
+void TransformSystem::Initialize(entt::registry& registry) {
+	if (registry.try_ctx<TransformLevels>() != nullptr) {
+		return;
+	}
+	registry.set<TransformLevels>();
+	registry.on_construct<Transform>().connect<&OnTransformAdded>();
+	registry.on_destroy<Transform>().connect<&TransformSystem::_OnTransformDestroyed>();
+}
+
+void TransformSystem::MarkHierarchyDirty(entt::registry& registry) {
+	TransformLevels* context = registry.try_ctx<TransformLevels>();
+	if (context != nullptr) {
+		context->IsDirty = true;
+	}
+}
+
+void TransformSystem::UpdateWorldMatrices(entt::registry& registry) {
+	Initialize(registry);
+	TransformLevels& context = registry.ctx<TransformLevels>();
+	std::vector<std::vector<const Transform*>>& levels = context.Levels;
+
+	if (context.IsDirty) {
+		for (std::vector<const Transform*>& level : levels) {
+			level.clear();
+		}
+		// Order within the storage doesn't matter here, so we can walk the raw array instead of going through the view
+		auto view = registry.view<Transform>();
+		const Transform* transforms = view.raw();
+		for (size_t ix = 0; ix < view.size(); ix++) {
+			const size_t depth = static_cast<size_t>(transforms[ix].GetHierarchyDepth());
+			if (depth >= levels.size()) {
+				levels.resize(depth + 1);
+			}
+			levels[depth].push_back(&transforms[ix]);
+		}
+		// Drop any levels that were left empty, so a hierarchy that gets shallower doesn't leave us looping over nothing
+		while (!levels.empty() && levels.back().empty()) {
+			levels.pop_back();
+		}
+		context.IsDirty = false;
+	}
+
+	// ParallelFor will not return until the whole level is done, so every level sees its parents fully updated
+	ThreadPool& pool = ThreadPool::Instance();
+	for (const std::vector<const Transform*>& level : levels) {
+		const size_t batches = (level.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+		pool.ParallelFor(batches, [&](size_t batch) {
+			const size_t end = std::min(level.size(), (batch + 1) * BATCH_SIZE);
+			_UpdateTransforms(level.data() + batch * BATCH_SIZE, end - batch * BATCH_SIZE);
+		});
+	}
+}
+
+void TransformSystem::_OnTransformDestroyed(entt::registry& registry, entt::entity entity) {
+	// Removing the component will move another transform into its slot, so our pointers are no longer valid
+	registry.ctx<TransformLevels>().IsDirty = true;
+
+	Transform& transform = registry.get<Transform>(entity);
+	transform._Unlink();
+	transform._DetachChildren();
+}
+
+void TransformSystem::_UpdateTransforms(const Transform* const* transforms, size_t count) {
+	static const glm::mat4 IDENTITY = glm::mat4(1.0f);
+	static const glm::mat3 IDENTITY_NORMAL = glm::mat3(1.0f);
+
+	TransformBatch batch;
+	const Transform* pending[LANE_COUNT];
+	const Transform* parents[LANE_COUNT];
+	size_t used = 0;
+
+	// Copies the inputs for a transform into one lane of the batch
+	auto gather = [&](size_t lane, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, const glm::mat4& parentWorld, const glm::mat3& parentNormal) {
+		for (int ix = 0; ix < 3; ix++) {
+			batch.Position[ix][lane] = position[ix];
+			batch.Scale[ix][lane] = scale[ix];
+		}
+		batch.Rotation[0][lane] = rotation.x;
+		batch.Rotation[1][lane] = rotation.y;
+		batch.Rotation[2][lane] = rotation.z;
+		batch.Rotation[3][lane] = rotation.w;
+		for (int col = 0; col < 4; col++) {
+			for (int row = 0; row < 3; row++) {
+				batch.ParentWorld[col * 3 + row][lane] = parentWorld[col][row];
+			}
+		}
+		for (int col = 0; col < 3; col++) {
+			for (int row = 0; row < 3; row++) {
+				batch.ParentNormal[col * 3 + row][lane] = parentNormal[col][row];
+			}
+		}
+	};
+
+	// Runs the kernel over the pending transforms, and copies the results back out
+	auto flush = [&]() {
+		// Fill any unused lanes with an identity transform, so that we don't divide by zero
+		for (size_t lane = used; lane < LANE_COUNT; lane++) {
+			gather(lane, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f), IDENTITY, IDENTITY_NORMAL);
+		}
+		ComposeBatch(batch);
+		for (size_t lane = 0; lane < used; lane++) {
+			const Transform& transform = *pending[lane];
+			for (int col = 0; col < 4; col++) {
+				const float w = col == 3 ? 1.0f : 0.0f;
+				transform._localTransform[col] = glm::vec4(batch.Local[col * 3][lane], batch.Local[col * 3 + 1][lane], batch.Local[col * 3 + 2][lane], w);
+				transform._worldTransform[col] = glm::vec4(batch.World[col * 3][lane], batch.World[col * 3 + 1][lane], batch.World[col * 3 + 2][lane], w);
+			}
+			for (int col = 0; col < 3; col++) {
+				transform._normalMatrix[col] = glm::vec3(batch.LocalNormal[col * 3][lane], batch.LocalNormal[col * 3 + 1][lane], batch.LocalNormal[col * 3 + 2][lane]);
+				transform._worldNormalMatrix[col] = glm::vec3(batch.WorldNormal[col * 3][lane], batch.WorldNormal[col * 3 + 1][lane], batch.WorldNormal[col * 3 + 2][lane]);
+			}
+			transform._isLocalDirty = false;
+			transform._isWorldDirty = false;
+			transform._worldVersion++;
+			if (parents[lane] != nullptr) {
+				transform._parentWorldVersion = parents[lane]->_worldVersion;
+			}
+		}
+		used = 0;
+	};
+
+	for (size_t ix = 0; ix < count; ix++) {
+		const Transform& transform = *transforms[ix];
+		const Transform* parent = transform._parent != entt::null ? &transform._gameObject.registry().get<Transform>(transform._parent) : nullptr;
+		// Skip anything that hasn't moved, and whose parent hasn't moved since we last looked at it
+		if (!transform._isWorldDirty && (parent == nullptr || parent->_worldVersion == transform._parentWorldVersion)) {
+			continue;
+		}
+
+		pending[used] = &transform;
+		parents[used] = parent;
+		gather(used, transform._position, transform._rotation, transform._scale,
+			parent != nullptr ? parent->_worldTransform : IDENTITY, parent != nullptr ? parent->_worldNormalMatrix : IDENTITY_NORMAL);
+		if (++used == LANE_COUNT) {
+			flush();
+		}
+	}
+	if (used > 0) {
+		flush();
+	}
+}
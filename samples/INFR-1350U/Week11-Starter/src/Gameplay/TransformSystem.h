@@ -0,0 +1,44 @@
+#pragma once
+#include <entt.hpp>
+
+class Transform;
+
+/// <summary>
+/// Updates the world matrices for all the transforms in a scene. Transforms are grouped by their depth in the
+/// hierarchy, and each depth is spread across the thread pool once all of the levels above it have finished.
+/// Transforms that have not moved, and whose parents have not moved, are skipped.
+/// The levels are only rebuilt on frames where transforms were added, removed or re-parented
+/// </summary>
+class TransformSystem
+{
+public:
+	/// <summary>
+	/// Hooks the system up to a registry, so that it can keep track of transforms being added or removed, and
+	/// keep the hierarchy intact when a parent is destroyed. This should be called before any entities are created
+	/// </summary>
+	/// <param name="registry">The registry to attach to</param>
+	static void Initialize(entt::registry& registry);
+
+	/// <summary>
+	/// Notifies the system that the hierarchy of a registry has changed, so the levels need to be rebuilt before the
+	/// next update. This is handled automatically by Transform::SetParent
+	/// </summary>
+	/// <param name="registry">The registry that has changed</param>
+	static void MarkHierarchyDirty(entt::registry& registry);
+
+	/// <summary>
+	/// Brings the world matrix of every transform in the registry up to date
+	/// </summary>
+	/// <param name="registry">The registry containing the transforms to update</param>
+	static void UpdateWorldMatrices(entt::registry& registry);
+
+protected:
+	TransformSystem() = default;
+	~TransformSystem() = default;
+
+	static void _OnTransformDestroyed(entt::registry& registry, entt::entity entity);
+	/// <summary>
+	/// Updates the local and world matrices of any transforms in the list that need it, several at a time
+	/// </summary>
+	static void _UpdateTransforms(const Transform* const* transforms, size_t count);
+};
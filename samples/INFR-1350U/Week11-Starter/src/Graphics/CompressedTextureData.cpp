@@ -0,0 +1,344 @@
+#include "CompressedTextureData.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+	// Every KTX2 file starts with this
+	constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	// The fixed part of a KTX2 file that follows the identifier. Everything in the file is little endian, the same as
+	// every platform we build for, so we can read and write these directly. The 64 bit fields are only 4 byte aligned
+	// relative to the start of the header, so we need to pack it
+	#pragma pack(push, 4)
+	struct Ktx2Header {
+		uint32_t VkFormat;
+		uint32_t TypeSize;
+		uint32_t PixelWidth;
+		uint32_t PixelHeight;
+		uint32_t PixelDepth;
+		uint32_t LayerCount;
+		uint32_t FaceCount;
+		uint32_t LevelCount;
+		uint32_t SupercompressionScheme;
+		// Where the data format descriptor, key/value data and supercompression data live in the file
+		uint32_t DfdByteOffset;
+		uint32_t DfdByteLength;
+		uint32_t KvdByteOffset;
+		uint32_t KvdByteLength;
+		uint64_t SgdByteOffset;
+		uint64_t SgdByteLength;
+	};
+	#pragma pack(pop)
+	static_assert(sizeof(Ktx2Header) == 68, "KTX2 header must not be padded");
+
+	// Followed by one of these per mip level, starting with the full size level
+	struct Ktx2LevelIndex {
+		uint64_t ByteOffset;
+		uint64_t ByteLength;
+		uint64_t UncompressedByteLength;
+	};
+
+	/*
+	 * Describes how one of our formats is stored in a KTX2 file
+	 */
+	struct Ktx2Format {
+		InternalFormat Format;
+		uint32_t       VkFormat;
+		// The color model and channels for the data format descriptor, one channel per 64 bits of the block
+		uint8_t        ColorModel;
+		uint8_t        Channels[2];
+		uint8_t        ChannelCount;
+	};
+
+	// See the Vulkan spec for VkFormat, and the Khronos Data Format spec for the KHR_DF_MODEL and KHR_DF_CHANNEL values
+	constexpr Ktx2Format KTX2_FORMATS[] = {
+		{ InternalFormat::BC1, 131, 128, { 0, 0 },  1 }, // VK_FORMAT_BC1_RGB_UNORM_BLOCK, BC1A_COLOR
+		{ InternalFormat::BC3, 137, 130, { 15, 0 }, 2 }, // VK_FORMAT_BC3_UNORM_BLOCK, BC3_ALPHA then BC3_COLOR
+		{ InternalFormat::BC4, 139, 131, { 0, 0 },  1 }, // VK_FORMAT_BC4_UNORM_BLOCK, BC4_DATA
+		{ InternalFormat::BC5, 141, 132, { 0, 1 },  2 }, // VK_FORMAT_BC5_UNORM_BLOCK, BC5_RED then BC5_GREEN
+		{ InternalFormat::BC7, 145, 134, { 0, 0 },  1 }, // VK_FORMAT_BC7_UNORM_BLOCK, BC7_COLOR
+	};
+
+	const Ktx2Format* FindKtx2Format(InternalFormat format) {
+		for (const Ktx2Format& entry : KTX2_FORMATS) {
+			if (entry.Format == format) {
+				return &entry;
+			}
+		}
+		return nullptr;
+	}
+
+	const Ktx2Format* FindKtx2Format(uint32_t vkFormat) {
+		for (const Ktx2Format& entry : KTX2_FORMATS) {
+			if (entry.VkFormat == vkFormat) {
+				return &entry;
+			}
+		}
+		return nullptr;
+	}
+
+	inline size_t AlignUp(size_t value, size_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	/*
+	 * Builds the data format descriptor for a format, a single basic descriptor block with one sample per channel
+	 */
+	std::vector<uint32_t> BuildDataFormatDescriptor(const Ktx2Format& format) {
+		const uint32_t blockSize = static_cast<uint32_t>(GetCompressedBlockSize(format.Format));
+		const uint32_t descriptorSize = 24 + 16 * format.ChannelCount;
+		std::vector<uint32_t> result;
+		result.push_back(4 + descriptorSize);            // Total size of the descriptor
+		result.push_back(0);                             // Khronos vendor, basic descriptor type
+		result.push_back(2 | (descriptorSize << 16));    // Version 2
+		result.push_back(format.ColorModel | (1 << 8) | (1 << 16)); // BT709 primaries, linear transfer, straight alpha
+		result.push_back(3 | (3 << 8));                  // 4x4x1x1 texel blocks (stored as size - 1)
+		result.push_back(blockSize);                     // Bytes in plane 0
+		result.push_back(0);
+		for (uint8_t ix = 0; ix < format.ChannelCount; ix++) {
+			// Each channel takes up 64 bits of the block, or all of it if there is only one
+			const uint32_t bitLength = (format.ChannelCount == 1 ? blockSize * 8 : 64) - 1;
+			result.push_back((ix * 64) | (bitLength << 16) | (format.Channels[ix] << 24));
+			result.push_back(0);          // Sample position
+			result.push_back(0);          // Lower
+			result.push_back(UINT32_MAX); // Upper
+		}
+		return result;
+	}
+
+	/*
+	 * Appends a key/value pair to the key/value data of a KTX2 file, padded to 4 bytes
+	 */
+	void AppendKeyValue(std::vector<uint8_t>& data, const std::string& key, const std::string& value) {
+		const uint32_t length = static_cast<uint32_t>(key.length() + value.length() + 2);
+		const uint8_t* lengthBytes = reinterpret_cast<const uint8_t*>(&length);
+		data.insert(data.end(), lengthBytes, lengthBytes + sizeof(uint32_t));
+		data.insert(data.end(), key.begin(), key.end());
+		data.push_back(0);
+		data.insert(data.end(), value.begin(), value.end());
+		data.push_back(0);
+		data.resize(AlignUp(data.size(), 4), 0);
+	}
+
+	/*
+	 * Looks for a key in the key/value data of a KTX2 file
+	 * @returns The value of the key, or an empty string if it was not found
+	 */
+	std::string FindKeyValue(const uint8_t* data, size_t size, const std::string& key) {
+		size_t offset = 0;
+		while (offset + sizeof(uint32_t) <= size) {
+			uint32_t length;
+			memcpy(&length, data + offset, sizeof(uint32_t));
+			offset += sizeof(uint32_t);
+			if (length > size - offset) {
+				break;
+			}
+			const char* entry = reinterpret_cast<const char*>(data + offset);
+			const size_t keyLength = strnlen(entry, length);
+			if (keyLength < length && key.compare(0, std::string::npos, entry, keyLength) == 0) {
+				return std::string(entry + keyLength + 1, strnlen(entry + keyLength + 1, length - keyLength - 1));
+			}
+			offset = AlignUp(offset + length, 4);
+		}
+		return std::string();
+	}
+}
+
+CompressedTextureData::CompressedTextureData() :
+	_format(InternalFormat::Unknown), _width(0), _height(0), _levels(), _data(), _file(), _base(nullptr)
+{ }
+
+CompressedTextureData::CompressedTextureData(InternalFormat format, uint32_t width, uint32_t height, uint32_t levelCount) :
+	_format(format), _width(width), _height(height), _levels(), _data(), _file(), _base(nullptr)
+{
+	LOG_ASSERT(IsCompressedFormat(format), "{} is not a block compressed format!", format);
+	LOG_ASSERT(width > 0 && height > 0, "Width and height must both be greater than zero! Got {}x{}", width, height);
+	if (levelCount == 0) {
+		levelCount = GetFullMipCount(width, height);
+	}
+
+	size_t offset = 0;
+	_levels.resize(levelCount);
+	for (uint32_t ix = 0; ix < levelCount; ix++) {
+		MipLevel& level = _levels[ix];
+		level.Width = std::max(width >> ix, 1u);
+		level.Height = std::max(height >> ix, 1u);
+		level.Offset = offset;
+		level.Size = GetCompressedImageSize(format, level.Width, level.Height);
+		offset += level.Size;
+	}
+	_data.resize(offset, 0);
+	_base = _data.data();
+}
+
+uint32_t CompressedTextureData::GetFullMipCount(uint32_t width, uint32_t height) {
+	uint32_t result = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+		result++;
+	}
+	return result;
+}
+
+size_t CompressedTextureData::GetDataSize() const {
+	size_t result = 0;
+	for (const MipLevel& level : _levels) {
+		result += level.Size;
+	}
+	return result;
+}
+
+uint8_t* CompressedTextureData::GetMutableLevelData(uint32_t level) {
+	LOG_ASSERT(!_file.IsOpen(), "Cannot modify an image that was loaded from a file!");
+	return _data.data() + _levels[level].Offset;
+}
+
+CompressedTextureData::sptr CompressedTextureData::LoadFromKtx2(const std::string& file) {
+	// The constructor is private, so we can't use make_shared here
+	CompressedTextureData::sptr result = CompressedTextureData::sptr(new CompressedTextureData());
+	if (!result->_file.Open(file) || result->_file.GetSize() < sizeof(KTX2_IDENTIFIER) + sizeof(Ktx2Header)) {
+		LOG_WARN("Failed to open KTX2 file \"{}\"", file);
+		return nullptr;
+	}
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(result->_file.GetData());
+	const size_t size = result->_file.GetSize();
+
+	Ktx2Header header;
+	memcpy(&header, bytes + sizeof(KTX2_IDENTIFIER), sizeof(Ktx2Header));
+	if (memcmp(bytes, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		LOG_WARN("\"{}\" is not a KTX2 file", file);
+		return nullptr;
+	}
+
+	const Ktx2Format* format = FindKtx2Format(header.VkFormat);
+	if (format == nullptr) {
+		LOG_WARN("KTX2 file \"{}\" uses an unsupported format (VkFormat {})", file, header.VkFormat);
+		return nullptr;
+	}
+	if (header.PixelWidth == 0 || header.PixelHeight == 0 || header.PixelDepth > 1 || header.LayerCount > 1 || header.FaceCount != 1) {
+		LOG_WARN("KTX2 file \"{}\" is not a 2D texture, only 2D textures are supported", file);
+		return nullptr;
+	}
+	if (header.SupercompressionScheme != 0) {
+		LOG_WARN("KTX2 file \"{}\" uses supercompression, which is not supported", file);
+		return nullptr;
+	}
+
+	// A level count of 0 asks us to generate the mip maps, which we can't do for compressed data, so we just use the top level
+	const uint32_t levelCount = std::max(header.LevelCount, 1u);
+	const size_t levelIndexOffset = sizeof(KTX2_IDENTIFIER) + sizeof(Ktx2Header);
+	if (levelIndexOffset + levelCount * sizeof(Ktx2LevelIndex) > size || levelCount > GetFullMipCount(header.PixelWidth, header.PixelHeight)) {
+		LOG_WARN("KTX2 file \"{}\" is corrupt", file);
+		return nullptr;
+	}
+
+	result->_format = format->Format;
+	result->_width = header.PixelWidth;
+	result->_height = header.PixelHeight;
+	result->_levels.resize(levelCount);
+	for (uint32_t ix = 0; ix < levelCount; ix++) {
+		Ktx2LevelIndex index;
+		memcpy(&index, bytes + levelIndexOffset + ix * sizeof(Ktx2LevelIndex), sizeof(Ktx2LevelIndex));
+
+		MipLevel& level = result->_levels[ix];
+		level.Width = std::max(header.PixelWidth >> ix, 1u);
+		level.Height = std::max(header.PixelHeight >> ix, 1u);
+		level.Offset = index.ByteOffset;
+		level.Size = index.ByteLength;
+		if (level.Size != GetCompressedImageSize(format->Format, level.Width, level.Height) || level.Offset > size || level.Size > size - level.Offset) {
+			LOG_WARN("KTX2 file \"{}\" is corrupt, mip level {} has the wrong size", file, ix);
+			return nullptr;
+		}
+	}
+
+	// Files made by other tools default to having the top of the image first, which will show up upside down
+	if (header.KvdByteOffset <= size && header.KvdByteLength <= size - header.KvdByteOffset) {
+		const std::string orientation = FindKeyValue(bytes + header.KvdByteOffset, header.KvdByteLength, "KTXorientation");
+		if (orientation.length() < 2 || orientation[1] != 'u') {
+			LOG_WARN("KTX2 file \"{}\" is stored top to bottom, it will be upside down (write it with a KTXorientation of \"ru\")", file);
+		}
+	}
+
+	result->_base = bytes;
+	result->DebugName = std::filesystem::path(file).filename().string();
+	return result;
+}
+
+bool CompressedTextureData::SaveToKtx2(const std::string& file) const {
+	const Ktx2Format* format = FindKtx2Format(_format);
+	LOG_ASSERT(format != nullptr, "No KTX2 format for {}", _format);
+
+	const std::vector<uint32_t> descriptor = BuildDataFormatDescriptor(*format);
+	// Keys must be sorted
+	std::vector<uint8_t> keyValues;
+	AppendKeyValue(keyValues, "KTXorientation", "ru");
+	AppendKeyValue(keyValues, "KTXwriter", "OTTER BlockCompressor");
+
+	Ktx2Header header;
+	memset(&header, 0, sizeof(Ktx2Header));
+	header.VkFormat = format->VkFormat;
+	header.TypeSize = 1;
+	header.PixelWidth = _width;
+	header.PixelHeight = _height;
+	header.FaceCount = 1;
+	header.LevelCount = GetLevelCount();
+	header.DfdByteOffset = static_cast<uint32_t>(sizeof(KTX2_IDENTIFIER) + sizeof(Ktx2Header) + _levels.size() * sizeof(Ktx2LevelIndex));
+	header.DfdByteLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+	header.KvdByteOffset = header.DfdByteOffset + header.DfdByteLength;
+	header.KvdByteLength = static_cast<uint32_t>(keyValues.size());
+
+	// The smallest level comes first, so that a streaming loader can show something as early as possible. Each level
+	// starts on a multiple of the block size
+	const size_t blockSize = GetCompressedBlockSize(_format);
+	std::vector<Ktx2LevelIndex> levelIndex(_levels.size());
+	size_t offset = header.KvdByteOffset + header.KvdByteLength;
+	for (size_t ix = _levels.size(); ix-- > 0;) {
+		offset = AlignUp(offset, blockSize);
+		levelIndex[ix].ByteOffset = offset;
+		levelIndex[ix].ByteLength = _levels[ix].Size;
+		levelIndex[ix].UncompressedByteLength = _levels[ix].Size;
+		offset += _levels[ix].Size;
+	}
+
+	// We write to a temporary file and then move it into place, same as MeshCache
+	const std::string tempPath = file + ".tmp";
+	{
+		std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+		if (!stream) {
+			LOG_WARN("Could not open \"{}\" to write a KTX2 file", tempPath);
+			return false;
+		}
+
+		const char padding[16] = { 0 };
+		stream.write(reinterpret_cast<const char*>(KTX2_IDENTIFIER), sizeof(KTX2_IDENTIFIER));
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(Ktx2Header));
+		stream.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(Ktx2LevelIndex));
+		stream.write(reinterpret_cast<const char*>(descriptor.data()), header.DfdByteLength);
+		stream.write(reinterpret_cast<const char*>(keyValues.data()), keyValues.size());
+		size_t position = header.KvdByteOffset + header.KvdByteLength;
+		for (size_t ix = _levels.size(); ix-- > 0;) {
+			stream.write(padding, levelIndex[ix].ByteOffset - position);
+			stream.write(reinterpret_cast<const char*>(GetLevelData(static_cast<uint32_t>(ix))), _levels[ix].Size);
+			position = levelIndex[ix].ByteOffset + _levels[ix].Size;
+		}
+
+		if (!stream) {
+			LOG_WARN("Failed to write KTX2 file \"{}\"", tempPath);
+			stream.close();
+			std::error_code error;
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, file, error);
+	if (error) {
+		LOG_WARN("Failed to move KTX2 file into place at \"{}\": {}", file, error.message());
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <memory>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "TextureEnums.h"
+#include "Utilities/MappedFile.h"
+
+/// <summary>
+/// Stores a block compressed 2D image along with its full chain of mip maps, ready to be uploaded with
+/// glCompressedTextureSubImage2D. These are stored on disk as KTX2 files (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html),
+/// which can be made with BlockCompressor or any other KTX2 tool.
+///
+/// Like Texture2DData, the first row of each level is the bottom of the image, which KTX2 files record with a
+/// KTXorientation of "ru"
+/// </summary>
+class CompressedTextureData final
+{
+public:
+	CompressedTextureData(const CompressedTextureData& other) = delete;
+	CompressedTextureData(CompressedTextureData&& other) = delete;
+	CompressedTextureData& operator=(const CompressedTextureData& other) = delete;
+	CompressedTextureData& operator=(CompressedTextureData&& other) = delete;
+	typedef std::shared_ptr<CompressedTextureData> sptr;
+
+	/// <summary>
+	/// Describes where a single mip level lives in the data
+	/// </summary>
+	struct MipLevel {
+		uint32_t Width;
+		uint32_t Height;
+		size_t   Offset; // The offset of the level's first block from the start of the data, in bytes
+		size_t   Size;   // The size of the level, in bytes
+	};
+
+	std::string DebugName;
+
+	/// <summary>
+	/// Creates a new compressed image, with room for the given number of mip levels. The blocks are left zeroed for
+	/// the caller to fill in (see GetMutableLevelData)
+	/// </summary>
+	/// <param name="format">The compressed format of the image, must be one of the BCn formats</param>
+	/// <param name="width">The width of the top level, in pixels</param>
+	/// <param name="height">The height of the top level, in pixels</param>
+	/// <param name="levelCount">The number of mip levels, or 0 for a full chain down to 1x1</param>
+	CompressedTextureData(InternalFormat format, uint32_t width, uint32_t height, uint32_t levelCount = 0);
+	~CompressedTextureData() = default;
+
+	/// <summary>
+	/// Loads a compressed image from a KTX2 file. The file is memory mapped, and the levels are read straight from the
+	/// mapping when they are uploaded. Only 2D images with a single layer and no supercompression are supported
+	/// </summary>
+	/// <param name="file">The path of the file to load</param>
+	/// <returns>The image, or nullptr if the file could not be loaded</returns>
+	static CompressedTextureData::sptr LoadFromKtx2(const std::string& file);
+	/// <summary>
+	/// Writes this image and all of its mip levels to a KTX2 file
+	/// </summary>
+	/// <param name="file">The path of the file to write</param>
+	/// <returns>True if the file was written, false if otherwise</returns>
+	bool SaveToKtx2(const std::string& file) const;
+
+	/// <summary>
+	/// Gets the number of mip levels needed to go from an image of the given size all the way down to 1x1
+	/// </summary>
+	static uint32_t GetFullMipCount(uint32_t width, uint32_t height);
+
+	InternalFormat GetFormat() const { return _format; }
+	uint32_t GetWidth() const { return _width; }
+	uint32_t GetHeight() const { return _height; }
+	uint32_t GetLevelCount() const { return static_cast<uint32_t>(_levels.size()); }
+	const MipLevel& GetLevel(uint32_t level) const { return _levels[level]; }
+	/// <summary>
+	/// Gets the total size of all of the mip levels, in bytes
+	/// </summary>
+	size_t GetDataSize() const;
+
+	/// <summary>
+	/// Gets the blocks for a mip level, stored row by row from the bottom of the image up
+	/// </summary>
+	const uint8_t* GetLevelData(uint32_t level) const { return _base + _levels[level].Offset; }
+	/// <summary>
+	/// Gets the blocks for a mip level so they can be filled in, only allowed for images that were not loaded from a file
+	/// </summary>
+	uint8_t* GetMutableLevelData(uint32_t level);
+
+private:
+	CompressedTextureData();
+
+	InternalFormat        _format;
+	uint32_t              _width, _height;
+	std::vector<MipLevel> _levels;
+	// Images we create own their blocks, images loaded from a file point into the file's mapping
+	std::vector<uint8_t>  _data;
+	MappedFile            _file;
+	const uint8_t*        _base;
+};
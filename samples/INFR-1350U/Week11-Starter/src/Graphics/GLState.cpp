@@ -0,0 +1,248 @@
+#include "GLState.h"
+
+// Everything starts out matching the state of a freshly created context
+GLuint GLState::_program = 0;
+GLuint GLState::_vao = 0;
+GLuint GLState::_textures[MAX_TEXTURE_UNITS] = { };
+GLuint GLState::_arrayBuffer = 0;
+GLuint GLState::_uniformBuffer = 0;
+GLuint GLState::_storageBuffer = 0;
+GLState::BufferRange GLState::_uniformRanges[MAX_INDEXED_BINDINGS] = { };
+GLState::BufferRange GLState::_storageRanges[MAX_INDEXED_BINDINGS] = { };
+int    GLState::_depthTest = 0;
+int    GLState::_cullFace = 0;
+int    GLState::_blend = 0;
+GLenum GLState::_depthFunc = GL_LESS;
+GLenum GLState::_cullFaceMode = GL_BACK;
+GLenum GLState::_blendSrc = GL_ONE;
+GLenum GLState::_blendDst = GL_ZERO;
+GLState::Stats GLState::_frameStats = GLState::Stats();
+GLState::Stats GLState::_lastFrameStats = GLState::Stats();
+
+void GLState::UseProgram(GLuint program) {
+	if (_program == program) {
+		_frameStats.Elided++;
+		return;
+	}
+	glUseProgram(program);
+	_program = program;
+	_frameStats.Issued++;
+}
+
+void GLState::BindVertexArray(GLuint vao) {
+	if (_vao == vao) {
+		_frameStats.Elided++;
+		return;
+	}
+	glBindVertexArray(vao);
+	_vao = vao;
+	_frameStats.Issued++;
+}
+
+void GLState::BindTextureUnit(GLuint unit, GLuint texture) {
+	if (unit < MAX_TEXTURE_UNITS) {
+		if (_textures[unit] == texture) {
+			_frameStats.Elided++;
+			return;
+		}
+		_textures[unit] = texture;
+	}
+	glBindTextureUnit(unit, texture);
+	_frameStats.Issued++;
+}
+
+void GLState::BindTextures(GLuint first, GLsizei count, const GLuint* textures) {
+	if (count <= 0) {
+		return;
+	}
+	if (first + count > MAX_TEXTURE_UNITS) {
+		glBindTextures(first, count, textures);
+		for (GLuint unit = first; unit < MAX_TEXTURE_UNITS; unit++) {
+			_textures[unit] = textures[unit - first];
+		}
+		_frameStats.Issued++;
+		return;
+	}
+
+	// Find the span of units that actually need to change, usually materials sharing a shader share some textures
+	GLsizei begin = 0;
+	while (begin < count && _textures[first + begin] == textures[begin]) {
+		begin++;
+	}
+	if (begin == count) {
+		_frameStats.Elided++;
+		return;
+	}
+	GLsizei end = count;
+	while (_textures[first + end - 1] == textures[end - 1]) {
+		end--;
+	}
+
+	glBindTextures(first + begin, end - begin, textures + begin);
+	for (GLsizei ix = begin; ix < end; ix++) {
+		_textures[first + ix] = textures[ix];
+	}
+	_frameStats.Issued++;
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer) {
+	GLuint* binding = _GetBufferBinding(target);
+	if (binding != nullptr) {
+		if (*binding == buffer) {
+			_frameStats.Elided++;
+			return;
+		}
+		*binding = buffer;
+	}
+	glBindBuffer(target, buffer);
+	_frameStats.Issued++;
+}
+
+void GLState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+	BufferRange* ranges = _GetIndexedRanges(target);
+	if (ranges != nullptr && index < MAX_INDEXED_BINDINGS) {
+		BufferRange& range = ranges[index];
+		if (range.Buffer == buffer && range.Offset == offset && range.Size == size) {
+			_frameStats.Elided++;
+			return;
+		}
+		range = { buffer, offset, size };
+	}
+	glBindBufferRange(target, index, buffer, offset, size);
+	// Binding a range also changes the generic binding for the target
+	GLuint* binding = _GetBufferBinding(target);
+	if (binding != nullptr) {
+		*binding = buffer;
+	}
+	_frameStats.Issued++;
+}
+
+void GLState::SetEnabled(GLenum capability, bool enabled) {
+	int* state = nullptr;
+	switch (capability) {
+		case GL_DEPTH_TEST: state = &_depthTest; break;
+		case GL_CULL_FACE:  state = &_cullFace;  break;
+		case GL_BLEND:      state = &_blend;     break;
+		default: break;
+	}
+	if (state != nullptr) {
+		if (*state == (enabled ? 1 : 0)) {
+			_frameStats.Elided++;
+			return;
+		}
+		*state = enabled ? 1 : 0;
+	}
+	if (enabled) {
+		glEnable(capability);
+	} else {
+		glDisable(capability);
+	}
+	_frameStats.Issued++;
+}
+
+void GLState::DepthFunc(GLenum func) {
+	if (_depthFunc == func) {
+		_frameStats.Elided++;
+		return;
+	}
+	glDepthFunc(func);
+	_depthFunc = func;
+	_frameStats.Issued++;
+}
+
+void GLState::CullFace(GLenum face) {
+	if (_cullFaceMode == face) {
+		_frameStats.Elided++;
+		return;
+	}
+	glCullFace(face);
+	_cullFaceMode = face;
+	_frameStats.Issued++;
+}
+
+void GLState::BlendFunc(GLenum srcFactor, GLenum dstFactor) {
+	if (_blendSrc == srcFactor && _blendDst == dstFactor) {
+		_frameStats.Elided++;
+		return;
+	}
+	glBlendFunc(srcFactor, dstFactor);
+	_blendSrc = srcFactor;
+	_blendDst = dstFactor;
+	_frameStats.Issued++;
+}
+
+void GLState::OnProgramDeleted(GLuint program) {
+	// A program that is in use stays current until something else is used, so we just forget about it
+	if (_program == program) {
+		_program = UNKNOWN;
+	}
+}
+
+void GLState::OnVertexArrayDeleted(GLuint vao) {
+	if (_vao == vao) {
+		_vao = 0;
+	}
+}
+
+void GLState::OnTextureDeleted(GLuint texture) {
+	for (int ix = 0; ix < MAX_TEXTURE_UNITS; ix++) {
+		if (_textures[ix] == texture) {
+			_textures[ix] = 0;
+		}
+	}
+}
+
+void GLState::OnBufferDeleted(GLuint buffer) {
+	if (_arrayBuffer == buffer)   { _arrayBuffer = 0; }
+	if (_uniformBuffer == buffer) { _uniformBuffer = 0; }
+	if (_storageBuffer == buffer) { _storageBuffer = 0; }
+	for (int ix = 0; ix < MAX_INDEXED_BINDINGS; ix++) {
+		if (_uniformRanges[ix].Buffer == buffer) { _uniformRanges[ix] = { 0, 0, 0 }; }
+		if (_storageRanges[ix].Buffer == buffer) { _storageRanges[ix] = { 0, 0, 0 }; }
+	}
+}
+
+void GLState::Invalidate() {
+	_program = UNKNOWN;
+	_vao = UNKNOWN;
+	for (int ix = 0; ix < MAX_TEXTURE_UNITS; ix++) {
+		_textures[ix] = UNKNOWN;
+	}
+	_arrayBuffer = UNKNOWN;
+	_uniformBuffer = UNKNOWN;
+	_storageBuffer = UNKNOWN;
+	for (int ix = 0; ix < MAX_INDEXED_BINDINGS; ix++) {
+		_uniformRanges[ix] = { UNKNOWN, 0, 0 };
+		_storageRanges[ix] = { UNKNOWN, 0, 0 };
+	}
+	_depthTest = -1;
+	_cullFace = -1;
+	_blend = -1;
+	_depthFunc = UNKNOWN;
+	_cullFaceMode = UNKNOWN;
+	_blendSrc = UNKNOWN;
+	_blendDst = UNKNOWN;
+}
+
+void GLState::EndFrame() {
+	_lastFrameStats = _frameStats;
+	_frameStats = Stats();
+}
+
+GLuint* GLState::_GetBufferBinding(GLenum target) {
+	switch (target) {
+		case GL_ARRAY_BUFFER:          return &_arrayBuffer;
+		case GL_UNIFORM_BUFFER:        return &_uniformBuffer;
+		case GL_SHADER_STORAGE_BUFFER: return &_storageBuffer;
+		// GL_ELEMENT_ARRAY_BUFFER belongs to the bound VAO, so we can't track it here
+		default: return nullptr;
+	}
+}
+
+GLState::BufferRange* GLState::_GetIndexedRanges(GLenum target) {
+	switch (target) {
+		case GL_UNIFORM_BUFFER:        return _uniformRanges;
+		case GL_SHADER_STORAGE_BUFFER: return _storageRanges;
+		default: return nullptr;
+	}
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+
+/// <summary>
+/// Keeps track of the OpenGL state that our graphics classes change (the current program, VAO, texture units, buffer
+/// bindings and a few capabilities), so that calls that would not change anything are never sent to the driver.
+/// All of our Graphics classes should go through this instead of calling glUseProgram, glBindTextureUnit, etc... directly
+///
+/// Anything that changes GL state behind our back (ex: ImGui) should be followed by a call to Invalidate
+/// </summary>
+class GLState final
+{
+public:
+	/// <summary>
+	/// The number of texture units that we track, binds to higher units are always issued
+	/// </summary>
+	static constexpr int MAX_TEXTURE_UNITS = 32;
+	/// <summary>
+	/// The number of indexed uniform and storage buffer binding points that we track
+	/// </summary>
+	static constexpr int MAX_INDEXED_BINDINGS = 16;
+
+	/// <summary>
+	/// The number of state changes that were sent to OpenGL, and the number that were skipped because they would not
+	/// have changed anything
+	/// </summary>
+	struct Stats {
+		uint32_t Issued = 0;
+		uint32_t Elided = 0;
+	};
+
+	/// <summary>
+	/// Makes the given shader program current (glUseProgram)
+	/// </summary>
+	static void UseProgram(GLuint program);
+	/// <summary>
+	/// Binds the given vertex array object (glBindVertexArray)
+	/// </summary>
+	static void BindVertexArray(GLuint vao);
+	/// <summary>
+	/// Binds a texture to a texture unit (glBindTextureUnit)
+	/// </summary>
+	/// <param name="unit">The texture unit to bind to, starting from 0</param>
+	/// <param name="texture">The texture to bind, or 0 to unbind the unit</param>
+	static void BindTextureUnit(GLuint unit, GLuint texture);
+	/// <summary>
+	/// Binds a list of textures to consecutive texture units (glBindTextures). Only the span of units that actually
+	/// changed is sent to OpenGL
+	/// </summary>
+	/// <param name="first">The first texture unit to bind to</param>
+	/// <param name="count">The number of textures in the list</param>
+	/// <param name="textures">The textures to bind, 0 unbinds a unit</param>
+	static void BindTextures(GLuint first, GLsizei count, const GLuint* textures);
+	/// <summary>
+	/// Binds a buffer to a target (glBindBuffer). Note that GL_ELEMENT_ARRAY_BUFFER is part of the VAO state, so it is
+	/// never elided
+	/// </summary>
+	static void BindBuffer(GLenum target, GLuint buffer);
+	/// <summary>
+	/// Binds a range of a buffer to an indexed binding point of a uniform or storage buffer target (glBindBufferRange)
+	/// </summary>
+	static void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	/// <summary>
+	/// Enables or disables a capability (glEnable/glDisable). GL_DEPTH_TEST, GL_CULL_FACE and GL_BLEND are tracked,
+	/// anything else is always issued
+	/// </summary>
+	static void SetEnabled(GLenum capability, bool enabled);
+	/// <summary>
+	/// Sets the depth comparison function (glDepthFunc)
+	/// </summary>
+	static void DepthFunc(GLenum func);
+	/// <summary>
+	/// Sets which faces get culled when GL_CULL_FACE is enabled (glCullFace)
+	/// </summary>
+	static void CullFace(GLenum face);
+	/// <summary>
+	/// Sets the blending factors (glBlendFunc)
+	/// </summary>
+	static void BlendFunc(GLenum srcFactor, GLenum dstFactor);
+
+	/// <summary>
+	/// Lets the tracker know that a program was deleted, so that a new program re-using the name will still be bound
+	/// </summary>
+	static void OnProgramDeleted(GLuint program);
+	/// <summary>
+	/// Lets the tracker know that a VAO was deleted, which OpenGL unbinds if it was bound
+	/// </summary>
+	static void OnVertexArrayDeleted(GLuint vao);
+	/// <summary>
+	/// Lets the tracker know that a texture was deleted, which OpenGL unbinds from every unit it was bound to
+	/// </summary>
+	static void OnTextureDeleted(GLuint texture);
+	/// <summary>
+	/// Lets the tracker know that a buffer was deleted, which OpenGL unbinds from every target it was bound to
+	/// </summary>
+	static void OnBufferDeleted(GLuint buffer);
+
+	/// <summary>
+	/// Forgets everything we know about the GL state, so the next call of each kind is always issued. Use this after
+	/// code that does not go through GLState has touched the state
+	/// </summary>
+	static void Invalidate();
+
+	/// <summary>
+	/// Stores this frame's counts so they can be read with GetStats, and resets the counters for the next frame
+	/// </summary>
+	static void EndFrame();
+	/// <summary>
+	/// Gets the counts for the last frame that EndFrame was called for
+	/// </summary>
+	static const Stats& GetStats() { return _lastFrameStats; }
+
+private:
+	GLState() = delete;
+
+	// Marks a binding that we don't know the value of, no real object will ever have this name
+	static constexpr GLuint UNKNOWN = ~0u;
+
+	struct BufferRange {
+		GLuint     Buffer;
+		GLintptr   Offset;
+		GLsizeiptr Size;
+	};
+
+	static GLuint _program;
+	static GLuint _vao;
+	static GLuint _textures[MAX_TEXTURE_UNITS];
+	static GLuint _arrayBuffer;
+	static GLuint _uniformBuffer;
+	static GLuint _storageBuffer;
+	static BufferRange _uniformRanges[MAX_INDEXED_BINDINGS];
+	static BufferRange _storageRanges[MAX_INDEXED_BINDINGS];
+	// Capabilities are 0 (disabled), 1 (enabled) or -1 (unknown)
+	static int    _depthTest;
+	static int    _cullFace;
+	static int    _blend;
+	static GLenum _depthFunc;
+	static GLenum _cullFaceMode;
+	static GLenum _blendSrc;
+	static GLenum _blendDst;
+
+	static Stats _frameStats;
+	static Stats _lastFrameStats;
+
+	/// <summary>
+	/// Gets the tracked generic binding for a buffer target, or nullptr if we don't track that target
+	/// </summary>
+	static GLuint* _GetBufferBinding(GLenum target);
+	/// <summary>
+	/// Gets the tracked indexed ranges for a buffer target, or nullptr if we don't track that target
+	/// </summary>
+	static BufferRange* _GetIndexedRanges(GLenum target);
+};
@@ -1,4 +1,5 @@
 #include "IBuffer.h"
+#include "GLState.h"
 
 IBuffer::IBuffer(GLenum type, GLenum usage) :
 	_elementCount(0),
@@ -12,6 +13,7 @@ IBuffer::IBuffer(GLenum type, GLenum usage) :
 
 IBuffer::~IBuffer() {
 	if (_handle != 0) {
+		GLState::OnBufferDeleted(_handle);
 		glDeleteBuffers(1, &_handle);
 		_handle = 0;
 	}
@@ -25,9 +27,9 @@ void IBuffer::LoadData(const void* data, size_t elementSize, size_t elementCount
 }
 
 void IBuffer::Bind() {
-	glBindBuffer(_type, _handle);
+	GLState::BindBuffer(_type, _handle);
 }
 
 void IBuffer::UnBind(GLenum type) {
-	glBindBuffer(type, 0);
+	GLState::BindBuffer(type, 0);
 }
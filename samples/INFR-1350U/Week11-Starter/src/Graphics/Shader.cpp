@@ -1,18 +1,56 @@
 #include "Shader.h"
 #include "Logging.h"
-#include <fstream>
-#include <sstream>
+#include "GLState.h"
+#include "ShaderCache.h"
+#include "Utilities/MappedFile.h"
+#include <stdexcept>
+#include <vector>
+
+namespace {
+	/*
+	 * Checks whether a uniform type reported by OpenGL is a sampler that needs a texture unit
+	 * @param type The type of the uniform (ex: GL_SAMPLER_2D)
+	 */
+	bool IsSamplerType(GLenum type) {
+		switch (type) {
+			case GL_SAMPLER_1D:
+			case GL_SAMPLER_2D:
+			case GL_SAMPLER_3D:
+			case GL_SAMPLER_CUBE:
+			case GL_SAMPLER_1D_SHADOW:
+			case GL_SAMPLER_2D_SHADOW:
+			case GL_SAMPLER_1D_ARRAY:
+			case GL_SAMPLER_2D_ARRAY:
+			case GL_SAMPLER_2D_ARRAY_SHADOW:
+			case GL_SAMPLER_CUBE_SHADOW:
+			case GL_SAMPLER_CUBE_MAP_ARRAY:
+			case GL_SAMPLER_2D_MULTISAMPLE:
+			case GL_INT_SAMPLER_2D:
+			case GL_UNSIGNED_INT_SAMPLER_2D:
+				return true;
+			default:
+				return false;
+		}
+	}
+}
+
+uint32_t Shader::_nextId = 0;
 
 Shader::Shader() :
 	_vs(0),
 	_fs(0),
-	_handle(0)
+	_handle(0),
+	_id(_nextId++),
+	_cacheKey(0),
+	_isFromCache(false),
+	_materialBlockSize(0)
 {
 	_handle = glCreateProgram();
 }
 
 Shader::~Shader() {
 	if (_handle != 0) {
+		GLState::OnProgramDeleted(_handle);
 		glDeleteProgram(_handle);
 		_handle = 0;
 		LOG_INFO("Deleting shader program");
@@ -21,13 +59,53 @@ Shader::~Shader() {
 
 bool Shader::LoadShaderPart(const char* source, GLenum type)
 {
+	// We hold on to the source until we link, so that we can check the program cache before compiling anything
+	switch (type) {
+		case GL_VERTEX_SHADER: _vsSource = source; return true;
+		case GL_FRAGMENT_SHADER: _fsSource = source; return true;
+		default: LOG_WARN("Not implemented"); return false;
+	}
+}
+
+bool Shader::LoadShaderPartFromFile(const char* path, GLenum type) {
+	MappedFile file(path);
+	if (!file.IsOpen()) {
+		LOG_ERROR("File not found: {}", path);
+		throw std::runtime_error("File not found, see logs for more information");
+	}
+	const std::string source(file.GetData(), file.GetSize());
+	return LoadShaderPart(source.c_str(), type);
+}
+
+void Shader::AddDefine(const std::string& name, const std::string& value) {
+	_defines += "#define " + name + " " + value + "\n";
+}
+
+GLuint Shader::_CompilePart(const std::string& source, GLenum type) const {
+	// Defines have to come after the #version line, the #line directive keeps the line numbers in error logs correct
+	std::string expanded;
+	const char* text = source.c_str();
+	if (!_defines.empty()) {
+		size_t versionEnd = 0;
+		if (source.compare(0, 8, "#version") == 0) {
+			versionEnd = source.find('\n');
+			versionEnd = versionEnd == std::string::npos ? source.size() : versionEnd + 1;
+		}
+		expanded = source.substr(0, versionEnd) + _defines + "#line " + std::to_string(versionEnd > 0 ? 2 : 1) + "\n" + source.substr(versionEnd);
+		text = expanded.c_str();
+	}
+
 	// Creates a new shader part (VS, FS, GS, etc...)
 	GLuint handle = glCreateShader(type);
 
-	// Load the GLSL source and compile it
-	glShaderSource(handle, 1, &source, nullptr);
+	// Load the GLSL source and start compiling it, we don't ask for the status until FinishLink so the driver can
+	// compile in the background
+	glShaderSource(handle, 1, &text, nullptr);
 	glCompileShader(handle);
+	return handle;
+}
 
+bool Shader::_CheckPart(GLuint handle) const {
 	// Get the compilation status for the shader part
 	GLint status = 0;
 	glGetShaderiv(handle, GL_COMPILE_STATUS, &status);
@@ -48,50 +126,64 @@ bool Shader::LoadShaderPart(const char* source, GLenum type)
 
 		// Clean up our log memory
 		delete[] log;
-
-		// Delete the broken shader result
-		glDeleteShader(handle);
-		handle = 0;
 	}
-
-	switch (type) {
-		case GL_VERTEX_SHADER: _vs = handle; break;
-		case GL_FRAGMENT_SHADER: _fs = handle; break;
-		default: LOG_WARN("Not implemented"); break;
-	}
-
 	return status != GL_FALSE;
 }
 
-bool Shader::LoadShaderPartFromFile(const char* path, GLenum type) {
-	std::ifstream file(path);
-	if (!file.is_open()) {
-		LOG_ERROR("File not found: {}", path);
-		throw std::runtime_error("File not found, see logs for more information");
-	}
-	std::stringstream stream;
-	stream << file.rdbuf();
-	bool result = LoadShaderPart(stream.str().c_str(), type);
-	file.close();
-	return result;
+bool Shader::Link()
+{
+	BeginLink();
+	return FinishLink();
 }
 
-bool Shader::Link()
+void Shader::BeginLink()
 {
-	LOG_ASSERT(_vs != 0 && _fs != 0, "Must attach both a vertex and fragment shader!");
+	LOG_ASSERT(!_vsSource.empty() && !_fsSource.empty(), "Must attach both a vertex and fragment shader!");
+
+	_isFromCache = false;
+	if (ShaderCache::IsEnabled()) {
+		_cacheKey = ShaderCache::MakeKey(_vsSource, _fsSource, _defines);
+		_isFromCache = ShaderCache::Load(_handle, _cacheKey);
+		if (_isFromCache) {
+			return;
+		}
+	}
+
+	_vs = _CompilePart(_vsSource, GL_VERTEX_SHADER);
+	_fs = _CompilePart(_fsSource, GL_FRAGMENT_SHADER);
 
 	// Attach our two shaders
 	glAttachShader(_handle, _vs);
 	glAttachShader(_handle, _fs);
 
+	// Let the driver know we'll want to read the binary back for the cache
+	glProgramParameteri(_handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
 	// Perform linking
 	glLinkProgram(_handle);
+}
+
+bool Shader::FinishLink()
+{
+	// A program loaded from the cache is already linked, so we just need to read it's layout
+	if (_isFromCache) {
+		_ReflectUniforms();
+		_vsSource.clear();
+		_fsSource.clear();
+		return true;
+	}
+
+	// Report any compile errors, these would otherwise only show up as a confusing link error
+	_CheckPart(_vs);
+	_CheckPart(_fs);
 
 	// Remove shader parts to save space (we can do this since we only needed the shader parts to compile an actual shader program)
 	glDetachShader(_handle, _vs);
 	glDeleteShader(_vs);
 	glDetachShader(_handle, _fs);
 	glDeleteShader(_fs);
+	_vs = 0;
+	_fs = 0;
 
 	GLint status = 0;
 	glGetProgramiv(_handle, GL_LINK_STATUS, &status);
@@ -113,15 +205,98 @@ bool Shader::Link()
 			LOG_ERROR("Shader failed to link for an unknown reason!");
 		}
 	}
+	else {
+		_ReflectUniforms();
+		if (ShaderCache::IsEnabled()) {
+			ShaderCache::Save(_handle, _cacheKey);
+		}
+	}
+	_vsSource.clear();
+	_fsSource.clear();
 	return status != GL_FALSE;
 }
 
+bool Shader::LinkAll(const std::vector<sptr>& shaders) {
+	// Kick off every compile and link before we ask about any of them, so the driver can work on them all at once
+	ShaderCache::EnableParallelCompile();
+	for (const sptr& shader : shaders) {
+		shader->BeginLink();
+	}
+
+	// Finish whichever programs the driver says are done first, so we don't stall on a slow one while others are ready
+	std::vector<Shader*> pending;
+	pending.reserve(shaders.size());
+	for (const sptr& shader : shaders) {
+		pending.push_back(shader.get());
+	}
+	bool result = true;
+	while (!pending.empty()) {
+		auto ready = pending.begin();
+		for (auto it = pending.begin(); it != pending.end(); it++) {
+			if ((*it)->_isFromCache || ShaderCache::IsLinkComplete((*it)->_handle)) {
+				ready = it;
+				break;
+			}
+		}
+		result &= (*ready)->FinishLink();
+		pending.erase(ready);
+	}
+	return result;
+}
+
+void Shader::_ReflectUniforms() {
+	_materialUniforms.clear();
+	_textureUnits.clear();
+	_materialBlockSize = 0;
+
+	// If the shader has a material block, find out how big it is and bind it to the material binding point
+	const GLuint blockIndex = glGetProgramResourceIndex(_handle, GL_UNIFORM_BLOCK, MATERIAL_BLOCK_NAME);
+	if (blockIndex != GL_INVALID_INDEX) {
+		const GLenum sizeProp = GL_BUFFER_DATA_SIZE;
+		glGetProgramResourceiv(_handle, GL_UNIFORM_BLOCK, blockIndex, 1, &sizeProp, 1, nullptr, &_materialBlockSize);
+		glUniformBlockBinding(_handle, blockIndex, MATERIAL_BLOCK_BINDING);
+	}
+
+	GLint uniformCount = 0, maxNameLength = 0;
+	glGetProgramInterfaceiv(_handle, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+	glGetProgramInterfaceiv(_handle, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength);
+	std::vector<char> name(maxNameLength + 1);
+
+	const GLenum props[] = { GL_BLOCK_INDEX, GL_TYPE, GL_OFFSET, GL_MATRIX_STRIDE, GL_LOCATION };
+	for (GLint ix = 0; ix < uniformCount; ix++) {
+		GLint values[5];
+		glGetProgramResourceiv(_handle, GL_UNIFORM, ix, 5, props, 5, nullptr, values);
+		glGetProgramResourceName(_handle, GL_UNIFORM, ix, maxNameLength + 1, nullptr, name.data());
+
+		// Values in the material block get stored with their std140 offsets, so materials can fill out the block directly
+		if (blockIndex != GL_INVALID_INDEX && values[0] == static_cast<GLint>(blockIndex)) {
+			_materialUniforms[name.data()] = { static_cast<GLenum>(values[1]), values[2], values[3] };
+		}
+		// Samplers get a fixed texture unit, so materials only need to bind their textures to that unit
+		else if (values[0] == -1 && IsSamplerType(static_cast<GLenum>(values[1]))) {
+			const int unit = static_cast<int>(_textureUnits.size());
+			_textureUnits[name.data()] = unit;
+			glProgramUniform1i(_handle, values[4], unit);
+		}
+	}
+}
+
+const Shader::BlockUniform* Shader::GetMaterialUniform(const std::string& name) const {
+	auto it = _materialUniforms.find(name);
+	return it == _materialUniforms.end() ? nullptr : &it->second;
+}
+
+int Shader::GetTextureUnit(const std::string& name) const {
+	auto it = _textureUnits.find(name);
+	return it == _textureUnits.end() ? -1 : it->second;
+}
+
 void Shader::Bind() {
-	glUseProgram(_handle);
+	GLState::UseProgram(_handle);
 }
 
 void Shader::UnBind() {
-	glUseProgram(0);
+	GLState::UseProgram(0);
 }
 
 void Shader::SetUniformMatrix(int location, const glm::mat3* value, int count, bool transposed) {
@@ -4,6 +4,7 @@
 
 #include <string>               // for std::string
 #include <unordered_map>        // for std::unordered_map
+#include <vector>               // for std::vector
 #include <GLM/glm.hpp>          // for our GLM types
 #include <GLM/gtc/type_ptr.hpp> // for glm::value_ptr
 #include "Logging.h"            // for the logging functions
@@ -37,11 +38,12 @@ public:
 	~Shader();
 
 	/// <summary>
-	/// Loads a single shader stage into this shader object (ex: Vertex Shader or Fragment Shader)
+	/// Loads a single shader stage into this shader object (ex: Vertex Shader or Fragment Shader). The source is
+	/// compiled when the shader is linked, unless the linked program is found in the ShaderCache
 	/// </summary>
 	/// <param name="source">The source code of the shader to load</param>
 	/// <param name="type">The stage to load (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER)</param>
-	/// <returns>True if the shader is loaded, false if there was an issue</returns>
+	/// <returns>True if the shader is loaded, false if the stage is not supported</returns>
 	bool LoadShaderPart(const char* source, GLenum type);
 	/// <summary>
 	/// Loads a single shader stage into this shader object (ex: Vertex Shader or Fragment Shader) from an external file (in res)
@@ -51,11 +53,39 @@ public:
 	/// <returns>True if the shader is loaded, false if there was an issue</returns>
 	bool LoadShaderPartFromFile(const char* path, GLenum type);
 
+	/// <summary>
+	/// Adds a #define to every stage of this shader, must be called before linking
+	/// </summary>
+	/// <param name="name">The name of the macro to define</param>
+	/// <param name="value">The value of the macro, if any</param>
+	void AddDefine(const std::string& name, const std::string& value = "");
+
 	/// <summary>
 	/// Links the vertex and fragment shader, and allows this shader program to be used
 	/// </summary>
 	/// <returns>True if the linking was sucessful, false if otherwise</returns>
 	bool Link();
+	/// <summary>
+	/// Loads the program from the ShaderCache, or starts compiling and linking it without waiting for the result.
+	/// Must be followed by FinishLink before the shader is used
+	/// </summary>
+	void BeginLink();
+	/// <summary>
+	/// Waits for the link started by BeginLink, reports any errors and stores the program in the ShaderCache
+	/// </summary>
+	/// <returns>True if the linking was sucessful, false if otherwise</returns>
+	bool FinishLink();
+	/// <summary>
+	/// Links a group of shaders, starting every compile before checking on any of them so the driver can compile
+	/// them in parallel (using GL_KHR_parallel_shader_compile when it's available)
+	/// </summary>
+	/// <param name="shaders">The shaders to link, all of their stages should already be loaded</param>
+	/// <returns>True if every shader linked, false if otherwise</returns>
+	static bool LinkAll(const std::vector<sptr>& shaders);
+	/// <summary>
+	/// Returns true if the program was loaded from the ShaderCache on the last link, instead of being compiled
+	/// </summary>
+	bool IsFromCache() const { return _isFromCache; }
 
 	/// <summary>
 	/// Binds this shader for use
@@ -70,6 +100,51 @@ public:
 	/// Gets the underlying OpenGL handle that this class is wrapping
 	/// </summary>
 	GLuint GetHandle() const { return _handle; }
+	/// <summary>
+	/// Gets a unique number for this shader, unlike OpenGL handles these are never reused once a shader is deleted
+	/// </summary>
+	uint32_t GetId() const { return _id; }
+
+public:
+	/// <summary>
+	/// The name of the uniform block that holds per-material values, declared in GLSL as
+	/// layout (std140) uniform b_Material { ... };
+	/// </summary>
+	static constexpr const char* MATERIAL_BLOCK_NAME = "b_Material";
+	/// <summary>
+	/// The uniform buffer binding that the material block is bound to
+	/// </summary>
+	static constexpr GLuint MATERIAL_BLOCK_BINDING = 1;
+
+	/// <summary>
+	/// Describes where a single value lives inside of the material block, as reported by OpenGL after linking
+	/// </summary>
+	struct BlockUniform {
+		GLenum Type;
+		int    Offset;
+		int    MatrixStride;
+	};
+
+	/// <summary>
+	/// Gets the layout of a value in the material block, or nullptr if the block does not contain it
+	/// </summary>
+	/// <param name="name">The name of the uniform in the block</param>
+	const BlockUniform* GetMaterialUniform(const std::string& name) const;
+	/// <summary>
+	/// Gets the size of the material block in bytes, or 0 if this shader does not have one
+	/// </summary>
+	int GetMaterialBlockSize() const { return _materialBlockSize; }
+
+	/// <summary>
+	/// Gets the texture unit that the given sampler reads from, or -1 if the shader does not have that sampler.
+	/// Every sampler is given it's own unit when the shader is linked, starting from 0
+	/// </summary>
+	/// <param name="name">The name of the sampler uniform</param>
+	int GetTextureUnit(const std::string& name) const;
+	/// <summary>
+	/// Gets the number of texture units used by this shader's samplers
+	/// </summary>
+	int GetTextureUnitCount() const { return static_cast<int>(_textureUnits.size()); }
 	
 public:
 	int GetUniformLocation(const std::string& name);
@@ -121,7 +196,34 @@ protected:
 	GLuint _fs;
 	
 	GLuint _handle;
+	uint32_t _id;
+
+	// The sources for each stage and the #defines to add to them, kept until we link
+	std::string _vsSource;
+	std::string _fsSource;
+	std::string _defines;
+	uint64_t    _cacheKey;
+	bool        _isFromCache;
 
 	std::unordered_map<std::string, int> _uniformLocs;
+
+	int _materialBlockSize;
+	std::unordered_map<std::string, BlockUniform> _materialUniforms;
+	std::unordered_map<std::string, int> _textureUnits;
+
+	static uint32_t _nextId;
+
+	/// <summary>
+	/// Creates a shader part and starts compiling it, with our defines added after the #version line
+	/// </summary>
+	GLuint _CompilePart(const std::string& source, GLenum type) const;
+	/// <summary>
+	/// Checks whether a shader part compiled, logging the errors if it did not
+	/// </summary>
+	bool _CheckPart(GLuint handle) const;
+	/// <summary>
+	/// Reads the layout of the material block and assigns texture units to samplers, called after linking
+	/// </summary>
+	void _ReflectUniforms();
 	
 };
\ No newline at end of file
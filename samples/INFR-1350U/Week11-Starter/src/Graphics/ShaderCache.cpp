@@ -0,0 +1,195 @@
+#include "ShaderCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <GLFW/glfw3.h>
+
+#include "Logging.h"
+#include "Utilities/Hash.h"
+#include "Utilities/MappedFile.h"
+
+bool        ShaderCache::_isEnabled = true;
+std::string ShaderCache::_directory = "shader_cache";
+
+namespace {
+	// Bump the version whenever the layout of the file changes, so that old binaries get rebuilt
+	constexpr char     CACHE_MAGIC[4] = { 'S', 'P', 'R', 'G' };
+	constexpr uint32_t CACHE_VERSION = 1;
+
+	struct CacheHeader {
+		char     Magic[4];
+		uint32_t Version;
+		uint64_t Key;
+		uint64_t DriverHash;
+		uint32_t Format;
+		uint32_t Length;
+	};
+
+	// GL_KHR_parallel_shader_compile is not in our glad build, so we load it ourselves. The ARB version uses the same values
+	constexpr GLenum GL_COMPLETION_STATUS_KHR = 0x91B1;
+	typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+	bool isParallelCompileChecked = false;
+	bool isParallelCompileSupported = false;
+
+	/*
+	 * Checks whether the current context supports the given extension
+	 * @param name The name of the extension (ex: GL_KHR_parallel_shader_compile)
+	 */
+	bool HasExtension(const char* name) {
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint ix = 0; ix < count; ix++) {
+			const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, ix));
+			if (extension != nullptr && strcmp(extension, name) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+uint64_t ShaderCache::MakeKey(const std::string& vsSource, const std::string& fsSource, const std::string& defines) {
+	// Each part is hashed with the last part's hash as the seed, so moving text between stages changes the key
+	uint64_t key = HashBytes(vsSource.data(), vsSource.size(), CACHE_VERSION);
+	key = HashBytes(fsSource.data(), fsSource.size(), key);
+	return HashBytes(defines.data(), defines.size(), key);
+}
+
+bool ShaderCache::Load(GLuint program, uint64_t key) {
+	const std::string path = _GetPath(key);
+	MappedFile file(path);
+	if (!file.IsOpen() || file.GetSize() < sizeof(CacheHeader)) {
+		return false;
+	}
+
+	CacheHeader header;
+	memcpy(&header, file.GetData(), sizeof(CacheHeader));
+	if (memcmp(header.Magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.Version != CACHE_VERSION || header.Key != key ||
+		sizeof(CacheHeader) + header.Length > file.GetSize()) {
+		LOG_WARN("Shader cache \"{}\" is corrupt, it will be rebuilt", path);
+		return false;
+	}
+	if (header.DriverHash != _GetDriverHash()) {
+		LOG_INFO("Shader cache \"{}\" was built by a different driver, it will be rebuilt", path);
+		return false;
+	}
+
+	// The driver can still refuse a binary it made (ex: after an update that didn't change the version string)
+	glProgramBinary(program, header.Format, file.GetData() + sizeof(CacheHeader), header.Length);
+	GLint status = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE) {
+		LOG_INFO("Driver rejected shader cache \"{}\", it will be rebuilt", path);
+		return false;
+	}
+	return true;
+}
+
+bool ShaderCache::Save(GLuint program, uint64_t key) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return false;
+	}
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(CacheHeader));
+	memcpy(header.Magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.Version = CACHE_VERSION;
+	header.Key = key;
+	header.DriverHash = _GetDriverHash();
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	header.Format = format;
+	header.Length = static_cast<uint32_t>(length);
+
+	std::error_code error;
+	std::filesystem::create_directories(_directory, error);
+
+	// We write to a temporary file and then move it into place, so that a crash part way through can't leave behind
+	// a binary that looks valid
+	const std::string path = _GetPath(key);
+	const std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			LOG_WARN("Could not open \"{}\" to write a shader cache", tempPath);
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+		file.write(binary.data(), length);
+		if (!file) {
+			LOG_WARN("Failed to write shader cache \"{}\"", tempPath);
+			file.close();
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		LOG_WARN("Failed to move shader cache into place at \"{}\": {}", path, error.message());
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+void ShaderCache::EnableParallelCompile() {
+	if (isParallelCompileChecked) {
+		return;
+	}
+	isParallelCompileChecked = true;
+
+	const char* procName = nullptr;
+	if (HasExtension("GL_KHR_parallel_shader_compile")) {
+		procName = "glMaxShaderCompilerThreadsKHR";
+	} else if (HasExtension("GL_ARB_parallel_shader_compile")) {
+		procName = "glMaxShaderCompilerThreadsARB";
+	}
+	MaxShaderCompilerThreadsProc maxThreads = procName != nullptr ?
+		reinterpret_cast<MaxShaderCompilerThreadsProc>(glfwGetProcAddress(procName)) : nullptr;
+	if (maxThreads == nullptr) {
+		LOG_INFO("Parallel shader compiles are not supported, shaders will compile one at a time");
+		return;
+	}
+	// 0xFFFFFFFF lets the driver pick how many threads to use
+	maxThreads(0xFFFFFFFF);
+	isParallelCompileSupported = true;
+}
+
+bool ShaderCache::IsLinkComplete(GLuint program) {
+	if (!isParallelCompileSupported) {
+		return true;
+	}
+	GLint complete = GL_TRUE;
+	glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete != GL_FALSE;
+}
+
+uint64_t ShaderCache::_GetDriverHash() {
+	static uint64_t driverHash = 0;
+	if (driverHash == 0) {
+		std::string driver;
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+			const char* value = reinterpret_cast<const char*>(glGetString(name));
+			driver += value != nullptr ? value : "";
+			driver += '\n';
+		}
+		driverHash = HashBytes(driver.data(), driver.size());
+	}
+	return driverHash;
+}
+
+std::string ShaderCache::_GetPath(uint64_t key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.progbin", static_cast<unsigned long long>(key));
+	return _directory + "/" + name;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// Stores linked shader programs on disk using glGetProgramBinary, so that the next launch can skip compiling and
+/// linking them. Programs are keyed on a hash of their stage sources and defines, and each file remembers which driver
+/// built it. If the sources or the driver change, the program is compiled as normal and the file is replaced
+///
+/// Shader uses this automatically in Link and LinkAll
+/// </summary>
+class ShaderCache
+{
+public:
+	/// <summary>
+	/// Enables or disables reading and writing program binaries (enabled by default)
+	/// </summary>
+	static void SetEnabled(bool enabled) { _isEnabled = enabled; }
+	/// <summary>
+	/// Returns true if shaders should read and write the program cache
+	/// </summary>
+	static bool IsEnabled() { return _isEnabled; }
+
+	/// <summary>
+	/// Sets the folder that program binaries are stored in, relative to the working directory (default is shader_cache)
+	/// </summary>
+	static void SetDirectory(const std::string& directory) { _directory = directory; }
+	static const std::string& GetDirectory() { return _directory; }
+
+	/// <summary>
+	/// Builds the key that identifies a program in the cache
+	/// </summary>
+	/// <param name="vsSource">The source of the vertex shader</param>
+	/// <param name="fsSource">The source of the fragment shader</param>
+	/// <param name="defines">The block of #defines that are added to both stages</param>
+	static uint64_t MakeKey(const std::string& vsSource, const std::string& fsSource, const std::string& defines);
+
+	/// <summary>
+	/// Attempts to load a program binary from the cache into the given program
+	/// </summary>
+	/// <param name="program">The program object to load the binary into</param>
+	/// <param name="key">The key of the program, from MakeKey</param>
+	/// <returns>True if the program was loaded and is linked, false if it needs to be compiled</returns>
+	static bool Load(GLuint program, uint64_t key);
+	/// <summary>
+	/// Writes a linked program's binary to the cache
+	/// </summary>
+	/// <param name="program">The linked program to store</param>
+	/// <param name="key">The key of the program, from MakeKey</param>
+	/// <returns>True if the file was written, false if otherwise</returns>
+	static bool Save(GLuint program, uint64_t key);
+
+	/// <summary>
+	/// Lets the driver use as many threads as it likes for compiling shaders, if it supports
+	/// GL_KHR_parallel_shader_compile (or the ARB version). Safe to call more than once
+	/// </summary>
+	static void EnableParallelCompile();
+	/// <summary>
+	/// Returns true if the driver has finished linking the given program, so that querying it's status will not block.
+	/// Always returns true if the driver does not support parallel compiles
+	/// </summary>
+	static bool IsLinkComplete(GLuint program);
+
+protected:
+	ShaderCache() = default;
+	~ShaderCache() = default;
+
+	static bool        _isEnabled;
+	static std::string _directory;
+
+	/// <summary>
+	/// Gets a hash of the vendor, renderer and version strings, binaries from any other driver will be rejected
+	/// </summary>
+	static uint64_t _GetDriverHash();
+	/// <summary>
+	/// Gets the path of the file for a key
+	/// </summary>
+	static std::string _GetPath(uint64_t key);
+};
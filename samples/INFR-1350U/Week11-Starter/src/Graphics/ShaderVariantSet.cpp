@@ -0,0 +1,279 @@
+#include "ShaderVariantSet.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "Logging.h"
+#include "ShaderCache.h"
+#include "Utilities/MappedFile.h"
+
+namespace {
+	/*
+	 * Splits a preprocessor line into it's directive and the first word after it
+	 * @param line      The line to parse
+	 * @param directive Receives the directive without the # (ex: ifdef), or is cleared if the line is not a directive
+	 * @param argument  Receives the first word or quoted string after the directive
+	 */
+	void ParseDirective(const std::string& line, std::string& directive, std::string& argument) {
+		directive.clear();
+		argument.clear();
+		size_t ix = line.find_first_not_of(" \t");
+		if (ix == std::string::npos || line[ix] != '#') {
+			return;
+		}
+		ix = line.find_first_not_of(" \t", ix + 1);
+		size_t end = ix;
+		while (end < line.size() && (isalnum(static_cast<unsigned char>(line[end])) || line[end] == '_')) {
+			end++;
+		}
+		if (ix == std::string::npos) {
+			return;
+		}
+		directive = line.substr(ix, end - ix);
+
+		ix = line.find_first_not_of(" \t", end);
+		if (ix == std::string::npos) {
+			return;
+		}
+		if (line[ix] == '"') {
+			end = line.find('"', ix + 1);
+			argument = line.substr(ix + 1, end == std::string::npos ? std::string::npos : end - ix - 1);
+		} else {
+			end = line.find_first_of(" \t\r\n/", ix);
+			argument = line.substr(ix, end == std::string::npos ? std::string::npos : end - ix);
+		}
+	}
+
+	/*
+	 * Checks whether a source mentions a name as a whole word
+	 */
+	bool ContainsWord(const std::string& source, const std::string& word) {
+		for (size_t ix = source.find(word); ix != std::string::npos; ix = source.find(word, ix + 1)) {
+			const bool startOk = ix == 0 || !(isalnum(static_cast<unsigned char>(source[ix - 1])) || source[ix - 1] == '_');
+			const size_t end = ix + word.size();
+			const bool endOk = end >= source.size() || !(isalnum(static_cast<unsigned char>(source[end])) || source[end] == '_');
+			if (startOk && endOk) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/*
+	 * Loads a source file, pasting in any #include'd files and collecting the features from #pragma variant lines
+	 * @param path     The path of the file to load
+	 * @param included The files that have already been included, each file is only pasted in once
+	 * @param features The list of features to add newly declared features to
+	 * @param result   The string to append the expanded source to
+	 */
+	void ExpandFile(const std::string& path, std::unordered_set<std::string>& included, std::vector<std::string>& features, std::string& result) {
+		MappedFile file(path);
+		if (!file.IsOpen()) {
+			LOG_ERROR("File not found: {}", path);
+			throw std::runtime_error("File not found, see logs for more information");
+		}
+
+		const char* data = file.GetData();
+		const size_t size = file.GetSize();
+		std::string line, directive, argument;
+		for (size_t start = 0; start < size;) {
+			const char* newline = static_cast<const char*>(memchr(data + start, '\n', size - start));
+			const size_t end = newline != nullptr ? newline - data + 1 : size;
+			line.assign(data + start, end - start);
+			start = end;
+
+			ParseDirective(line, directive, argument);
+			if (directive == "include") {
+				const std::string includePath = (std::filesystem::path(path).parent_path() / argument).lexically_normal().generic_string();
+				if (included.insert(includePath).second) {
+					ExpandFile(includePath, included, features, result);
+					if (!result.empty() && result.back() != '\n') {
+						result += '\n';
+					}
+				}
+			}
+			else if (directive == "pragma" && line.find("variant") != std::string::npos) {
+				// The name is the word after "variant"
+				std::string name;
+				const size_t nameStart = line.find_first_not_of(" \t", line.find("variant") + 7);
+				if (nameStart != std::string::npos) {
+					const size_t nameEnd = line.find_first_of(" \t\r\n/", nameStart);
+					name = line.substr(nameStart, nameEnd == std::string::npos ? std::string::npos : nameEnd - nameStart);
+				}
+				if (name.empty()) {
+					LOG_WARN("Ignoring #pragma variant without a name in \"{}\"", path);
+				} else if (std::find(features.begin(), features.end(), name) == features.end()) {
+					if (features.size() < ShaderVariantSet::MAX_FEATURES) {
+						features.push_back(name);
+					} else {
+						LOG_ERROR("Too many shader variant features, ignoring \"{}\" in \"{}\"", name, path);
+					}
+				}
+			}
+			else {
+				result += line;
+			}
+		}
+	}
+}
+
+ShaderVariantSet::ShaderVariantSet(const std::string& vsPath, const std::string& fsPath) {
+	std::unordered_set<std::string> included;
+	ExpandFile(vsPath, included, _features, _vsSource);
+	included.clear();
+	ExpandFile(fsPath, included, _features, _fsSource);
+}
+
+uint32_t ShaderVariantSet::GetFeature(const std::string& name) const {
+	for (size_t ix = 0; ix < _features.size(); ix++) {
+		if (_features[ix] == name) {
+			return 1u << ix;
+		}
+	}
+	LOG_WARN("Shader variant feature \"{}\" is not declared", name);
+	return 0;
+}
+
+std::string ShaderVariantSet::_Resolve(const std::string& source, uint32_t features, uint32_t& referenced) const {
+	struct Block {
+		bool IsFeature;    // True if this block tests one of our features, and we're removing the directives
+		bool ParentActive; // True if the lines around this block are kept
+		bool Condition;    // The result of the test, for feature blocks
+		bool InElse;       // True once we've passed the #else
+	};
+	std::vector<Block> blocks;
+	auto isActive = [&]() {
+		if (blocks.empty()) {
+			return true;
+		}
+		const Block& top = blocks.back();
+		return top.ParentActive && (!top.IsFeature || top.Condition != top.InElse);
+	};
+
+	std::string result;
+	result.reserve(source.size());
+	std::string line, directive, argument;
+	for (size_t start = 0; start < source.size();) {
+		size_t end = source.find('\n', start);
+		end = end == std::string::npos ? source.size() : end + 1;
+		line.assign(source, start, end - start);
+		start = end;
+
+		ParseDirective(line, directive, argument);
+		if (directive == "ifdef" || directive == "ifndef") {
+			auto it = std::find(_features.begin(), _features.end(), argument);
+			if (it != _features.end()) {
+				const bool isSet = (features >> (it - _features.begin())) & 1;
+				blocks.push_back({ true, isActive(), directive == "ifdef" ? isSet : !isSet, false });
+				continue;
+			}
+		}
+		if (directive == "if" || directive == "ifdef" || directive == "ifndef") {
+			const bool active = isActive();
+			blocks.push_back({ false, active, false, false });
+			if (active) {
+				result += line;
+			}
+			continue;
+		}
+		if (!blocks.empty() && blocks.back().IsFeature) {
+			if (directive == "else") {
+				blocks.back().InElse = true;
+				continue;
+			}
+			if (directive == "endif") {
+				blocks.pop_back();
+				continue;
+			}
+			if (directive == "elif") {
+				LOG_ERROR("#elif is not supported on shader variant features, use #else and a nested #ifdef");
+			}
+		}
+		else if (directive == "endif" && !blocks.empty()) {
+			const bool active = blocks.back().ParentActive;
+			blocks.pop_back();
+			if (active) {
+				result += line;
+			}
+			continue;
+		}
+		if (isActive()) {
+			result += line;
+		}
+	}
+
+	// Any features that are still mentioned (ex: #if defined(A) && defined(B)) need to be defined for the compiler
+	referenced = 0;
+	for (size_t ix = 0; ix < _features.size(); ix++) {
+		if (((features >> ix) & 1) && ContainsWord(result, _features[ix])) {
+			referenced |= 1u << ix;
+		}
+	}
+	return result;
+}
+
+bool ShaderVariantSet::_Prepare(uint32_t features, Shader::sptr& result) {
+	auto variant = _variants.find(features);
+	if (variant != _variants.end()) {
+		result = variant->second;
+		return false;
+	}
+
+	uint32_t vsReferenced = 0, fsReferenced = 0;
+	const std::string vsSource = _Resolve(_vsSource, features, vsReferenced);
+	const std::string fsSource = _Resolve(_fsSource, features, fsReferenced);
+	std::string defines;
+	for (size_t ix = 0; ix < _features.size(); ix++) {
+		if (((vsReferenced | fsReferenced) >> ix) & 1) {
+			defines += _features[ix] + "\n";
+		}
+	}
+
+	// Different masks can expand to the same thing (ex: a feature that only one stage uses), so share the program
+	const uint64_t key = ShaderCache::MakeKey(vsSource, fsSource, defines);
+	auto program = _programs.find(key);
+	if (program != _programs.end()) {
+		result = program->second;
+		_variants[features] = result;
+		return false;
+	}
+
+	result = Shader::Create();
+	result->LoadShaderPart(vsSource.c_str(), GL_VERTEX_SHADER);
+	result->LoadShaderPart(fsSource.c_str(), GL_FRAGMENT_SHADER);
+	for (size_t ix = 0; ix < _features.size(); ix++) {
+		if (((vsReferenced | fsReferenced) >> ix) & 1) {
+			result->AddDefine(_features[ix]);
+		}
+	}
+	_programs[key] = result;
+	_variants[features] = result;
+	return true;
+}
+
+Shader::sptr ShaderVariantSet::Get(uint32_t features) {
+	features &= _features.size() < 32 ? (1u << _features.size()) - 1 : ~0u;
+	Shader::sptr result;
+	if (_Prepare(features, result)) {
+		// Nobody asked for this ahead of time, so we have to stall while it compiles
+		LOG_INFO("Compiling shader variant 0x{:x} on first use, consider precompiling it", features);
+		result->Link();
+	}
+	return result;
+}
+
+bool ShaderVariantSet::Precompile(const std::vector<uint32_t>& variants, const std::vector<Shader::sptr>& others) {
+	const uint32_t validMask = _features.size() < 32 ? (1u << _features.size()) - 1 : ~0u;
+	std::vector<Shader::sptr> toLink = others;
+	for (uint32_t features : variants) {
+		Shader::sptr shader;
+		if (_Prepare(features & validMask, shader)) {
+			toLink.push_back(shader);
+		}
+	}
+	return toLink.empty() || Shader::LinkAll(toLink);
+}
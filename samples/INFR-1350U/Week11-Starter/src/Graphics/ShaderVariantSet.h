@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Shader.h"
+
+/// <summary>
+/// Builds shader programs from a vertex and fragment source that can be switched between variants with feature bits.
+/// The sources are run through a small preprocessor first:
+///  - #include "file" pastes in another file, relative to the including file. Each file is only included once
+///  - #pragma variant NAME declares a feature, the first feature declared is bit 0, the next bit 1 and so on
+///
+/// Blocks wrapped in #ifdef NAME / #ifndef NAME (with an optional #else) are resolved before compiling, so variants
+/// that end up with identical sources share a single program. Features that are still referenced afterwards (ex: by
+/// #if defined(NAME)) are passed to the compiler as defines. #elif is not supported on feature names
+///
+/// Variants are compiled the first time they are requested, or ahead of time with Precompile
+/// </summary>
+class ShaderVariantSet final
+{
+public:
+	typedef std::shared_ptr<ShaderVariantSet> sptr;
+	static inline sptr Create(const std::string& vsPath, const std::string& fsPath) {
+		return std::make_shared<ShaderVariantSet>(vsPath, fsPath);
+	}
+
+	/// <summary>
+	/// The most features that can be declared across both stages
+	/// </summary>
+	static constexpr int MAX_FEATURES = 32;
+
+public:
+	// We'll disallow moving and copying, since the shaders we hand out are shared
+	ShaderVariantSet(const ShaderVariantSet& other) = delete;
+	ShaderVariantSet(ShaderVariantSet&& other) = delete;
+	ShaderVariantSet& operator=(const ShaderVariantSet& other) = delete;
+	ShaderVariantSet& operator=(ShaderVariantSet&& other) = delete;
+
+	/// <summary>
+	/// Loads and preprocesses the sources for a variant set, nothing is compiled until a variant is requested
+	/// </summary>
+	/// <param name="vsPath">The path to the vertex shader source (in res)</param>
+	/// <param name="fsPath">The path to the fragment shader source (in res)</param>
+	ShaderVariantSet(const std::string& vsPath, const std::string& fsPath);
+	~ShaderVariantSet() = default;
+
+	/// <summary>
+	/// Gets the bit for a feature declared with #pragma variant, or 0 if the sources do not declare it
+	/// </summary>
+	/// <param name="name">The name of the feature (ex: REFLECTIVE)</param>
+	uint32_t GetFeature(const std::string& name) const;
+	/// <summary>
+	/// Gets the names of all the declared features, in bit order
+	/// </summary>
+	const std::vector<std::string>& GetFeatureNames() const { return _features; }
+
+	/// <summary>
+	/// Gets the program for a combination of features, compiling it if this is the first time it was requested
+	/// </summary>
+	/// <param name="features">The feature bits to enable, bits for undeclared features are ignored</param>
+	Shader::sptr Get(uint32_t features);
+	/// <summary>
+	/// Compiles all of the given variants that have not been compiled yet, in parallel where the driver allows it
+	/// </summary>
+	/// <param name="variants">The feature masks of each variant to compile</param>
+	/// <param name="others">Other shaders to link in the same batch (ex: ones that aren't part of a variant set), all of their stages should already be loaded</param>
+	/// <returns>True if every new program linked, false if otherwise</returns>
+	bool Precompile(const std::vector<uint32_t>& variants, const std::vector<Shader::sptr>& others = {});
+
+	/// <summary>
+	/// Gets the number of distinct programs that have been built, which may be less than the number of variants
+	/// requested if some of them expanded to the same source
+	/// </summary>
+	size_t GetProgramCount() const { return _programs.size(); }
+
+private:
+	// The sources after includes are expanded and variant pragmas are removed
+	std::string _vsSource;
+	std::string _fsSource;
+	std::vector<std::string> _features;
+
+	// Programs by feature mask, and by a key of their expanded sources so identical variants are shared
+	std::unordered_map<uint32_t, Shader::sptr> _variants;
+	std::unordered_map<uint64_t, Shader::sptr> _programs;
+
+	/// <summary>
+	/// Finds or creates the program for a feature mask, without linking it. Returns true if the program is new
+	/// </summary>
+	bool _Prepare(uint32_t features, Shader::sptr& result);
+	/// <summary>
+	/// Resolves the feature #ifdef blocks in a source for the given mask, and records which enabled features are
+	/// still referenced so that they can be defined
+	/// </summary>
+	std::string _Resolve(const std::string& source, uint32_t features, uint32_t& referenced) const;
+};
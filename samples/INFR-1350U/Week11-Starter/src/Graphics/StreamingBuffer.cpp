@@ -0,0 +1,91 @@
+#include "StreamingBuffer.h"
+
+#include <algorithm>
+
+#include "GLState.h"
+#include "Logging.h"
+
+StreamingBuffer::StreamingBuffer(GLenum type, size_t frameCapacity) :
+	_type(type),
+	_handle(0),
+	_mapping(nullptr),
+	_frameCapacity(0),
+	_frameIndex(0)
+{
+	for (int ix = 0; ix < FRAMES_IN_FLIGHT; ix++) {
+		_fences[ix] = nullptr;
+	}
+	_Allocate(frameCapacity);
+}
+
+StreamingBuffer::~StreamingBuffer() {
+	_Release();
+}
+
+void* StreamingBuffer::BeginFrame(size_t size) {
+	_frameIndex = (_frameIndex + 1) % FRAMES_IN_FLIGHT;
+
+	if (size > _frameCapacity) {
+		// The old buffer is going away, so we need to wait for the GPU to be done with all of it
+		_Release();
+		_Allocate(std::max(size, _frameCapacity * 2));
+	}
+
+	// The GPU may still be reading what we wrote here FRAMES_IN_FLIGHT frames ago
+	_WaitForFrame(_frameIndex);
+	return _mapping + _frameIndex * _frameCapacity;
+}
+
+void StreamingBuffer::EndFrame() {
+	_fences[_frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamingBuffer::BindFrame(GLuint index) const {
+	GLState::BindBufferRange(_type, index, _handle, _frameIndex * _frameCapacity, _frameCapacity);
+}
+
+void StreamingBuffer::_WaitForFrame(int frameIndex) {
+	GLsync& fence = _fences[frameIndex];
+	if (fence == nullptr) {
+		return;
+	}
+	// We flush on the wait so that the fence is guaranteed to actually reach the GPU and get signalled
+	GLenum result;
+	do {
+		result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	} while (result == GL_TIMEOUT_EXPIRED);
+	if (result == GL_WAIT_FAILED) {
+		LOG_ERROR("Failed to wait on streaming buffer fence, the buffer may be overwritten while in use");
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void StreamingBuffer::_Allocate(size_t frameCapacity) {
+	// Each frame's region has to start on an offset we're allowed to bind at
+	GLint alignment = 0;
+	glGetIntegerv(_type == GL_UNIFORM_BUFFER ? GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT : GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	alignment = std::max(alignment, 256);
+	_frameCapacity = (std::max<size_t>(frameCapacity, 1) + alignment - 1) / alignment * alignment;
+
+	// A persistent, coherent mapping means we can keep writing through the same pointer, and the GPU will see our
+	// writes for any commands issued after them without us having to flush or unmap
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &_handle);
+	glNamedBufferStorage(_handle, _frameCapacity * FRAMES_IN_FLIGHT, nullptr, flags);
+	_mapping = static_cast<char*>(glMapNamedBufferRange(_handle, 0, _frameCapacity * FRAMES_IN_FLIGHT, flags));
+	LOG_ASSERT(_mapping != nullptr, "Failed to map streaming buffer");
+}
+
+void StreamingBuffer::_Release() {
+	for (int ix = 0; ix < FRAMES_IN_FLIGHT; ix++) {
+		_WaitForFrame(ix);
+	}
+	if (_handle != 0) {
+		glUnmapNamedBuffer(_handle);
+		GLState::OnBufferDeleted(_handle);
+		glDeleteBuffers(1, &_handle);
+		_handle = 0;
+		_mapping = nullptr;
+	}
+}
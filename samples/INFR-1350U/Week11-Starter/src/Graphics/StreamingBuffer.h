@@ -0,0 +1,99 @@
+#pragma once
+#include <glad/glad.h>
+#include <memory>
+
+/// <summary>
+/// A buffer that the CPU writes new data into every frame (ex: per-object matrices), without stalling the GPU.
+/// The buffer is split into one region per frame in flight, and stays mapped for its entire lifetime. Each frame
+/// writes into the next region, waiting on a fence first if the GPU may still be reading it
+/// </summary>
+class StreamingBuffer final
+{
+public:
+	typedef std::shared_ptr<StreamingBuffer> sptr;
+	static inline sptr Create(GLenum type, size_t frameCapacity) {
+		return std::make_shared<StreamingBuffer>(type, frameCapacity);
+	}
+
+	/// <summary>
+	/// The number of frames that we allow the CPU to get ahead of the GPU by
+	/// </summary>
+	static constexpr int FRAMES_IN_FLIGHT = 3;
+
+public:
+	// We'll disallow moving and copying, since we want to manually control when the destructor is called
+	// We'll use these classes via pointers
+	StreamingBuffer(const StreamingBuffer& other) = delete;
+	StreamingBuffer(StreamingBuffer&& other) = delete;
+	StreamingBuffer& operator=(const StreamingBuffer& other) = delete;
+	StreamingBuffer& operator=(StreamingBuffer&& other) = delete;
+
+	/// <summary>
+	/// Creates a new streaming buffer
+	/// </summary>
+	/// <param name="type">The type of buffer (ex: GL_SHADER_STORAGE_BUFFER, GL_UNIFORM_BUFFER)</param>
+	/// <param name="frameCapacity">The initial number of bytes that can be written each frame</param>
+	StreamingBuffer(GLenum type, size_t frameCapacity);
+	~StreamingBuffer();
+
+	/// <summary>
+	/// Moves on to the next frame's region of the buffer, waiting for the GPU to finish with it if needed. The
+	/// region will be large enough to hold the given number of bytes, growing the buffer if it has to
+	/// </summary>
+	/// <param name="size">The number of bytes that will be written this frame</param>
+	/// <returns>A pointer to the start of this frame's region, valid until EndFrame is called</returns>
+	void* BeginFrame(size_t size);
+	/// <summary>
+	/// Moves on to the next frame's region of the buffer, with room for count elements of type T
+	/// </summary>
+	template <typename T>
+	T* BeginFrame(size_t count) {
+		return static_cast<T*>(BeginFrame(sizeof(T) * count));
+	}
+	/// <summary>
+	/// Marks the end of the commands that read from this frame's region, so we know when it's safe to re-use.
+	/// Should be called after the last draw call that uses this frame's data
+	/// </summary>
+	void EndFrame();
+
+	/// <summary>
+	/// Binds this frame's region to an indexed binding point (ex: layout(binding = 0) in a shader)
+	/// </summary>
+	/// <param name="index">The binding index to bind to</param>
+	void BindFrame(GLuint index) const;
+
+	/// <summary>
+	/// Gets the number of bytes that can be written each frame without growing the buffer
+	/// </summary>
+	size_t GetFrameCapacity() const { return _frameCapacity; }
+	/// <summary>
+	/// Gets the byte offset of this frame's region from the start of the buffer (ex: for pixel unpack buffer offsets)
+	/// </summary>
+	size_t GetFrameOffset() const { return _frameIndex * _frameCapacity; }
+	/// <summary>
+	/// Returns the type of buffer (ex GL_SHADER_STORAGE_BUFFER)
+	/// </summary>
+	GLenum GetType() const { return _type; }
+	/// <summary>
+	/// Returns the underlying OpenGL handle that this class is wrapping around
+	/// </summary>
+	GLuint GetHandle() const { return _handle; }
+
+private:
+	GLenum _type;
+	GLuint _handle;
+	char*  _mapping;
+	size_t _frameCapacity;
+	int    _frameIndex;
+	GLsync _fences[FRAMES_IN_FLIGHT];
+
+	/// <summary>
+	/// Blocks until the GPU has finished with the given frame's region
+	/// </summary>
+	void _WaitForFrame(int frameIndex);
+	/// <summary>
+	/// (Re)creates the underlying buffer so that each frame can hold at least frameCapacity bytes
+	/// </summary>
+	void _Allocate(size_t frameCapacity);
+	void _Release();
+};
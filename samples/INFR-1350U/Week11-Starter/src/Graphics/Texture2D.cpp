@@ -1,14 +1,41 @@
 #include "Texture2D.h"
 
+#include <algorithm>
+#include <filesystem>
+
+#include "GLState.h"
+
+namespace {
+	/*
+	 * Gets how many bytes a texel of an uncompressed internal format takes up in video memory. Drivers pad 3 component
+	 * formats out to 4, so we count them that way
+	 */
+	size_t GetInternalTexelSize(InternalFormat format) {
+		switch (format) {
+			case InternalFormat::R8:
+				return 1;
+			case InternalFormat::R16:
+			case InternalFormat::RG8:
+				return 2;
+			case InternalFormat::RGB16:
+			case InternalFormat::RGBA16:
+				return 8;
+			default:
+				return 4;
+		}
+	}
+}
+
 Texture2D::Texture2D(const Texture2DDescription& description) :
-	ITexture(), _description(description)
+	ITexture(), _description(description), _levelCount(0)
 {
 
 	_RecreateTexture();
 }
 
-void Texture2D::_RecreateTexture() {
+void Texture2D::_RecreateTexture(uint32_t levelCount) {
 	if (_handle != 0) {
+		GLState::OnTextureDeleted(_handle);
 		glDeleteTextures(1, &_handle);
 		_handle = 0;
 	}
@@ -19,9 +46,16 @@ void Texture2D::_RecreateTexture() {
 		_description.MaxAnisotropic = ITexture::GetLimits().MAX_ANISOTROPY;
 	}
 
+	if (levelCount == 0) {
+		levelCount = _description.GenerateMipMaps ? CompressedTextureData::GetFullMipCount(_description.Width, _description.Height) : 1;
+	}
+	_levelCount = 0;
+
 	if (_description.Width * _description.Height > 0 && _description.Format != InternalFormat::Unknown)
 	{
-		glTextureStorage2D(_handle, 1, *_description.Format, _description.Width, _description.Height);
+		// We need to allocate every mip level up front, otherwise glGenerateTextureMipmap has nowhere to put them
+		_levelCount = levelCount;
+		glTextureStorage2D(_handle, _levelCount, *_description.Format, _description.Width, _description.Height);
 
 		glTextureParameteri(_handle, GL_TEXTURE_WRAP_S, (GLenum)_description.HorizontalWrap);
 		glTextureParameteri(_handle, GL_TEXTURE_WRAP_T, (GLenum)_description.VerticalWrap);
@@ -63,7 +97,50 @@ void Texture2D::LoadData(const Texture2DData::sptr& data) {
 	}
 }
 
+void Texture2D::LoadCompressedData(const CompressedTextureData::sptr& data) {
+	_description.Width = data->GetWidth();
+	_description.Height = data->GetHeight();
+	_description.Format = data->GetFormat();
+	_description.GenerateMipMaps = false;
+	_RecreateTexture(data->GetLevelCount());
+
+	if (!data->DebugName.empty()) {
+		glObjectLabel(GL_TEXTURE, _handle, data->DebugName.length(), data->DebugName.c_str());
+	}
+
+	// The blocks go straight to the GPU, there's nothing to decode
+	for (uint32_t level = 0; level < data->GetLevelCount(); level++) {
+		const CompressedTextureData::MipLevel& mip = data->GetLevel(level);
+		glCompressedTextureSubImage2D(_handle, level, 0, 0, mip.Width, mip.Height, *data->GetFormat(), (GLsizei)mip.Size, data->GetLevelData(level));
+	}
+}
+
+size_t Texture2D::GetMemoryUsage() const {
+	size_t result = 0;
+	for (uint32_t level = 0; level < _levelCount; level++) {
+		const uint32_t width = std::max(_description.Width >> level, 1u);
+		const uint32_t height = std::max(_description.Height >> level, 1u);
+		result += IsCompressedFormat(_description.Format) ?
+			GetCompressedImageSize(_description.Format, width, height) :
+			width * (size_t)height * GetInternalTexelSize(_description.Format);
+	}
+	return result;
+}
+
+void Texture2D::UpdateRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height, PixelFormat format, PixelType type, const void* pixels) {
+	LOG_ASSERT(x + width <= _description.Width && y + height <= _description.Height, "Region is outside of the texture!");
+	glTextureSubImage2D(_handle, 0, x, y, width, height, *format, *type, pixels);
+}
+
 Texture2D::sptr Texture2D::LoadFromFile(const std::string& path) {
+	if (std::filesystem::path(path).extension() == ".ktx2") {
+		CompressedTextureData::sptr data = CompressedTextureData::LoadFromKtx2(path);
+		LOG_ASSERT(data != nullptr, "Failed to load image from file!");
+		Texture2D::sptr result = Texture2D::Create();
+		result->LoadCompressedData(data);
+		return result;
+	}
+
 	Texture2DData::sptr data = Texture2DData::LoadFromFile(path);
 	LOG_ASSERT(data != nullptr, "Failed to load image from file!");
 	Texture2D::sptr result = Texture2D::Create();
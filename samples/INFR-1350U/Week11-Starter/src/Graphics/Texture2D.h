@@ -7,6 +7,7 @@
 #include "ITexture.h"
 #include "TextureEnums.h"
 #include "Texture2DData.h"
+#include "CompressedTextureData.h"
 
 struct Texture2DDescription
 {
@@ -64,9 +65,27 @@ public:
 	/// </summary>
 	/// <param name="data">The texture data to upload into this texture</param>
 	void LoadData(const Texture2DData::sptr& data);
+	/// <summary>
+	/// Uploads block compressed data to this texture, along with all of it's mip levels. The texture is recreated to
+	/// match the data's size and format, and no mip maps are generated (compressed data has to come with its own)
+	/// </summary>
+	/// <param name="data">The compressed data to upload into this texture</param>
+	void LoadCompressedData(const CompressedTextureData::sptr& data);
+	/// <summary>
+	/// Uploads a block of pixels into part of this texture, without resizing it. If a GL_PIXEL_UNPACK_BUFFER is bound,
+	/// pixels is instead a byte offset into that buffer
+	/// </summary>
+	/// <param name="x">The left edge of the block to update, in pixels</param>
+	/// <param name="y">The bottom edge of the block to update, in pixels</param>
+	/// <param name="width">The width of the block, in pixels</param>
+	/// <param name="height">The height of the block, in pixels</param>
+	/// <param name="format">The layout of the pixels (ex: RGBA)</param>
+	/// <param name="type">The component type of the pixels (ex: uint8_t)</param>
+	/// <param name="pixels">The pixels to upload, or an offset into the bound pixel unpack buffer</param>
+	void UpdateRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height, PixelFormat format, PixelType type, const void* pixels);
 
 	/// <summary>
-	/// Loads an image directly from a file
+	/// Loads an image directly from a file. KTX2 files (see BlockCompressor) are uploaded as is, with their mip levels
 	/// </summary>
 	/// <param name="path">The path to load the image from</param>
 	/// <returns>A pointer to the loaded image</returns>
@@ -75,6 +94,11 @@ public:
 	uint32_t GetWidth() const { return _description.Width; }
 	uint32_t GetHeight() const { return _description.Height; }
 	InternalFormat GetFormat() const { return _description.Format; }	
+	uint32_t GetMipLevelCount() const { return _levelCount; }
+	/// <summary>
+	/// Estimates how much video memory this texture uses across all of it's mip levels, in bytes
+	/// </summary>
+	size_t GetMemoryUsage() const;
 	MinFilter GetMinFilter() const { return _description.MinificationFilter; }
 	MagFilter GetMagFilter() const { return _description.MagnificationFilter; }
 	WrapMode GetWrapS() const { return _description.HorizontalWrap; }
@@ -90,6 +114,11 @@ public:
 	
 private:
 	Texture2DDescription _description;
+	uint32_t             _levelCount;
 
-	void _RecreateTexture();
+	/// <summary>
+	/// Recreates the texture from the description
+	/// </summary>
+	/// <param name="levelCount">The number of mip levels to allocate, or 0 for a full chain if GenerateMipMaps is set and 1 otherwise</param>
+	void _RecreateTexture(uint32_t levelCount = 0);
 };
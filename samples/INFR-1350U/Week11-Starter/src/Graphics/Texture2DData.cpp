@@ -4,9 +4,9 @@
 #include <stb_image.h>
 
 Texture2DData::Texture2DData(uint32_t width, uint32_t height, PixelFormat format, PixelType type, void* sourceData, InternalFormat recommendedFormat) :
-	_width(width), _height(height), _format(format), _type(type), _data(nullptr), _recommendedFormat(recommendedFormat)
+	_width(width), _height(height), _format(format), _type(type), _recommendedFormat(recommendedFormat), _data(nullptr), _deleter(free)
 {
-	LOG_ASSERT(width > 0 & height > 0, "Width and height must both be greater than zero! Got {}x{}", width, height);
+	LOG_ASSERT(width > 0 && height > 0, "Width and height must both be greater than zero! Got {}x{}", width, height);
 	_dataSize = width * (size_t)height * GetTexelSize(_format, _type);
 	_data = malloc(_dataSize);
 	LOG_ASSERT(_data != nullptr, "Failed to allocate texture data!");
@@ -15,8 +15,17 @@ Texture2DData::Texture2DData(uint32_t width, uint32_t height, PixelFormat format
 	}
 }
 
+Texture2DData::Texture2DData(uint32_t width, uint32_t height, PixelFormat format, PixelType type, void* data, Deleter deleter, InternalFormat recommendedFormat) :
+	_width(width), _height(height), _format(format), _type(type), _recommendedFormat(recommendedFormat), _data(data), _deleter(deleter)
+{
+	LOG_ASSERT(width > 0 && height > 0, "Width and height must both be greater than zero! Got {}x{}", width, height);
+	LOG_ASSERT(_data != nullptr, "Cannot take ownership of null texture data!");
+	LOG_ASSERT(_deleter != nullptr, "A deleter must be provided when taking ownership of texture data!");
+	_dataSize = width * (size_t)height * GetTexelSize(_format, _type);
+}
+
 Texture2DData::~Texture2DData() {
-	free(_data);
+	_deleter(_data);
 }
 
 Texture2DData::sptr Texture2DData::LoadFromFile(const std::string& file, bool forceRgba)
@@ -71,13 +80,10 @@ Texture2DData::sptr Texture2DData::LoadFromFile(const std::string& file, bool fo
 		LOG_WARN("The alignment of a horizontal line is not a multiple of 4, this will require a call to glPixelStorei(GL_PACK_ALIGNMENT)");
 	}
 
-	// Create the result and store our image data in it
+	// Create the result and hand STBI's buffer over to it, it will be freed with stbi_image_free when the result is destroyed
 	// Note that stbi will always give us an array of unsigned bytes (uint8_t)
-	Texture2DData::sptr result = std::make_shared<Texture2DData>(width, height, image_format, PixelType::UByte, data, internal_format);
+	Texture2DData::sptr result = std::make_shared<Texture2DData>(width, height, image_format, PixelType::UByte, data, stbi_image_free, internal_format);
 	result->DebugName = std::filesystem::path(file).filename().string();
-	
-	// We now have a copy in our ptr, we can free STBI's copy of it
-	stbi_image_free(data);
 
 	return result;
 }
@@ -15,6 +15,10 @@ public:
 	Texture2DData& operator=(const Texture2DData& other) = delete;
 	Texture2DData& operator=(Texture2DData&& other) = delete;
 	typedef std::shared_ptr<Texture2DData> sptr;
+	/// <summary>
+	/// A function that frees a block of pixels that a Texture2DData has taken ownership of (ex: free or stbi_image_free)
+	/// </summary>
+	typedef void (*Deleter)(void* data);
 
 	std::string DebugName;
 
@@ -28,6 +32,18 @@ public:
 	/// <param name="sourceData">A pointer to the data to upload to this texture</param>
 	/// <param name="recommendedFormat">The recommended internal format to use when creating textures from this data</param>
 	Texture2DData(uint32_t width, uint32_t height, PixelFormat format, PixelType type, void* sourceData, InternalFormat recommendedFormat = InternalFormat::Unknown);
+	/// <summary>
+	/// Creates a new 2D texture data object that takes ownership of an existing block of pixels instead of copying it,
+	/// ex: the buffer returned by stbi_load. The data must be tightly packed, and must not be freed by the caller
+	/// </summary>
+	/// <param name="width">The width of the texture, in pixels</param>
+	/// <param name="height">The height of the texture, in pixels</param>
+	/// <param name="format">The pixel format or layout of a pixel (ex: RGBA)</param>
+	/// <param name="type">The component type of the pixel (ex: uint8_t)</param>
+	/// <param name="data">The pixels to take ownership of, must not be null</param>
+	/// <param name="deleter">The function to free the data with when this object is destroyed</param>
+	/// <param name="recommendedFormat">The recommended internal format to use when creating textures from this data</param>
+	Texture2DData(uint32_t width, uint32_t height, PixelFormat format, PixelType type, void* data, Deleter deleter, InternalFormat recommendedFormat = InternalFormat::Unknown);
 	~Texture2DData();
 
 	/// <summary>
@@ -75,4 +91,5 @@ private:
 	PixelType   _type;
 	InternalFormat _recommendedFormat;
 	void* _data;
+	Deleter _deleter;
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "TextureCubeMap.h"
+#include "GLState.h"
 
 TextureCubeMap::TextureCubeMap(const TextureCubeDesc& description) :
 	ITexture(), _description(description)
@@ -9,6 +10,7 @@ TextureCubeMap::TextureCubeMap(const TextureCubeDesc& description) :
 
 void TextureCubeMap::_RecreateTexture() {
 	if (_handle != 0) {
+		GLState::OnTextureDeleted(_handle);
 		glDeleteTextures(1, &_handle);
 		_handle = 0;
 	}
@@ -56,6 +58,12 @@ void TextureCubeMap::LoadData(const TextureCubeMapData::sptr& data) {
 	}
 }
 
+void TextureCubeMap::UpdateFaceRegion(CubeMapFace face, uint32_t x, uint32_t y, uint32_t width, uint32_t height, PixelFormat format, PixelType type, const void* pixels) {
+	LOG_ASSERT(x + width <= _description.Size && y + height <= _description.Size, "Region is outside of the texture!");
+	// With DSA, the faces of a cube map are treated as the layers of an array texture
+	glTextureSubImage3D(_handle, 0, x, y, *face, width, height, 1, *format, *type, pixels);
+}
+
 TextureCubeMap::sptr TextureCubeMap::LoadFromImages(const std::string& path)
 {
 	TextureCubeMapData::sptr data = TextureCubeMapData::LoadFromImages(path);
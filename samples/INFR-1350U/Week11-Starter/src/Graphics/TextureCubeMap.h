@@ -49,6 +49,19 @@ public:
 	/// </summary>
 	/// <param name="data">The texture data to upload into this texture</param>
 	void LoadData(const TextureCubeMapData::sptr& data);
+	/// <summary>
+	/// Uploads a block of pixels into part of one face of this texture, without resizing it. If a
+	/// GL_PIXEL_UNPACK_BUFFER is bound, pixels is instead a byte offset into that buffer
+	/// </summary>
+	/// <param name="face">The face to update</param>
+	/// <param name="x">The left edge of the block to update, in pixels</param>
+	/// <param name="y">The bottom edge of the block to update, in pixels</param>
+	/// <param name="width">The width of the block, in pixels</param>
+	/// <param name="height">The height of the block, in pixels</param>
+	/// <param name="format">The layout of the pixels (ex: RGBA)</param>
+	/// <param name="type">The component type of the pixels (ex: uint8_t)</param>
+	/// <param name="pixels">The pixels to upload, or an offset into the bound pixel unpack buffer</param>
+	void UpdateFaceRegion(CubeMapFace face, uint32_t x, uint32_t y, uint32_t width, uint32_t height, PixelFormat format, PixelType type, const void* pixels);
 
 	static TextureCubeMap::sptr LoadFromImages(const std::string& path);
 
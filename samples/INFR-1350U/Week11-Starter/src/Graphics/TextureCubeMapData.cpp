@@ -1,8 +1,11 @@
 #include "TextureCubeMapData.h"
 #include <filesystem>
+#include <stb_image.h>
+
+#include "Utilities/ThreadPool.h"
 
 TextureCubeMapData::TextureCubeMapData(uint32_t size, PixelFormat format, PixelType type, void* sourceData, InternalFormat recommendedFormat) :
-	_size(size), _format(format), _type(type), _data(nullptr), _recommendedFormat(recommendedFormat) {
+	_size(size), _format(format), _type(type), _recommendedFormat(recommendedFormat), _data(nullptr), _deleter(free) {
 	LOG_ASSERT(size > 0, "Size must be greater than zero! Got {}", size)
 	_faceDataSize = (size_t)_size * _size * GetTexelSize(_format, _type);
 	_dataSize = _faceDataSize * 6;
@@ -13,8 +16,17 @@ TextureCubeMapData::TextureCubeMapData(uint32_t size, PixelFormat format, PixelT
 	}
 }
 
+TextureCubeMapData::TextureCubeMapData(uint32_t size, PixelFormat format, PixelType type, void* data, Deleter deleter, InternalFormat recommendedFormat) :
+	_size(size), _format(format), _type(type), _recommendedFormat(recommendedFormat), _data(data), _deleter(deleter) {
+	LOG_ASSERT(size > 0, "Size must be greater than zero! Got {}", size)
+	LOG_ASSERT(_data != nullptr, "Cannot take ownership of null texture data!")
+	LOG_ASSERT(_deleter != nullptr, "A deleter must be provided when taking ownership of texture data!")
+	_faceDataSize = (size_t)_size * _size * GetTexelSize(_format, _type);
+	_dataSize = _faceDataSize * 6;
+}
+
 TextureCubeMapData::~TextureCubeMapData() {
-	free(_data);
+	_deleter(_data);
 }
 
 TextureCubeMapData::sptr TextureCubeMapData::CreateFromImages(const std::vector<Texture2DData::sptr>& images)
@@ -36,7 +48,7 @@ TextureCubeMapData::sptr TextureCubeMapData::CreateFromImages(const std::vector<
 	return result;
 }
 
-TextureCubeMapData::sptr TextureCubeMapData::LoadFromImages(const std::string& rootImagePath) {
+std::vector<std::string> TextureCubeMapData::GetFaceImagePaths(const std::string& rootImagePath) {
 	namespace fs = std::filesystem;
 	fs::path imagePath = fs::path(rootImagePath);
 	fs::path directory = imagePath.parent_path();
@@ -52,22 +64,100 @@ TextureCubeMapData::sptr TextureCubeMapData::LoadFromImages(const std::string& r
 		"_neg_z"
 	};
 
-	std::vector<Texture2DData::sptr> data;
-	data.resize(6);
+	std::vector<std::string> result;
+	result.resize(6);
+	for (int ix = 0; ix < 6; ix++) {
+		fs::path facePath = rootFile;
+		facePath += PATHS[ix];
+		facePath += extension;
+		result[ix] = facePath.string();
+	}
+	return result;
+}
 
-	for(int ix = 0; ix < 6; ix++) {
-		fs::path imagePath = rootFile;
-		imagePath += PATHS[ix];
-		imagePath += extension;
-		if (fs::exists(imagePath)) {
-			data[ix] = Texture2DData::LoadFromFile(imagePath.string());
-		}
-		else {
-			LOG_WARN("Image \"{}\" could not be found!", imagePath.string());
+TextureCubeMapData::sptr TextureCubeMapData::LoadFromImages(const std::string& rootImagePath) {
+	namespace fs = std::filesystem;
+	const std::vector<std::string> paths = GetFaceImagePaths(rootImagePath);
+
+	// Read the size and layout of the cubemap from the header of the first face we can find, so that we can allocate
+	// the final buffer before decoding anything
+	int size = 0, height = 0, channels = 0;
+	int headerFace = -1;
+	for (int ix = 0; ix < 6 && headerFace < 0; ix++) {
+		if (fs::exists(paths[ix]) && stbi_info(paths[ix].c_str(), &size, &height, &channels)) {
+			headerFace = ix;
 		}
 	}
+	if (headerFace < 0) {
+		LOG_WARN("None of the images for cubemap \"{}\" could be read!", rootImagePath);
+		return nullptr;
+	}
+	if (size != height) {
+		LOG_WARN("Cube map face \"{}\" is not square! ({}x{})", paths[headerFace], size, height);
+		return nullptr;
+	}
+
+	// Same formats that Texture2DData::LoadFromFile would pick
+	PixelFormat    format;
+	InternalFormat internal_format;
+	switch (channels) {
+	case 1:
+		internal_format = InternalFormat::R8;
+		format = PixelFormat::Red;
+		break;
+	case 2:
+		internal_format = InternalFormat::RG8;
+		format = PixelFormat::RG;
+		break;
+	case 3:
+		internal_format = InternalFormat::RGB8;
+		format = PixelFormat::RGB;
+		break;
+	case 4:
+		internal_format = InternalFormat::RGBA8;
+		format = PixelFormat::RGBA;
+		break;
+	default:
+		LOG_WARN("Unsupported texture format for cubemap \"{}\" with {} channels", rootImagePath, channels);
+		return nullptr;
+	}
+
+	const size_t faceDataSize = (size_t)size * size * channels;
+	uint8_t* data = static_cast<uint8_t*>(malloc(faceDataSize * 6));
+	LOG_ASSERT(data != nullptr, "Failed to allocate texture data!");
 
-	return CreateFromImages(data);
+	// This is global in STBI, so it has to be set before any of the faces start decoding
+	stbi_set_flip_vertically_on_load(true);
+
+	// STBI always allocates it's own buffer, so each face gets copied into it's slot exactly once and then freed right away.
+	// That way we only ever hold the final buffer plus one decoded face per thread, instead of every face twice
+	ThreadPool::Instance().ParallelFor(6, [&](size_t ix) {
+		uint8_t* slot = data + faceDataSize * ix;
+		if (!fs::exists(paths[ix])) {
+			LOG_WARN("Image \"{}\" could not be found!", paths[ix]);
+			memset(slot, 0, faceDataSize);
+			return;
+		}
+
+		// We ask for the channel count of the first face, so every face ends up with the same layout
+		int width = 0, faceHeight = 0, faceChannels = 0;
+		uint8_t* pixels = stbi_load(paths[ix].c_str(), &width, &faceHeight, &faceChannels, channels);
+		if (pixels == nullptr) {
+			LOG_WARN("STBI Failed to load image from \"{}\"", paths[ix]);
+			memset(slot, 0, faceDataSize);
+		} else if (width != size || faceHeight != size) {
+			LOG_WARN("Image \"{}\" is {}x{}, expected {}x{}", paths[ix], width, faceHeight, size, size);
+			memset(slot, 0, faceDataSize);
+			stbi_image_free(pixels);
+		} else {
+			memcpy(slot, pixels, faceDataSize);
+			stbi_image_free(pixels);
+		}
+	});
+
+	TextureCubeMapData::sptr result = std::make_shared<TextureCubeMapData>(size, format, PixelType::UByte, data, free, internal_format);
+	result->DebugName = fs::path(rootImagePath).filename().string();
+	return result;
 }
 
 void TextureCubeMapData::LoadFaceData(const Texture2DData::sptr& data, CubeMapFace face) {
@@ -34,6 +34,10 @@ public:
 	TextureCubeMapData& operator=(const TextureCubeMapData& other) = delete;
 	TextureCubeMapData& operator=(TextureCubeMapData&& other) = delete;
 	typedef std::shared_ptr<TextureCubeMapData> sptr;
+	/// <summary>
+	/// A function that frees a block of pixels that a TextureCubeMapData has taken ownership of (ex: free or stbi_image_free)
+	/// </summary>
+	typedef void (*Deleter)(void* data);
 
 	std::string DebugName;
 
@@ -47,6 +51,17 @@ public:
 	/// <param name="sourceData">A pointer to the data to upload to this texture</param>
 	/// <param name="recommendedFormat">The recommended internal format to use when creating textures from this data</param>
 	TextureCubeMapData(uint32_t size, PixelFormat format, PixelType type, void* sourceData, InternalFormat recommendedFormat = InternalFormat::Unknown);
+	/// <summary>
+	/// Creates a new cubemap data object that takes ownership of an existing block of pixels instead of copying it. The
+	/// data must hold all 6 faces tightly packed one after another, in the order of CubeMapFace
+	/// </summary>
+	/// <param name="size">The width and height of each face, in pixels</param>
+	/// <param name="format">The pixel format or layout of a pixel (ex: RGBA)</param>
+	/// <param name="type">The component type of the pixel (ex: uint8_t)</param>
+	/// <param name="data">The pixels to take ownership of, must not be null</param>
+	/// <param name="deleter">The function to free the data with when this object is destroyed</param>
+	/// <param name="recommendedFormat">The recommended internal format to use when creating textures from this data</param>
+	TextureCubeMapData(uint32_t size, PixelFormat format, PixelType type, void* data, Deleter deleter, InternalFormat recommendedFormat = InternalFormat::Unknown);
 	~TextureCubeMapData();
 
 	/// <summary>
@@ -65,11 +80,21 @@ public:
 	/// image_pos_y.png --> CubeMapFace::PosY
 	/// image_neg_z.png --> CubeMapFace::NegZ
 	/// image_pos_z.png --> CubeMapFace::PosZ
+	///
+	/// The faces are decoded in parallel on the thread pool, and each one is copied straight into its slot of the
+	/// cubemap's data as soon as it is decoded
 	/// </summary>
 	/// <param name="rootImagePath">The base path for images, including extension. This file name will be appended with _pos_x, _neg_x, etc...</param>
-	/// <returns>A pointer to the data created from the images</returns>
+	/// <returns>A pointer to the data created from the images, or nullptr if none of the images could be read</returns>
 	static TextureCubeMapData::sptr LoadFromImages(const std::string& rootImagePath);
 
+	/// <summary>
+	/// Gets the paths of the 6 images that make up a cube map, see LoadFromImages for the naming scheme
+	/// </summary>
+	/// <param name="rootImagePath">The base path for images, including extension</param>
+	/// <returns>The path for each face, in the order of CubeMapFace</returns>
+	static std::vector<std::string> GetFaceImagePaths(const std::string& rootImagePath);
+
 	/// <summary>
 	/// Loads 2D image data into this cubemap data for the given face. Dimensions and format must match the existing size and formats
 	/// </summary>
@@ -123,4 +148,5 @@ private:
 	PixelType   _type;
 	InternalFormat _recommendedFormat;
 	void* _data;
+	Deleter _deleter;
 };
\ No newline at end of file
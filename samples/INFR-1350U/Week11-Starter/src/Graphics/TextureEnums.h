@@ -1,10 +1,19 @@
 #pragma once
 
+#include <cstdint>
 #include <EnumToString.h>
 
 #include "Logging.h"
 #include "glad/glad.h"
 
+// The S3TC formats (BC1-3) come from an extension that GLAD was not generated with, but every desktop driver supports it
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
 // https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glTexImage2D.xhtml
 // These are some of our more common available internal formats
 ENUM(InternalFormat, GLint,
@@ -18,7 +27,15 @@ ENUM(InternalFormat, GLint,
 	RGB10        = GL_RGB10,
 	RGB16        = GL_RGB16,
 	RGBA8        = GL_RGBA8,
-	RGBA16       = GL_RGBA16
+	RGBA16       = GL_RGBA16,
+
+	// Block compressed formats, these store 4x4 blocks of texels in 8 or 16 bytes and can only be uploaded with
+	// glCompressedTextureSubImage2D. See BlockCompressor for encoding them
+	BC1          = GL_COMPRESSED_RGB_S3TC_DXT1_EXT,  // RGB, 4 bits per texel
+	BC3          = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, // RGBA, 8 bits per texel (BC1 color with a BC4 alpha block)
+	BC4          = GL_COMPRESSED_RED_RGTC1,          // R, 4 bits per texel
+	BC5          = GL_COMPRESSED_RG_RGTC2,           // RG, 8 bits per texel (two BC4 blocks, good for normal maps)
+	BC7          = GL_COMPRESSED_RGBA_BPTC_UNORM     // RGBA, 8 bits per texel, much higher quality than BC1 and BC3
 
 	// Note: There are sized internal formats but there is a LOT of them
 );
@@ -126,4 +143,47 @@ constexpr GLint GetTexelComponentCount(PixelFormat format)
  */
 constexpr size_t GetTexelSize(PixelFormat format, PixelType type) {
 	return GetTexelComponentSize(type) * GetTexelComponentCount(format);
-}
\ No newline at end of file
+}
+
+/*
+ * Checks whether an internal format is one of the block compressed formats
+ */
+constexpr bool IsCompressedFormat(InternalFormat format) {
+	switch (format) {
+		case InternalFormat::BC1:
+		case InternalFormat::BC3:
+		case InternalFormat::BC4:
+		case InternalFormat::BC5:
+		case InternalFormat::BC7:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*
+ * Gets the number of bytes used to store a single 4x4 block of a compressed format
+ * @param format The compressed format
+ * @returns The size of a block in bytes, or 0 if the format is not compressed
+ */
+constexpr size_t GetCompressedBlockSize(InternalFormat format) {
+	switch (format) {
+		case InternalFormat::BC1:
+		case InternalFormat::BC4:
+			return 8;
+		case InternalFormat::BC3:
+		case InternalFormat::BC5:
+		case InternalFormat::BC7:
+			return 16;
+		default:
+			return 0;
+	}
+}
+
+/*
+ * Gets the number of bytes needed to store an image of the given size in a compressed format. Images are stored as
+ * whole blocks, so sizes are rounded up to a multiple of 4
+ */
+constexpr size_t GetCompressedImageSize(InternalFormat format, uint32_t width, uint32_t height) {
+	return ((width + 3) / 4) * (size_t)((height + 3) / 4) * GetCompressedBlockSize(format);
+}
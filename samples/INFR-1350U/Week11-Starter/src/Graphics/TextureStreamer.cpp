@@ -0,0 +1,316 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <stb_image.h>
+
+#include "GLState.h"
+#include "Logging.h"
+
+struct TextureStreamer::Job {
+	// Only one of these is set, depending on what kind of texture is being loaded
+	Texture2D::sptr          Texture;
+	TextureCubeMap::sptr     CubeMap;
+	bool                     GenerateMipMaps;
+
+	// One image per layer, 1 for 2D textures and 6 for cube maps
+	std::vector<std::string> Paths;
+	uint32_t                 Width;
+	uint32_t                 Height;
+	int                      Channels;
+	PixelFormat              Format;
+
+	// The decoded pixels for each layer, straight from STBI. A layer is null if it failed to load or has been uploaded
+	std::vector<uint8_t*>    Layers;
+	std::atomic<int>         LayersRemaining;
+	std::atomic<bool>        Failed;
+
+	// How far along the upload is
+	size_t                   UploadLayer;
+	uint32_t                 UploadRow;
+
+	Job() : GenerateMipMaps(false), Width(0), Height(0), Channels(0), Format(PixelFormat::RGBA),
+		LayersRemaining(0), Failed(false), UploadLayer(0), UploadRow(0) { }
+	~Job() {
+		for (uint8_t* layer : Layers) {
+			if (layer != nullptr) {
+				stbi_image_free(layer);
+			}
+		}
+	}
+};
+
+namespace {
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// What textures look like until their pixels arrive
+	const glm::vec4 PLACEHOLDER_COLOR = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+
+	/*
+	 * Picks the pixel layout and a good internal format for an image with the given number of channels, the same as
+	 * Texture2DData::LoadFromFile does
+	 */
+	bool GetFormatsForChannels(int channels, PixelFormat& format, InternalFormat& internalFormat) {
+		switch (channels) {
+			case 1: format = PixelFormat::Red;  internalFormat = InternalFormat::R8;    return true;
+			case 2: format = PixelFormat::RG;   internalFormat = InternalFormat::RG8;   return true;
+			case 3: format = PixelFormat::RGB;  internalFormat = InternalFormat::RGB8;  return true;
+			case 4: format = PixelFormat::RGBA; internalFormat = InternalFormat::RGBA8; return true;
+			default: return false;
+		}
+	}
+
+	double MillisecondsSince(const Clock::time_point& start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+}
+
+TextureStreamer::TextureStreamer(size_t uploadBudget, size_t decodeThreads) :
+	_shared(std::make_shared<SharedState>()),
+	_uploads(),
+	_staging(StreamingBuffer::Create(GL_PIXEL_UNPACK_BUFFER, uploadBudget)),
+	_uploadBudget(uploadBudget),
+	_stats({ 0, 0, 0, 0, 0.0, 0.0 }),
+	_decodePool(std::max<size_t>(decodeThreads, 1))
+{ }
+
+TextureStreamer::~TextureStreamer() {
+	// The pool runs everything that's left in it's queue before it's workers exit, this makes those tasks return right away
+	_shared->IsShuttingDown = true;
+}
+
+Texture2D::sptr TextureStreamer::LoadTexture2D(const std::string& path, const Texture2DDescription& description) {
+	const Clock::time_point start = Clock::now();
+
+	// Block compressed files have nothing to decode, so we upload them right away
+	if (std::filesystem::path(path).extension() == ".ktx2") {
+		CompressedTextureData::sptr data = CompressedTextureData::LoadFromKtx2(path);
+		if (data == nullptr) {
+			return nullptr;
+		}
+		Texture2D::sptr result = Texture2D::Create(description);
+		result->LoadCompressedData(data);
+		_stats.Completed++;
+		_stats.MainThreadMs += MillisecondsSince(start);
+		return result;
+	}
+
+	// We only read the header here, so that we can make the texture at it's final size right away
+	int width = 0, height = 0, channels = 0;
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	InternalFormat recommendedFormat = InternalFormat::Unknown;
+	if (!stbi_info(path.c_str(), &width, &height, &channels) || !GetFormatsForChannels(channels, job->Format, recommendedFormat)) {
+		LOG_WARN("Failed to read image header from \"{}\"", path);
+		return nullptr;
+	}
+
+	Texture2DDescription textureDesc = description;
+	textureDesc.Width = width;
+	textureDesc.Height = height;
+	if (textureDesc.Format == InternalFormat::Unknown) {
+		textureDesc.Format = recommendedFormat;
+	}
+	Texture2D::sptr result = Texture2D::Create(textureDesc);
+	result->Clear(PLACEHOLDER_COLOR);
+	// Fill in the smaller levels too, so the placeholder looks the same from far away
+	if (textureDesc.GenerateMipMaps) {
+		glGenerateTextureMipmap(result->GetHandle());
+	}
+	const std::string debugName = std::filesystem::path(path).filename().string();
+	glObjectLabel(GL_TEXTURE, result->GetHandle(), debugName.length(), debugName.c_str());
+
+	job->Texture = result;
+	job->GenerateMipMaps = textureDesc.GenerateMipMaps;
+	job->Paths = { path };
+	job->Width = width;
+	job->Height = height;
+	job->Channels = channels;
+	_StartJob(job);
+
+	_stats.MainThreadMs += MillisecondsSince(start);
+	return result;
+}
+
+TextureCubeMap::sptr TextureStreamer::LoadCubeMap(const std::string& rootImagePath, const TextureCubeDesc& description) {
+	const Clock::time_point start = Clock::now();
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	job->Paths = TextureCubeMapData::GetFaceImagePaths(rootImagePath);
+
+	// The faces all need to match, so we can take the size and format from the first one
+	int width = 0, height = 0, channels = 0;
+	InternalFormat recommendedFormat = InternalFormat::Unknown;
+	if (!stbi_info(job->Paths[0].c_str(), &width, &height, &channels) || !GetFormatsForChannels(channels, job->Format, recommendedFormat)) {
+		LOG_WARN("Failed to read image header from \"{}\"", job->Paths[0]);
+		return nullptr;
+	}
+	if (width != height) {
+		LOG_WARN("Cube map face \"{}\" is not square! ({}x{})", job->Paths[0], width, height);
+		return nullptr;
+	}
+
+	TextureCubeDesc textureDesc = description;
+	textureDesc.Size = width;
+	if (textureDesc.Format == InternalFormat::Unknown) {
+		textureDesc.Format = recommendedFormat;
+	}
+	TextureCubeMap::sptr result = TextureCubeMap::Create(textureDesc);
+	result->Clear(PLACEHOLDER_COLOR);
+	const std::string debugName = std::filesystem::path(rootImagePath).filename().string();
+	glObjectLabel(GL_TEXTURE, result->GetHandle(), debugName.length(), debugName.c_str());
+
+	job->CubeMap = result;
+	job->GenerateMipMaps = textureDesc.GenerateMipMaps;
+	job->Width = width;
+	job->Height = height;
+	job->Channels = channels;
+	_StartJob(job);
+
+	_stats.MainThreadMs += MillisecondsSince(start);
+	return result;
+}
+
+void TextureStreamer::_StartJob(const std::shared_ptr<Job>& job) {
+	// This is global in STBI, so we only ever set it from the main thread, and to the same value as Texture2DData
+	stbi_set_flip_vertically_on_load(true);
+
+	job->Layers.assign(job->Paths.size(), nullptr);
+	job->LayersRemaining = static_cast<int>(job->Paths.size());
+	_stats.Pending++;
+
+	// Each layer gets it's own task, so the faces of a cube map are decoded in parallel. The tasks only hold on to the
+	// job and the shared state, since they may still be queued while the streamer is being destroyed
+	std::shared_ptr<SharedState> shared = _shared;
+	for (size_t ix = 0; ix < job->Paths.size(); ix++) {
+		_decodePool.Enqueue([job, shared, ix]() {
+			if (shared->IsShuttingDown) {
+				return;
+			}
+			int width = 0, height = 0, channels = 0;
+			// We ask for the channel count from the header, so every layer ends up with the same layout
+			uint8_t* pixels = stbi_load(job->Paths[ix].c_str(), &width, &height, &channels, job->Channels);
+			if (pixels == nullptr) {
+				LOG_WARN("STBI Failed to load image from \"{}\"", job->Paths[ix]);
+				job->Failed = true;
+			} else if ((uint32_t)width != job->Width || (uint32_t)height != job->Height) {
+				LOG_WARN("Image \"{}\" is {}x{}, expected {}x{}", job->Paths[ix], width, height, job->Width, job->Height);
+				stbi_image_free(pixels);
+				job->Failed = true;
+			} else {
+				job->Layers[ix] = pixels;
+			}
+
+			// Whoever finishes the last layer hands the job off to be uploaded
+			if (--job->LayersRemaining == 0) {
+				{
+					std::lock_guard<std::mutex> lock(shared->Mutex);
+					shared->DecodedJobs.push_back(job);
+				}
+				shared->Decoded.notify_all();
+			}
+		});
+	}
+}
+
+void TextureStreamer::Update() {
+	const Clock::time_point start = Clock::now();
+	_UploadPending();
+	_stats.FrameMs = MillisecondsSince(start);
+	_stats.MainThreadMs += _stats.FrameMs;
+}
+
+void TextureStreamer::Wait() {
+	const Clock::time_point start = Clock::now();
+	while (_stats.Pending > 0) {
+		_UploadPending();
+		if (_stats.Pending > 0 && _uploads.empty()) {
+			// Nothing is ready to upload yet, so help out with the decoding, or sleep until a decode finishes
+			if (!_decodePool.TryRunPendingTask(nullptr)) {
+				std::unique_lock<std::mutex> lock(_shared->Mutex);
+				_shared->Decoded.wait_for(lock, std::chrono::milliseconds(1), [&]() { return !_shared->DecodedJobs.empty(); });
+			}
+		}
+	}
+	_stats.MainThreadMs += MillisecondsSince(start);
+}
+
+void TextureStreamer::_UploadPending() {
+	{
+		std::lock_guard<std::mutex> lock(_shared->Mutex);
+		while (!_shared->DecodedJobs.empty()) {
+			_uploads.push_back(_shared->DecodedJobs.front());
+			_shared->DecodedJobs.pop_front();
+		}
+	}
+	_stats.FrameUploadBytes = 0;
+	if (_uploads.empty()) {
+		return;
+	}
+
+	// We always make room for at least one row, otherwise a huge image could never finish
+	const Job& first = *_uploads.front();
+	const size_t capacity = std::max(_uploadBudget, first.Width * GetTexelSize(first.Format, PixelType::UByte));
+	uint8_t* staging = _staging->BeginFrame<uint8_t>(capacity);
+	const size_t stagingOffset = _staging->GetFrameOffset();
+
+	// While a pixel unpack buffer is bound, the pointers we pass to the upload functions are offsets into the buffer
+	GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, _staging->GetHandle());
+	// Rows are packed tightly in the staging buffer, which won't match the default alignment of 4 for RGB images
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	size_t used = 0;
+	while (!_uploads.empty()) {
+		Job& job = *_uploads.front();
+		const size_t rowSize = job.Width * GetTexelSize(job.Format, PixelType::UByte);
+
+		if (job.UploadLayer < job.Layers.size()) {
+			const uint8_t* pixels = job.Layers[job.UploadLayer];
+			// Layers that failed to load are left with the placeholder
+			if (pixels == nullptr) {
+				job.UploadLayer++;
+				continue;
+			}
+
+			const uint32_t rows = static_cast<uint32_t>(std::min<size_t>(job.Height - job.UploadRow, (capacity - used) / rowSize));
+			if (rows == 0) {
+				break;
+			}
+			memcpy(staging + used, pixels + job.UploadRow * rowSize, rows * rowSize);
+			const void* offset = reinterpret_cast<const void*>(stagingOffset + used);
+			if (job.Texture != nullptr) {
+				job.Texture->UpdateRegion(0, job.UploadRow, job.Width, rows, job.Format, PixelType::UByte, offset);
+			} else {
+				job.CubeMap->UpdateFaceRegion((CubeMapFace)static_cast<GLint>(job.UploadLayer), 0, job.UploadRow, job.Width, rows, job.Format, PixelType::UByte, offset);
+			}
+			used += rows * rowSize;
+			job.UploadRow += rows;
+
+			// We're done with this layer, so we can free it's pixels now instead of waiting for the whole job
+			if (job.UploadRow == job.Height) {
+				stbi_image_free(job.Layers[job.UploadLayer]);
+				job.Layers[job.UploadLayer] = nullptr;
+				job.UploadLayer++;
+				job.UploadRow = 0;
+			}
+			continue;
+		}
+
+		// Every layer has been uploaded, so the texture is ready
+		if (job.GenerateMipMaps) {
+			glGenerateTextureMipmap(job.Texture != nullptr ? job.Texture->GetHandle() : job.CubeMap->GetHandle());
+		}
+		if (job.Failed) {
+			_stats.Failed++;
+		} else {
+			_stats.Completed++;
+		}
+		_stats.Pending--;
+		_uploads.pop_front();
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	_staging->EndFrame();
+	_stats.FrameUploadBytes = used;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "StreamingBuffer.h"
+#include "Texture2D.h"
+#include "TextureCubeMap.h"
+#include "Utilities/ThreadPool.h"
+
+/// <summary>
+/// Loads textures in the background. Images are decoded on the streamer's own worker threads (so a slow decode can
+/// never end up on a thread that's helping with frame work), then uploaded a few rows at a time from a ring of pixel
+/// buffer objects, with a limit on how many bytes are uploaded each frame.
+///
+/// Textures are handed back right away at their final size (only the image's header is read up front), filled with a
+/// placeholder color until their pixels arrive. Since the texture's handle never changes, they can be given to
+/// materials straight away
+/// </summary>
+class TextureStreamer final
+{
+public:
+	typedef std::shared_ptr<TextureStreamer> sptr;
+	static inline sptr Create(size_t uploadBudget = DEFAULT_UPLOAD_BUDGET, size_t decodeThreads = DEFAULT_DECODE_THREADS) {
+		return std::make_shared<TextureStreamer>(uploadBudget, decodeThreads);
+	}
+
+	/// <summary>
+	/// The default number of bytes to upload each frame
+	/// </summary>
+	static constexpr size_t DEFAULT_UPLOAD_BUDGET = 4 * 1024 * 1024;
+	/// <summary>
+	/// The default number of threads to decode images on
+	/// </summary>
+	static constexpr size_t DEFAULT_DECODE_THREADS = 2;
+
+	struct Stats {
+		size_t Pending;          // Textures that are still being decoded or uploaded
+		size_t Completed;
+		size_t Failed;
+		size_t FrameUploadBytes; // The number of bytes uploaded by the last Update
+		double FrameMs;          // The time the last Update spent on the main thread
+		double MainThreadMs;     // The total time spent on the main thread, in Load calls, Update and Wait
+	};
+
+public:
+	// We'll disallow moving and copying, since decode tasks may still be running
+	TextureStreamer(const TextureStreamer& other) = delete;
+	TextureStreamer(TextureStreamer&& other) = delete;
+	TextureStreamer& operator=(const TextureStreamer& other) = delete;
+	TextureStreamer& operator=(TextureStreamer&& other) = delete;
+
+	/// <summary>
+	/// Creates a new texture streamer, must be called on the thread that owns the OpenGL context
+	/// </summary>
+	/// <param name="uploadBudget">The number of bytes to upload each frame</param>
+	/// <param name="decodeThreads">The number of threads to decode images on</param>
+	TextureStreamer(size_t uploadBudget, size_t decodeThreads = DEFAULT_DECODE_THREADS);
+	~TextureStreamer();
+
+	/// <summary>
+	/// Starts loading a 2D texture from a file, the pixels are filled in over the next few calls to Update. KTX2 files
+	/// are already in the GPU's format, so they are uploaded right away instead
+	/// </summary>
+	/// <param name="path">The path to load the image from</param>
+	/// <param name="description">The settings for the texture, the size is taken from the image, and if the format is Unknown one is picked from the image</param>
+	/// <returns>The texture, or nullptr if the file could not be read</returns>
+	Texture2D::sptr LoadTexture2D(const std::string& path, const Texture2DDescription& description = Texture2DDescription());
+	/// <summary>
+	/// Starts loading a cube map from a set of 6 images, see TextureCubeMapData::LoadFromImages for the naming. The faces
+	/// are decoded in parallel
+	/// </summary>
+	/// <param name="rootImagePath">The base path for images, including extension</param>
+	/// <param name="description">The settings for the texture, the size is taken from the images, and if the format is Unknown one is picked from the images</param>
+	/// <returns>The texture, or nullptr if the first face could not be read</returns>
+	TextureCubeMap::sptr LoadCubeMap(const std::string& rootImagePath, const TextureCubeDesc& description = TextureCubeDesc());
+
+	/// <summary>
+	/// Uploads the pixels of any decoded images, up to the upload budget. Should be called once per frame, on the thread
+	/// that owns the OpenGL context
+	/// </summary>
+	void Update();
+	/// <summary>
+	/// Blocks until every texture has been decoded and uploaded (ex: for a loading screen). The calling thread helps
+	/// with decoding while it waits
+	/// </summary>
+	void Wait();
+	/// <summary>
+	/// Returns true if there are no textures waiting to be decoded or uploaded
+	/// </summary>
+	bool IsIdle() const { return _stats.Pending == 0; }
+
+	/// <summary>
+	/// Sets the number of bytes to upload each frame. At least one row of an image is always uploaded per frame
+	/// </summary>
+	void SetUploadBudget(size_t bytes) { _uploadBudget = bytes; }
+	size_t GetUploadBudget() const { return _uploadBudget; }
+
+	const Stats& GetStats() const { return _stats; }
+
+private:
+	struct Job;
+	// The state that is shared with the decode tasks
+	struct SharedState {
+		std::mutex                       Mutex;
+		std::condition_variable          Decoded;
+		std::deque<std::shared_ptr<Job>> DecodedJobs;
+		// Set when the streamer is destroyed, so queued decodes can be skipped
+		std::atomic<bool>                IsShuttingDown{ false };
+	};
+
+	std::shared_ptr<SharedState>     _shared;
+	// Jobs that have been decoded and are being uploaded, in the order they finished decoding. Main thread only
+	std::deque<std::shared_ptr<Job>> _uploads;
+	StreamingBuffer::sptr            _staging;
+	size_t                           _uploadBudget;
+	Stats                            _stats;
+	// Only runs decode tasks, this is declared last so that it's workers are joined before anything else goes away
+	ThreadPool                       _decodePool;
+
+	/// <summary>
+	/// Queues up the decode tasks for a job
+	/// </summary>
+	void _StartJob(const std::shared_ptr<Job>& job);
+	/// <summary>
+	/// Grabs any newly decoded jobs, then copies rows from the jobs in _uploads into this frame's region of the staging
+	/// buffer and uploads them, up to the upload budget
+	/// </summary>
+	void _UploadPending();
+};
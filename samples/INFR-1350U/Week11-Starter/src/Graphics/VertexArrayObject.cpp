@@ -1,12 +1,16 @@
 #include "VertexArrayObject.h"
+#include "GLState.h"
 #include "IndexBuffer.h"
 #include "Logging.h"
 #include "VertexBuffer.h"
 
+uint32_t VertexArrayObject::_nextId = 0;
+
 VertexArrayObject::VertexArrayObject() :
 	_indexBuffer(nullptr),
 	_handle(0),
-	_vertexCount(0)
+	_vertexCount(0),
+	_id(_nextId++)
 {
 	glCreateVertexArrays(1, &_handle);
 }
@@ -14,6 +18,7 @@ VertexArrayObject::VertexArrayObject() :
 VertexArrayObject::~VertexArrayObject()
 {
 	if (_handle != 0) {
+		GLState::OnVertexArrayDeleted(_handle);
 		glDeleteVertexArrays(1, &_handle);
 		_handle = 0;
 	}
@@ -54,11 +59,11 @@ void VertexArrayObject::AddVertexBuffer(const VertexBuffer::sptr& buffer, const
 }
 
 void VertexArrayObject::Bind() const {
-	glBindVertexArray(_handle);
+	GLState::BindVertexArray(_handle);
 }
 
 void VertexArrayObject::UnBind() {
-	glBindVertexArray(0);
+	GLState::BindVertexArray(0);
 }
 
 void VertexArrayObject::Render() const {
@@ -68,5 +73,13 @@ void VertexArrayObject::Render() const {
 	} else {
 		glDrawArrays(GL_TRIANGLES, 0, _vertexCount / 3);
 	}
-	UnBind();
+}
+
+void VertexArrayObject::RenderInstanced(GLsizei instanceCount, GLuint baseInstance) const {
+	Bind();
+	if (_indexBuffer != nullptr) {
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, _indexBuffer->GetElementCount(), _indexBuffer->GetElementType(), nullptr, instanceCount, baseInstance);
+	} else {
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, _vertexCount, instanceCount, baseInstance);
+	}
 }
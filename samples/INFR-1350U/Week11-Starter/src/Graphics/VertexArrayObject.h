@@ -6,6 +6,7 @@
 
 #include "VertexBuffer.h"
 #include "IndexBuffer.h"
+#include "Utilities/Bounds.h"
 
 /// <summary>
 /// We'll use this just to make it more clear what the intended usage of an attribute is in our code!
@@ -127,8 +128,38 @@ public:
 	/// Returns the underlying OpenGL handle that this class is wrapping around
 	/// </summary>
 	GLuint GetHandle() const { return _handle; }
+	/// <summary>
+	/// Gets a unique number for this VAO, unlike OpenGL handles these are never reused once a VAO is deleted
+	/// </summary>
+	uint32_t GetId() const { return _id; }
 
 	void Render() const;
+	/// <summary>
+	/// Draws several instances of this VAO. Shaders can tell which objects they are drawing using
+	/// gl_BaseInstanceARB and gl_InstanceID
+	/// </summary>
+	/// <param name="instanceCount">The number of instances to draw</param>
+	/// <param name="baseInstance">The index of the first instance</param>
+	void RenderInstanced(GLsizei instanceCount, GLuint baseInstance = 0) const;
+
+	/// <summary>
+	/// Sets the bounds of the mesh in it's local space, this is done for us by MeshBuilder::Bake and MeshCache::Load
+	/// </summary>
+	/// <param name="bounds">The box around all of the vertices</param>
+	/// <param name="sphere">The sphere around all of the vertices</param>
+	void SetBounds(const AABB& bounds, const BoundingSphere& sphere) { _bounds = bounds; _boundingSphere = sphere; }
+	/// <summary>
+	/// Returns true if the mesh has bounds, meshes without bounds can't be culled
+	/// </summary>
+	bool HasBounds() const { return !_bounds.IsEmpty(); }
+	/// <summary>
+	/// Gets the box around the mesh in it's local space
+	/// </summary>
+	const AABB& GetBounds() const { return _bounds; }
+	/// <summary>
+	/// Gets the sphere around the mesh in it's local space
+	/// </summary>
+	const BoundingSphere& GetBoundingSphere() const { return _boundingSphere; }
 	
 protected:
 	// Helper structure to store a buffer and the attributes
@@ -144,7 +175,13 @@ protected:
 	std::vector<VertexBufferBinding> _vertexBuffers;
 
 	GLsizei _vertexCount;
+
+	AABB           _bounds;
+	BoundingSphere _boundingSphere;
 	
 	// The underlying OpenGL handle that this class is wrapping around
 	GLuint _handle;
+	uint32_t _id;
+
+	static uint32_t _nextId;
 };
@@ -0,0 +1,690 @@
+#include "BlockCompressor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+#include <GLM/glm.hpp>
+
+#include "Logging.h"
+#include "Utilities/ThreadPool.h"
+
+// SSE is always available on x64, MSVC only tells us about it through _M_IX86_FP on 32 bit builds
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define BLOCK_COMPRESSOR_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// A 4x4 block of pixels, with one array per channel so that we can work on 4 pixels at a time
+	struct Block {
+		alignas(16) float Channels[4][16];
+	};
+
+	// A palette holds the colors a block can pick from, with all 4 channels per entry (unused channels are ignored)
+	typedef float Palette[16][4];
+
+	// The interpolation weights for BC7's 4 bit indices, out of 64
+	constexpr int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// The number of times we refit the endpoints to the pixels that picked them
+	constexpr int REFINE_ITERATIONS = 2;
+
+	/*
+	 * Picks the closest palette entry for each pixel in a block, looking at channels [firstChannel, firstChannel + channelCount)
+	 * @returns The total squared error of the block
+	 */
+	float FindClosestIndices(const Block& block, int firstChannel, int channelCount, const Palette& palette, int paletteSize, uint8_t indices[16]) {
+		float error = 0.0f;
+	#ifdef BLOCK_COMPRESSOR_SSE
+		for (int group = 0; group < 16; group += 4) {
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128 bestIndex = _mm_setzero_ps();
+			for (int entry = 0; entry < paletteSize; entry++) {
+				__m128 distance = _mm_setzero_ps();
+				for (int channel = firstChannel; channel < firstChannel + channelCount; channel++) {
+					const __m128 delta = _mm_sub_ps(_mm_load_ps(block.Channels[channel] + group), _mm_set1_ps(palette[entry][channel]));
+					distance = _mm_add_ps(distance, _mm_mul_ps(delta, delta));
+				}
+				// Only strictly closer entries win, so ties go to the lowest index like the scalar version
+				const __m128 closer = _mm_cmplt_ps(distance, best);
+				best = _mm_min_ps(distance, best);
+				bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps((float)entry)), _mm_andnot_ps(closer, bestIndex));
+			}
+			alignas(16) float bestValues[4];
+			alignas(16) float bestIndices[4];
+			_mm_store_ps(bestValues, best);
+			_mm_store_ps(bestIndices, bestIndex);
+			for (int ix = 0; ix < 4; ix++) {
+				indices[group + ix] = static_cast<uint8_t>(bestIndices[ix]);
+				error += bestValues[ix];
+			}
+		}
+	#else
+		for (int pixel = 0; pixel < 16; pixel++) {
+			float best = FLT_MAX;
+			for (int entry = 0; entry < paletteSize; entry++) {
+				float distance = 0.0f;
+				for (int channel = firstChannel; channel < firstChannel + channelCount; channel++) {
+					const float delta = block.Channels[channel][pixel] - palette[entry][channel];
+					distance += delta * delta;
+				}
+				if (distance < best) {
+					best = distance;
+					indices[pixel] = static_cast<uint8_t>(entry);
+				}
+			}
+			error += best;
+		}
+	#endif
+		return error;
+	}
+
+	/*
+	 * Finds the line that best fits the pixels of a block in the given channels, using power iteration on their covariance
+	 * @param mean Receives the average of the pixels
+	 * @param axis Receives the direction of the line, normalized, or zero if every pixel is the same
+	 * @param minT Receives the smallest projection of a pixel onto the line
+	 * @param maxT Receives the largest projection of a pixel onto the line
+	 */
+	void FitLine(const Block& block, int channelCount, float mean[4], float axis[4], float& minT, float& maxT) {
+		for (int channel = 0; channel < 4; channel++) {
+			mean[channel] = 0.0f;
+			axis[channel] = 0.0f;
+		}
+		for (int channel = 0; channel < channelCount; channel++) {
+			for (int pixel = 0; pixel < 16; pixel++) {
+				mean[channel] += block.Channels[channel][pixel];
+			}
+			mean[channel] /= 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (int pixel = 0; pixel < 16; pixel++) {
+			for (int a = 0; a < channelCount; a++) {
+				for (int b = a; b < channelCount; b++) {
+					covariance[a][b] += (block.Channels[a][pixel] - mean[a]) * (block.Channels[b][pixel] - mean[b]);
+				}
+			}
+		}
+		for (int a = 0; a < channelCount; a++) {
+			for (int b = 0; b < a; b++) {
+				covariance[a][b] = covariance[b][a];
+			}
+		}
+
+		// Start from the channel that varies the most, which can't be perpendicular to every direction the block varies in
+		int widest = 0;
+		for (int a = 1; a < channelCount; a++) {
+			if (covariance[a][a] > covariance[widest][widest]) {
+				widest = a;
+			}
+		}
+		if (covariance[widest][widest] > 1e-4f) {
+			axis[widest] = 1.0f;
+			for (int iteration = 0; iteration < 8; iteration++) {
+				float next[4] = {};
+				float length = 0.0f;
+				for (int a = 0; a < channelCount; a++) {
+					for (int b = 0; b < channelCount; b++) {
+						next[a] += covariance[a][b] * axis[b];
+					}
+					length += next[a] * next[a];
+				}
+				length = 1.0f / sqrtf(length);
+				for (int a = 0; a < channelCount; a++) {
+					axis[a] = next[a] * length;
+				}
+			}
+		}
+
+		minT = 0.0f;
+		maxT = 0.0f;
+		for (int pixel = 0; pixel < 16; pixel++) {
+			float t = 0.0f;
+			for (int channel = 0; channel < channelCount; channel++) {
+				t += (block.Channels[channel][pixel] - mean[channel]) * axis[channel];
+			}
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+	}
+
+	/*
+	 * Solves for the two endpoints that best reproduce a block, given how far along the line between them each pixel is
+	 * @param weights How much of the second endpoint each pixel gets, from 0 to 1
+	 * @returns False if the pixels don't pin down the endpoints (ex: they all picked the same palette entry)
+	 */
+	bool SolveEndpoints(const Block& block, int firstChannel, int channelCount, const float weights[16], float start[4], float end[4]) {
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float sumA[4] = {}, sumB[4] = {};
+		for (int pixel = 0; pixel < 16; pixel++) {
+			const float b = weights[pixel];
+			const float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int channel = firstChannel; channel < firstChannel + channelCount; channel++) {
+				sumA[channel] += a * block.Channels[channel][pixel];
+				sumB[channel] += b * block.Channels[channel][pixel];
+			}
+		}
+		const float determinant = aa * bb - ab * ab;
+		if (fabsf(determinant) < 1e-6f) {
+			return false;
+		}
+		for (int channel = firstChannel; channel < firstChannel + channelCount; channel++) {
+			start[channel] = glm::clamp((bb * sumA[channel] - ab * sumB[channel]) / determinant, 0.0f, 255.0f);
+			end[channel] = glm::clamp((aa * sumB[channel] - ab * sumA[channel]) / determinant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	/*
+	 * Writes the low bits of a value into a block, starting from the lowest bit
+	 */
+	struct BitWriter {
+		uint8_t* Data;
+		int      Position;
+
+		void Write(uint32_t value, int bits) {
+			for (int ix = 0; ix < bits; ix++, Position++) {
+				Data[Position >> 3] |= ((value >> ix) & 1) << (Position & 7);
+			}
+		}
+	};
+
+	#pragma region BC1
+
+	inline uint16_t PackRgb565(const float color[4]) {
+		const uint16_t r = static_cast<uint16_t>(glm::clamp(color[0] * (31.0f / 255.0f) + 0.5f, 0.0f, 31.0f));
+		const uint16_t g = static_cast<uint16_t>(glm::clamp(color[1] * (63.0f / 255.0f) + 0.5f, 0.0f, 63.0f));
+		const uint16_t b = static_cast<uint16_t>(glm::clamp(color[2] * (31.0f / 255.0f) + 0.5f, 0.0f, 31.0f));
+		return (r << 11) | (g << 5) | b;
+	}
+
+	inline void UnpackRgb565(uint16_t packed, float color[4]) {
+		const int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+		color[0] = static_cast<float>((r << 3) | (r >> 2));
+		color[1] = static_cast<float>((g << 2) | (g >> 4));
+		color[2] = static_cast<float>((b << 3) | (b >> 2));
+		color[3] = 255.0f;
+	}
+
+	/*
+	 * Picks the indices for a pair of BC1 endpoints, swapping them if needed so the block uses the 4 color mode
+	 * @returns The squared error of the block
+	 */
+	float EvaluateColorEndpoints(const Block& block, uint16_t& color0, uint16_t& color1, uint8_t indices[16]) {
+		if (color0 < color1) {
+			std::swap(color0, color1);
+		}
+		Palette palette;
+		UnpackRgb565(color0, palette[0]);
+		UnpackRgb565(color1, palette[1]);
+		for (int channel = 0; channel < 3; channel++) {
+			palette[2][channel] = (2.0f * palette[0][channel] + palette[1][channel]) / 3.0f;
+			palette[3][channel] = (palette[0][channel] + 2.0f * palette[1][channel]) / 3.0f;
+		}
+		// If the endpoints are the same there's no 4 color mode, but every index gives the same color anyways
+		return FindClosestIndices(block, 0, 3, palette, color0 == color1 ? 1 : 4, indices);
+	}
+
+	/*
+	 * Encodes the RGB channels of a block as a BC1 color block (also used by BC3)
+	 * @returns The squared error of the block
+	 */
+	float EncodeColorBlock(const Block& block, uint8_t* output) {
+		float mean[4], axis[4], minT, maxT;
+		FitLine(block, 3, mean, axis, minT, maxT);
+		float start[4], end[4];
+		for (int channel = 0; channel < 3; channel++) {
+			start[channel] = glm::clamp(mean[channel] + axis[channel] * maxT, 0.0f, 255.0f);
+			end[channel] = glm::clamp(mean[channel] + axis[channel] * minT, 0.0f, 255.0f);
+		}
+
+		uint16_t bestColor0 = PackRgb565(start), bestColor1 = PackRgb565(end);
+		uint8_t bestIndices[16];
+		float bestError = EvaluateColorEndpoints(block, bestColor0, bestColor1, bestIndices);
+
+		// Palette entries 0 to 3 are 0, 1, 2/3 and 1/3 of the way from the second endpoint to the first
+		constexpr float WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		for (int iteration = 0; iteration < REFINE_ITERATIONS && bestError > 0.0f; iteration++) {
+			float weights[16];
+			for (int pixel = 0; pixel < 16; pixel++) {
+				weights[pixel] = WEIGHTS[bestIndices[pixel]];
+			}
+			if (!SolveEndpoints(block, 0, 3, weights, start, end)) {
+				break;
+			}
+			uint16_t color0 = PackRgb565(start), color1 = PackRgb565(end);
+			uint8_t indices[16];
+			const float error = EvaluateColorEndpoints(block, color0, color1, indices);
+			if (error >= bestError) {
+				break;
+			}
+			bestError = error;
+			bestColor0 = color0;
+			bestColor1 = color1;
+			memcpy(bestIndices, indices, 16);
+		}
+
+		uint32_t packedIndices = 0;
+		for (int pixel = 0; pixel < 16; pixel++) {
+			packedIndices |= static_cast<uint32_t>(bestIndices[pixel]) << (pixel * 2);
+		}
+		memcpy(output, &bestColor0, 2);
+		memcpy(output + 2, &bestColor1, 2);
+		memcpy(output + 4, &packedIndices, 4);
+		return bestError;
+	}
+
+	#pragma endregion
+
+	#pragma region BC4
+
+	/*
+	 * Builds the palette for a pair of BC4 endpoints. If the first is larger there are 6 steps between them, otherwise
+	 * there are 4, plus 0 and 255
+	 */
+	void BuildSingleChannelPalette(int channel, uint8_t value0, uint8_t value1, Palette& palette) {
+		palette[0][channel] = value0;
+		palette[1][channel] = value1;
+		if (value0 > value1) {
+			for (int ix = 2; ix < 8; ix++) {
+				palette[ix][channel] = ((8 - ix) * value0 + (ix - 1) * value1) / 7.0f;
+			}
+		} else {
+			for (int ix = 2; ix < 6; ix++) {
+				palette[ix][channel] = ((6 - ix) * value0 + (ix - 1) * value1) / 5.0f;
+			}
+			palette[6][channel] = 0.0f;
+			palette[7][channel] = 255.0f;
+		}
+	}
+
+	/*
+	 * Encodes a single channel of a block as a BC4 block (also used for BC3's alpha and both halves of BC5)
+	 * @returns The squared error of the block
+	 */
+	float EncodeSingleChannelBlock(const Block& block, int channel, uint8_t* output) {
+		const float* values = block.Channels[channel];
+		float minValue = 255.0f, maxValue = 0.0f;
+		// The range of the pixels that aren't 0 or 255, which the 6 step mode can represent exactly
+		float minInner = 255.0f, maxInner = 0.0f;
+		for (int pixel = 0; pixel < 16; pixel++) {
+			minValue = std::min(minValue, values[pixel]);
+			maxValue = std::max(maxValue, values[pixel]);
+			if (values[pixel] > 0.0f && values[pixel] < 255.0f) {
+				minInner = std::min(minInner, values[pixel]);
+				maxInner = std::max(maxInner, values[pixel]);
+			}
+		}
+
+		Palette palette;
+		uint8_t bestValue0 = static_cast<uint8_t>(maxValue), bestValue1 = static_cast<uint8_t>(minValue);
+		uint8_t bestIndices[16];
+		BuildSingleChannelPalette(channel, bestValue0, bestValue1, palette);
+		float bestError = FindClosestIndices(block, channel, 1, palette, bestValue0 == bestValue1 ? 1 : 8, bestIndices);
+
+		// Refine the 8 value mode, as long as the endpoints stay in order
+		constexpr float WEIGHTS[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+		for (int iteration = 0; iteration < REFINE_ITERATIONS && bestError > 0.0f && bestValue0 > bestValue1; iteration++) {
+			float weights[16];
+			for (int pixel = 0; pixel < 16; pixel++) {
+				weights[pixel] = WEIGHTS[bestIndices[pixel]];
+			}
+			float start[4], end[4];
+			if (!SolveEndpoints(block, channel, 1, weights, start, end)) {
+				break;
+			}
+			const uint8_t value0 = static_cast<uint8_t>(start[channel] + 0.5f), value1 = static_cast<uint8_t>(end[channel] + 0.5f);
+			if (value0 <= value1) {
+				break;
+			}
+			uint8_t indices[16];
+			BuildSingleChannelPalette(channel, value0, value1, palette);
+			const float error = FindClosestIndices(block, channel, 1, palette, 8, indices);
+			if (error >= bestError) {
+				break;
+			}
+			bestError = error;
+			bestValue0 = value0;
+			bestValue1 = value1;
+			memcpy(bestIndices, indices, 16);
+		}
+
+		// Blocks with pixels at 0 or 255 (ex: alpha cutouts) can do better with the 6 value mode, which has those for free
+		if (bestError > 0.0f && (minValue == 0.0f || maxValue == 255.0f)) {
+			const uint8_t value0 = minInner <= maxInner ? static_cast<uint8_t>(minInner) : 0;
+			const uint8_t value1 = minInner <= maxInner ? static_cast<uint8_t>(maxInner) : 255;
+			uint8_t indices[16];
+			BuildSingleChannelPalette(channel, value0, value1, palette);
+			const float error = FindClosestIndices(block, channel, 1, palette, 8, indices);
+			if (error < bestError) {
+				bestError = error;
+				bestValue0 = value0;
+				bestValue1 = value1;
+				memcpy(bestIndices, indices, 16);
+			}
+		}
+
+		memset(output, 0, 8);
+		output[0] = bestValue0;
+		output[1] = bestValue1;
+		BitWriter writer = { output, 16 };
+		for (int pixel = 0; pixel < 16; pixel++) {
+			writer.Write(bestIndices[pixel], 3);
+		}
+		return bestError;
+	}
+
+	#pragma endregion
+
+	#pragma region BC7
+
+	/*
+	 * Quantizes a BC7 mode 6 endpoint to 7 bits per channel plus a shared low bit, picking whichever low bit is closer
+	 */
+	void QuantizeBC7Endpoint(const float endpoint[4], uint8_t quantized[4], uint8_t& pBit) {
+		float bestError = FLT_MAX;
+		for (uint8_t bit = 0; bit < 2; bit++) {
+			uint8_t values[4];
+			float error = 0.0f;
+			for (int channel = 0; channel < 4; channel++) {
+				values[channel] = static_cast<uint8_t>(glm::clamp((endpoint[channel] - bit) * 0.5f + 0.5f, 0.0f, 127.0f));
+				const float delta = (values[channel] * 2 + bit) - endpoint[channel];
+				error += delta * delta;
+			}
+			if (error < bestError) {
+				bestError = error;
+				pBit = bit;
+				memcpy(quantized, values, 4);
+			}
+		}
+	}
+
+	/*
+	 * Picks the indices for a pair of quantized BC7 mode 6 endpoints
+	 * @returns The squared error of the block
+	 */
+	float EvaluateBC7Endpoints(const Block& block, const uint8_t quantized[2][4], const uint8_t pBits[2], uint8_t indices[16]) {
+		Palette palette;
+		for (int channel = 0; channel < 4; channel++) {
+			const int value0 = quantized[0][channel] * 2 + pBits[0];
+			const int value1 = quantized[1][channel] * 2 + pBits[1];
+			for (int entry = 0; entry < 16; entry++) {
+				palette[entry][channel] = static_cast<float>(((64 - BC7_WEIGHTS[entry]) * value0 + BC7_WEIGHTS[entry] * value1 + 32) >> 6);
+			}
+		}
+		return FindClosestIndices(block, 0, 4, palette, 16, indices);
+	}
+
+	/*
+	 * Encodes a block as BC7, using mode 6 (one subset, RGBA endpoints with 7 bits per channel and a shared low bit,
+	 * and 4 bit indices)
+	 * @returns The squared error of the block
+	 */
+	float EncodeBC7Block(const Block& block, uint8_t* output) {
+		float mean[4], axis[4], minT, maxT;
+		FitLine(block, 4, mean, axis, minT, maxT);
+		float start[4], end[4];
+		for (int channel = 0; channel < 4; channel++) {
+			start[channel] = glm::clamp(mean[channel] + axis[channel] * minT, 0.0f, 255.0f);
+			end[channel] = glm::clamp(mean[channel] + axis[channel] * maxT, 0.0f, 255.0f);
+		}
+
+		uint8_t bestQuantized[2][4], bestPBits[2];
+		QuantizeBC7Endpoint(start, bestQuantized[0], bestPBits[0]);
+		QuantizeBC7Endpoint(end, bestQuantized[1], bestPBits[1]);
+		uint8_t bestIndices[16];
+		float bestError = EvaluateBC7Endpoints(block, bestQuantized, bestPBits, bestIndices);
+
+		for (int iteration = 0; iteration < REFINE_ITERATIONS && bestError > 0.0f; iteration++) {
+			float weights[16];
+			for (int pixel = 0; pixel < 16; pixel++) {
+				weights[pixel] = BC7_WEIGHTS[bestIndices[pixel]] / 64.0f;
+			}
+			if (!SolveEndpoints(block, 0, 4, weights, start, end)) {
+				break;
+			}
+			uint8_t quantized[2][4], pBits[2], indices[16];
+			QuantizeBC7Endpoint(start, quantized[0], pBits[0]);
+			QuantizeBC7Endpoint(end, quantized[1], pBits[1]);
+			const float error = EvaluateBC7Endpoints(block, quantized, pBits, indices);
+			if (error >= bestError) {
+				break;
+			}
+			bestError = error;
+			memcpy(bestQuantized, quantized, sizeof(quantized));
+			memcpy(bestPBits, pBits, sizeof(pBits));
+			memcpy(bestIndices, indices, 16);
+		}
+
+		// The first pixel's index only gets 3 bits, so its top bit has to be 0. We can swap the endpoints to make it so
+		if (bestIndices[0] & 8) {
+			std::swap(bestQuantized[0], bestQuantized[1]);
+			std::swap(bestPBits[0], bestPBits[1]);
+			for (int pixel = 0; pixel < 16; pixel++) {
+				bestIndices[pixel] = 15 - bestIndices[pixel];
+			}
+		}
+
+		memset(output, 0, 16);
+		BitWriter writer = { output, 0 };
+		writer.Write(1 << 6, 7); // Mode 6 is marked by 6 zeros followed by a one
+		for (int channel = 0; channel < 4; channel++) {
+			writer.Write(bestQuantized[0][channel], 7);
+			writer.Write(bestQuantized[1][channel], 7);
+		}
+		writer.Write(bestPBits[0], 1);
+		writer.Write(bestPBits[1], 1);
+		writer.Write(bestIndices[0], 3);
+		for (int pixel = 1; pixel < 16; pixel++) {
+			writer.Write(bestIndices[pixel], 4);
+		}
+		return bestError;
+	}
+
+	#pragma endregion
+
+	/*
+	 * Encodes a single block in the given format
+	 * @returns The squared error of the block, summed over the channels the format stores
+	 */
+	float EncodeBlock(InternalFormat format, const Block& block, uint8_t* output) {
+		switch (format) {
+			case InternalFormat::BC1:
+				return EncodeColorBlock(block, output);
+			case InternalFormat::BC3:
+				return EncodeSingleChannelBlock(block, 3, output) + EncodeColorBlock(block, output + 8);
+			case InternalFormat::BC4:
+				return EncodeSingleChannelBlock(block, 0, output);
+			case InternalFormat::BC5:
+				return EncodeSingleChannelBlock(block, 0, output) + EncodeSingleChannelBlock(block, 1, output + 8);
+			case InternalFormat::BC7:
+				return EncodeBC7Block(block, output);
+			default:
+				LOG_ASSERT(false, "Unsupported compressed format: {}", format);
+				return 0.0f;
+		}
+	}
+
+	/*
+	 * Gets the number of channels a compressed format stores, used to average the error
+	 */
+	int GetStoredChannelCount(InternalFormat format) {
+		switch (format) {
+			case InternalFormat::BC4: return 1;
+			case InternalFormat::BC5: return 2;
+			case InternalFormat::BC1: return 3;
+			default:                  return 4;
+		}
+	}
+
+	/*
+	 * Copies an image into a tightly packed RGBA buffer, with missing channels set to 0 (or 255 for alpha) the same
+	 * way OpenGL fills them in when sampling
+	 */
+	std::vector<uint8_t> ExpandToRgba(const Texture2DData& image) {
+		const size_t pixelCount = image.GetWidth() * (size_t)image.GetHeight();
+		const int channels = GetTexelComponentCount(image.GetFormat());
+		const bool isBgr = image.GetFormat() == PixelFormat::BGR || image.GetFormat() == PixelFormat::BGRA;
+		const uint8_t* source = static_cast<const uint8_t*>(image.GetDataPtr());
+
+		std::vector<uint8_t> result(pixelCount * 4);
+		for (size_t pixel = 0; pixel < pixelCount; pixel++) {
+			uint8_t* target = result.data() + pixel * 4;
+			const uint8_t* texel = source + pixel * channels;
+			target[0] = texel[isBgr ? 2 : 0];
+			target[1] = channels > 1 ? texel[1] : 0;
+			target[2] = channels > 2 ? texel[isBgr ? 0 : 2] : 0;
+			target[3] = channels > 3 ? texel[3] : 255;
+		}
+		return result;
+	}
+
+	/*
+	 * Shrinks an RGBA image to half its size, averaging each 2x2 group of pixels. Odd sized images repeat their last
+	 * row or column
+	 */
+	std::vector<uint8_t> Downsample(const std::vector<uint8_t>& source, uint32_t width, uint32_t height, uint32_t& newWidth, uint32_t& newHeight) {
+		newWidth = std::max(width / 2, 1u);
+		newHeight = std::max(height / 2, 1u);
+		std::vector<uint8_t> result(newWidth * (size_t)newHeight * 4);
+		for (uint32_t y = 0; y < newHeight; y++) {
+			const uint8_t* row0 = source.data() + (size_t)std::min(y * 2, height - 1) * width * 4;
+			const uint8_t* row1 = source.data() + (size_t)std::min(y * 2 + 1, height - 1) * width * 4;
+			for (uint32_t x = 0; x < newWidth; x++) {
+				const uint32_t x0 = std::min(x * 2, width - 1) * 4;
+				const uint32_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+				uint8_t* target = result.data() + ((size_t)y * newWidth + x) * 4;
+				for (int channel = 0; channel < 4; channel++) {
+					target[channel] = static_cast<uint8_t>((row0[x0 + channel] + row0[x1 + channel] + row1[x0 + channel] + row1[x1 + channel] + 2) >> 2);
+				}
+			}
+		}
+		return result;
+	}
+
+	double MillisecondsSince(const Clock::time_point& start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+}
+
+InternalFormat BlockCompressor::ChooseFormat(const Texture2DData::sptr& image) {
+	switch (image->GetFormat()) {
+		case PixelFormat::Red:
+			return InternalFormat::BC4;
+		case PixelFormat::RG:
+			return InternalFormat::BC5;
+		case PixelFormat::RGBA:
+		case PixelFormat::BGRA:
+		{
+			const size_t pixelCount = image->GetWidth() * (size_t)image->GetHeight();
+			const uint8_t* pixels = static_cast<const uint8_t*>(image->GetDataPtr());
+			for (size_t pixel = 0; pixel < pixelCount; pixel++) {
+				if (pixels[pixel * 4 + 3] != 255) {
+					return InternalFormat::BC7;
+				}
+			}
+			return InternalFormat::BC1;
+		}
+		default:
+			return InternalFormat::BC1;
+	}
+}
+
+CompressedTextureData::sptr BlockCompressor::Compress(const Texture2DData::sptr& image, InternalFormat format, bool generateMipMaps, Stats* stats) {
+	LOG_ASSERT(image->GetPixelType() == PixelType::UByte, "Only images with 8 bits per channel can be compressed!");
+	const Clock::time_point start = Clock::now();
+	if (format == InternalFormat::Unknown) {
+		format = ChooseFormat(image);
+	}
+	LOG_ASSERT(IsCompressedFormat(format), "{} is not a block compressed format!", format);
+
+	CompressedTextureData::sptr result = std::make_shared<CompressedTextureData>(format, image->GetWidth(), image->GetHeight(), generateMipMaps ? 0 : 1);
+	result->DebugName = image->DebugName;
+	const size_t blockSize = GetCompressedBlockSize(format);
+
+	std::vector<uint8_t> pixels = ExpandToRgba(*image);
+	uint32_t width = image->GetWidth(), height = image->GetHeight();
+	size_t blocks = 0;
+	double topLevelError = 0.0;
+	for (uint32_t level = 0; level < result->GetLevelCount(); level++) {
+		if (level > 0) {
+			uint32_t newWidth, newHeight;
+			pixels = Downsample(pixels, width, height, newWidth, newHeight);
+			width = newWidth;
+			height = newHeight;
+		}
+
+		// Each task encodes a row of blocks, so no two threads ever write to the same block
+		const uint32_t blocksWide = (width + 3) / 4;
+		const uint32_t blocksHigh = (height + 3) / 4;
+		uint8_t* output = result->GetMutableLevelData(level);
+		std::vector<double> rowErrors(blocksHigh, 0.0);
+		ThreadPool::Instance().ParallelFor(blocksHigh, [&](size_t blockY) {
+			Block block;
+			double rowError = 0.0;
+			for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+				// Blocks that hang off the edge of the image repeat the last row or column
+				for (uint32_t y = 0; y < 4; y++) {
+					const uint32_t sourceY = std::min(static_cast<uint32_t>(blockY * 4 + y), height - 1);
+					for (uint32_t x = 0; x < 4; x++) {
+						const uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+						const uint8_t* texel = pixels.data() + ((size_t)sourceY * width + sourceX) * 4;
+						for (int channel = 0; channel < 4; channel++) {
+							block.Channels[channel][y * 4 + x] = texel[channel];
+						}
+					}
+				}
+				rowError += EncodeBlock(format, block, output + (blockY * blocksWide + blockX) * blockSize);
+			}
+			rowErrors[blockY] = rowError;
+		});
+
+		blocks += blocksWide * (size_t)blocksHigh;
+		if (level == 0) {
+			for (double rowError : rowErrors) {
+				topLevelError += rowError;
+			}
+		}
+	}
+
+	if (stats != nullptr) {
+		// The error includes the padding pixels of partial blocks, which is close enough for a quality estimate
+		const size_t samples = GetCompressedImageSize(format, image->GetWidth(), image->GetHeight()) / blockSize * 16 * GetStoredChannelCount(format);
+		stats->Blocks = blocks;
+		stats->EncodeMs = MillisecondsSince(start);
+		stats->RmsError = static_cast<float>(sqrt(topLevelError / samples));
+	}
+	return result;
+}
+
+bool BlockCompressor::CompressFile(const std::string& inputPath, const std::string& outputPath, InternalFormat format) {
+	Texture2DData::sptr image = Texture2DData::LoadFromFile(inputPath);
+	if (image == nullptr) {
+		return false;
+	}
+
+	Stats stats;
+	CompressedTextureData::sptr result = Compress(image, format, true, &stats);
+	const std::string path = outputPath.empty() ? GetCompressedPath(inputPath) : outputPath;
+	if (!result->SaveToKtx2(path)) {
+		return false;
+	}
+	LOG_INFO("Compressed \"{}\" ({}x{}) to {} in {:.1f} ms, {} mip levels, {} KB -> {} KB, RMS error {:.2f}",
+		inputPath, image->GetWidth(), image->GetHeight(), result->GetFormat(), stats.EncodeMs, result->GetLevelCount(),
+		image->GetDataSize() / 1024, result->GetDataSize() / 1024, stats.RmsError);
+	return true;
+}
+
+std::string BlockCompressor::GetCompressedPath(const std::string& sourcePath) {
+	return std::filesystem::path(sourcePath).replace_extension(".ktx2").string();
+}
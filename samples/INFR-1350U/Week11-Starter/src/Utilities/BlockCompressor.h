@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+
+#include "Graphics/CompressedTextureData.h"
+#include "Graphics/Texture2DData.h"
+
+/// <summary>
+/// Encodes images into the BCn block compressed formats on the CPU, so they take 4-8x less video memory and can be
+/// loaded without any decoding. Every 4x4 block is encoded independently, with the rows of blocks spread across the
+/// thread pool, and the search for the best palette entry for each pixel done four pixels at a time with SSE.
+///
+/// This is meant to be run ahead of time (see the --compress option in main), since encoding a large texture takes
+/// much longer than decoding a PNG. Endpoints are fit with a principal axis, then refined with least squares. For
+/// BC7 only mode 6 (a single RGBA line with 16 steps) is used, which keeps the encoder simple and fast but gives up
+/// some quality on blocks with several distinct colors
+/// </summary>
+class BlockCompressor
+{
+public:
+	struct Stats {
+		size_t Blocks;     // The number of blocks encoded, across all mip levels
+		double EncodeMs;   // The time spent encoding, including building the mip chain
+		float  RmsError;   // The root mean squared error per channel of the top level, out of 255
+	};
+
+	/// <summary>
+	/// Picks a compressed format for an image based on the channels it has. 1 and 2 channel images use BC4 and BC5,
+	/// RGB images use BC1, and RGBA images use BC7 (or BC1 if every pixel is opaque)
+	/// </summary>
+	/// <param name="image">The image to pick a format for, must have 8 bits per channel</param>
+	static InternalFormat ChooseFormat(const Texture2DData::sptr& image);
+
+	/// <summary>
+	/// Compresses an image, optionally generating a full chain of mip maps with a box filter first. The mip maps are
+	/// filtered the same way glGenerateTextureMipmap does for our uncompressed textures
+	/// </summary>
+	/// <param name="image">The image to compress, must have 8 bits per channel</param>
+	/// <param name="format">The format to compress to, or Unknown to use ChooseFormat</param>
+	/// <param name="generateMipMaps">True to generate and compress all of the mip levels, false for just the top level</param>
+	/// <param name="stats">If not null, receives stats about the encoding</param>
+	/// <returns>The compressed image</returns>
+	static CompressedTextureData::sptr Compress(const Texture2DData::sptr& image, InternalFormat format = InternalFormat::Unknown,
+		bool generateMipMaps = true, Stats* stats = nullptr);
+
+	/// <summary>
+	/// Loads an image, compresses it with a full mip chain and writes it to a KTX2 file
+	/// </summary>
+	/// <param name="inputPath">The path of the image to compress (any format STBI can load)</param>
+	/// <param name="outputPath">The path to write the KTX2 file to, or an empty string to use GetCompressedPath</param>
+	/// <param name="format">The format to compress to, or Unknown to use ChooseFormat</param>
+	/// <returns>True if the file was written, false if otherwise</returns>
+	static bool CompressFile(const std::string& inputPath, const std::string& outputPath = "", InternalFormat format = InternalFormat::Unknown);
+
+	/// <summary>
+	/// Gets the path that the compressed version of an image is stored at by default, the same path with a .ktx2 extension
+	/// </summary>
+	/// <param name="sourcePath">The path of the source image (ex: images/box.bmp)</param>
+	static std::string GetCompressedPath(const std::string& sourcePath);
+
+protected:
+	BlockCompressor() = default;
+	~BlockCompressor() = default;
+};
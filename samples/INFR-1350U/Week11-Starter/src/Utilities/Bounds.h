@@ -0,0 +1,105 @@
+#pragma once
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <GLM/glm.hpp>
+
+/// <summary>
+/// An axis aligned bounding box, stored as it's minimum and maximum corners. A default constructed box is empty
+/// (it's min is larger than it's max), so growing it by any point or box gives that point or box
+/// </summary>
+struct AABB {
+	glm::vec3 Min = glm::vec3(FLT_MAX);
+	glm::vec3 Max = glm::vec3(-FLT_MAX);
+
+	AABB() = default;
+	AABB(const glm::vec3& min, const glm::vec3& max) : Min(min), Max(max) {}
+
+	/// <summary>
+	/// Builds the box around a list of positions that are spaced out by stride bytes (ex: inside of a vertex buffer)
+	/// </summary>
+	/// <param name="positions">A pointer to the first position, as 3 floats</param>
+	/// <param name="count">The number of positions</param>
+	/// <param name="stride">The number of bytes from the start of one position to the next</param>
+	static AABB FromPoints(const void* positions, size_t count, size_t stride) {
+		AABB result;
+		const uint8_t* data = static_cast<const uint8_t*>(positions);
+		for (size_t ix = 0; ix < count; ix++) {
+			const float* position = reinterpret_cast<const float*>(data + ix * stride);
+			result.Grow(glm::vec3(position[0], position[1], position[2]));
+		}
+		return result;
+	}
+
+	bool IsEmpty() const { return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z; }
+	glm::vec3 GetCenter() const { return (Min + Max) * 0.5f; }
+	glm::vec3 GetExtents() const { return (Max - Min) * 0.5f; }
+	/// <summary>
+	/// Gets the surface area of the box, which is what the BVH tries to keep small when building it's tree
+	/// </summary>
+	float GetSurfaceArea() const {
+		const glm::vec3 size = Max - Min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	void Grow(const glm::vec3& point) {
+		Min = glm::min(Min, point);
+		Max = glm::max(Max, point);
+	}
+	void Grow(const AABB& other) {
+		Min = glm::min(Min, other.Min);
+		Max = glm::max(Max, other.Max);
+	}
+	static AABB Union(const AABB& a, const AABB& b) {
+		return AABB(glm::min(a.Min, b.Min), glm::max(a.Max, b.Max));
+	}
+	bool Contains(const AABB& other) const {
+		return glm::all(glm::lessThanEqual(Min, other.Min)) && glm::all(glm::greaterThanEqual(Max, other.Max));
+	}
+
+	/// <summary>
+	/// Gets the box around this box after it's been transformed by an affine matrix. The result is usually a bit
+	/// bigger than the transformed shape, but it's much cheaper than transforming all 8 corners
+	/// </summary>
+	/// <param name="transform">The affine transform to apply (ex: a world matrix)</param>
+	AABB Transformed(const glm::mat4& transform) const {
+		const glm::vec3 center = glm::vec3(transform * glm::vec4(GetCenter(), 1.0f));
+		const glm::vec3 extents = GetExtents();
+		// Each axis of the new box is stretched by how much each of our axes points along it
+		const glm::vec3 newExtents =
+			glm::abs(glm::vec3(transform[0])) * extents.x +
+			glm::abs(glm::vec3(transform[1])) * extents.y +
+			glm::abs(glm::vec3(transform[2])) * extents.z;
+		return AABB(center - newExtents, center + newExtents);
+	}
+};
+
+/// <summary>
+/// A sphere around some geometry
+/// </summary>
+struct BoundingSphere {
+	glm::vec3 Center = glm::vec3(0.0f);
+	float     Radius = 0.0f;
+
+	/// <summary>
+	/// Builds a sphere around a list of positions that are spaced out by stride bytes. The sphere is centered on the
+	/// middle of the given box, which is cheap and close enough for culling and LOD selection
+	/// </summary>
+	/// <param name="bounds">The box around the same positions</param>
+	/// <param name="positions">A pointer to the first position, as 3 floats</param>
+	/// <param name="count">The number of positions</param>
+	/// <param name="stride">The number of bytes from the start of one position to the next</param>
+	static BoundingSphere FromPoints(const AABB& bounds, const void* positions, size_t count, size_t stride) {
+		BoundingSphere result;
+		result.Center = bounds.GetCenter();
+		float radiusSq = 0.0f;
+		const uint8_t* data = static_cast<const uint8_t*>(positions);
+		for (size_t ix = 0; ix < count; ix++) {
+			const float* position = reinterpret_cast<const float*>(data + ix * stride);
+			const glm::vec3 offset = glm::vec3(position[0], position[1], position[2]) - result.Center;
+			radiusSq = glm::max(radiusSq, glm::dot(offset, offset));
+		}
+		result.Radius = glm::sqrt(radiusSq);
+		return result;
+	}
+};
@@ -0,0 +1,32 @@
+#include "Hash.h"
+
+#include <cstring>
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed) {
+	// We run four independent lanes over 8 byte words so that the multiplies can overlap, then fold them together.
+	// This is not a cryptographic hash, it just needs to tell us when something has changed
+	const uint64_t PRIME_A = 0x9E3779B97F4A7C15ull;
+	const uint64_t PRIME_B = 0xC2B2AE3D27D4EB4Full;
+	const char* bytes = static_cast<const char*>(data);
+	uint64_t lanes[4] = { seed ^ PRIME_A, seed ^ PRIME_B, seed + PRIME_A, seed - PRIME_B };
+
+	size_t offset = 0;
+	for (; offset + 32 <= size; offset += 32) {
+		for (int ix = 0; ix < 4; ix++) {
+			uint64_t word;
+			memcpy(&word, bytes + offset + ix * 8, 8);
+			lanes[ix] = (lanes[ix] ^ word) * PRIME_A;
+			lanes[ix] ^= lanes[ix] >> 31;
+		}
+	}
+
+	uint64_t result = size * PRIME_B;
+	for (int ix = 0; ix < 4; ix++) {
+		result = (result ^ lanes[ix]) * PRIME_B;
+		result ^= result >> 29;
+	}
+	for (; offset < size; offset++) {
+		result = (result ^ static_cast<uint8_t>(bytes[offset])) * PRIME_A;
+	}
+	return result ^ (result >> 32);
+}
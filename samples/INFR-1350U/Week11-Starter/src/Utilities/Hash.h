@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Hashes a block of memory. This is not a cryptographic hash, it's used by the asset caches to tell when a source
+/// file or some settings have changed
+/// </summary>
+/// <param name="data">The data to hash</param>
+/// <param name="size">The size of the data, in bytes</param>
+/// <param name="seed">A value to mix into the hash, used to keep hashes from different domains apart</param>
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
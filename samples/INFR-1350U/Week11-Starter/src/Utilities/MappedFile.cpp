@@ -0,0 +1,133 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() :
+	_data(nullptr),
+	_size(0),
+	_isOpen(false),
+	_fileHandle(nullptr),
+	_mappingHandle(nullptr)
+{ }
+
+MappedFile::MappedFile(const std::string& path) :
+	MappedFile()
+{
+	Open(path);
+}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path) {
+	Close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return false;
+	}
+
+	_fileHandle = file;
+	_size = static_cast<size_t>(size.QuadPart);
+	_isOpen = true;
+
+	// Windows will not let us create a mapping for an empty file, so we just leave the data pointer as null
+	if (_size > 0) {
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			Close();
+			return false;
+		}
+		_mappingHandle = mapping;
+		_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (_data == nullptr) {
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void MappedFile::Close() {
+	if (_data != nullptr) {
+		UnmapViewOfFile(_data);
+		_data = nullptr;
+	}
+	if (_mappingHandle != nullptr) {
+		CloseHandle(static_cast<HANDLE>(_mappingHandle));
+		_mappingHandle = nullptr;
+	}
+	if (_fileHandle != nullptr) {
+		CloseHandle(static_cast<HANDLE>(_fileHandle));
+		_fileHandle = nullptr;
+	}
+	_size = 0;
+	_isOpen = false;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path) {
+	Close();
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return false;
+	}
+
+	// We store the descriptor in the handle slot, offset by one so that descriptor 0 does not look like a null handle
+	_fileHandle = reinterpret_cast<void*>(static_cast<intptr_t>(fd) + 1);
+	_size = static_cast<size_t>(info.st_size);
+	_isOpen = true;
+
+	// mmap does not allow zero length mappings, so we just leave the data pointer as null
+	if (_size > 0) {
+		void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			Close();
+			return false;
+		}
+		madvise(data, _size, MADV_SEQUENTIAL);
+		_data = static_cast<const char*>(data);
+	}
+	return true;
+}
+
+void MappedFile::Close() {
+	if (_data != nullptr) {
+		munmap(const_cast<char*>(_data), _size);
+		_data = nullptr;
+	}
+	if (_fileHandle != nullptr) {
+		close(static_cast<int>(reinterpret_cast<intptr_t>(_fileHandle) - 1));
+		_fileHandle = nullptr;
+	}
+	_size = 0;
+	_isOpen = false;
+}
+
+#endif
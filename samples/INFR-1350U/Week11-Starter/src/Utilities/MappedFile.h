@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// Wraps around a read-only memory mapped file, allowing us to parse large files in place without
+/// first copying them into a stream or string
+/// </summary>
+class MappedFile final
+{
+public:
+	// We'll disallow moving and copying, since we want to manually control when the mapping is released
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile(MappedFile&& other) = delete;
+	MappedFile& operator=(const MappedFile& other) = delete;
+	MappedFile& operator=(MappedFile&& other) = delete;
+
+	MappedFile();
+	/// <summary>
+	/// Creates a new mapped file, and attempts to open the file at the given path
+	/// </summary>
+	/// <param name="path">The path of the file to map into memory</param>
+	MappedFile(const std::string& path);
+	~MappedFile();
+
+	/// <summary>
+	/// Maps the given file into memory, closing any file that was already mapped
+	/// </summary>
+	/// <param name="path">The path of the file to map into memory</param>
+	/// <returns>True if the file was opened and mapped, false if otherwise</returns>
+	bool Open(const std::string& path);
+	/// <summary>
+	/// Unmaps and closes the file, if one is open
+	/// </summary>
+	void Close();
+
+	/// <summary>
+	/// Returns true if this object has a file open (note that empty files are considered open, but will have a null data pointer)
+	/// </summary>
+	bool IsOpen() const { return _isOpen; }
+	/// <summary>
+	/// Gets a pointer to the first byte of the file, valid until the file is closed
+	/// </summary>
+	const char* GetData() const { return _data; }
+	/// <summary>
+	/// Gets the size of the file, in bytes
+	/// </summary>
+	size_t GetSize() const { return _size; }
+
+private:
+	const char* _data;
+	size_t      _size;
+	bool        _isOpen;
+
+	// Platform specific handles (file handle and mapping object on windows, file descriptor on POSIX)
+	void*       _fileHandle;
+	void*       _mappingHandle;
+};
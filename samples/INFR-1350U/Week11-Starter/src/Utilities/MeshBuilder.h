@@ -1,6 +1,9 @@
 #pragma once
 #include <vector>
+#include <cstdint>
 #include "Graphics/VertexArrayObject.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
 
 template <typename VertType>
 class MeshBuilder
@@ -43,7 +46,7 @@ public:
 	/// <param name="c">The index of the third vertex</param>
 	void AddIndexTri(uint32_t a, uint32_t b, uint32_t c)
 	{
-		ReserveIndexSpace(3);
+		// Note: we don't reserve here, reserving exact sizes would defeat the vector's geometric growth
 		_indices.push_back(a);
 		_indices.push_back(b);
 		_indices.push_back(c);
@@ -86,15 +89,67 @@ public:
 		vbo->LoadData(GetVertexDataPtr(), _vertices.size());
 
 		IndexBuffer::sptr ebo = IndexBuffer::Create();
-		ebo->LoadData(GetIndexDataPtr(), _indices.size());
+		// If every index fits in 16 bits, we can halve the size of the index buffer
+		if (_vertices.size() <= UINT16_MAX + 1ull) {
+			std::vector<uint16_t> shortIndices(_indices.begin(), _indices.end());
+			ebo->LoadData(shortIndices.data(), shortIndices.size());
+		} else {
+			ebo->LoadData(GetIndexDataPtr(), _indices.size());
+		}
 
 		VertexArrayObject::sptr result = VertexArrayObject::Create();
 		result->AddVertexBuffer(vbo, VertType::V_DECL);
 		result->SetIndexBuffer(ebo);
 
+		// Store the bounds so that the mesh can be culled
+		if (!_vertices.empty()) {
+			const AABB bounds = AABB::FromPoints(&_vertices.data()->Position, _vertices.size(), sizeof(VertType));
+			result->SetBounds(bounds, BoundingSphere::FromPoints(bounds, &_vertices.data()->Position, _vertices.size(), sizeof(VertType)));
+		}
+
 		return result;
 	}
 	
+	/// <summary>
+	/// Reorders the triangles in the mesh for better vertex cache usage, and then the vertices for better fetch
+	/// locality. This does not change how the mesh looks, so it can be done before baking or caching any mesh
+	/// </summary>
+	/// <param name="reduceOverdraw">True to also sort clusters of triangles to reduce overdraw, at a small cost to vertex cache usage</param>
+	/// <returns>The simulated vertex cache stats from before and after optimizing</returns>
+	MeshOptimizer::OptimizeReport Optimize(bool reduceOverdraw = false) {
+		MeshOptimizer::OptimizeReport result;
+		result.Before = MeshOptimizer::AnalyzeVertexCache(_indices.data(), _indices.size(), _vertices.size());
+
+		MeshOptimizer::OptimizeVertexCache(_indices.data(), _indices.size(), _vertices.size());
+		if (reduceOverdraw) {
+			MeshOptimizer::OptimizeOverdraw(_indices.data(), _indices.size(), &_vertices.data()->Position.x, sizeof(VertType), _vertices.size());
+		}
+
+		// Shuffle the vertices into the order they're first used in
+		const std::vector<uint32_t> order = MeshOptimizer::OptimizeVertexFetch(_indices.data(), _indices.size(), _vertices.size());
+		std::vector<VertType> vertices;
+		vertices.reserve(_vertices.size());
+		for (uint32_t index : order) {
+			vertices.push_back(_vertices[index]);
+		}
+		_vertices = std::move(vertices);
+
+		result.After = MeshOptimizer::AnalyzeVertexCache(_indices.data(), _indices.size(), _vertices.size());
+		return result;
+	}
+
+	/// <summary>
+	/// Writes the mesh to a binary cache file, which can be loaded much faster than the source asset using MeshCache::Load
+	/// </summary>
+	/// <param name="cachePath">The path of the cache file to write</param>
+	/// <param name="sourcePath">The source asset the mesh was built from, used to tell when the cache is out of date</param>
+	/// <param name="loaderKey">A key identifying the loader settings used to build the mesh</param>
+	/// <returns>True if the cache was written, false if otherwise</returns>
+	bool SaveCache(const std::string& cachePath, const std::string& sourcePath = "", uint64_t loaderKey = 0) const {
+		return MeshCache::Save(cachePath, sourcePath, loaderKey, _vertices.data(), sizeof(VertType), _vertices.size(),
+			VertType::V_DECL, _indices.data(), _indices.size());
+	}
+	
 	/// <summary>
 	/// Gets a pointer to the underlying vertex data in the mesh, valid only
 	/// until another call to AddVertex
@@ -112,6 +167,7 @@ public:
 	
 protected:
 	friend class MeshFactory;
+	friend class ObjLoader;
 	
 	std::vector<VertType> _vertices;
 	std::vector<uint32_t> _indices;
@@ -0,0 +1,247 @@
+#include "MeshCache.h"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "Logging.h"
+#include "Hash.h"
+#include "MappedFile.h"
+
+bool MeshCache::_isEnabled = true;
+
+namespace {
+	// Bump the version whenever the layout of the file changes, so that old caches get rebuilt
+	constexpr char     CACHE_MAGIC[4] = { 'M', 'S', 'H', 'C' };
+	constexpr uint32_t CACHE_VERSION = 1;
+	// Sections of the file start on 16 byte boundaries, so the mapped data is nicely aligned
+	constexpr uint64_t CACHE_ALIGNMENT = 16;
+
+	struct CacheHeader {
+		char     Magic[4];
+		uint32_t Version;
+		// Describes the source file that the mesh was built from
+		uint64_t SourceSize;
+		int64_t  SourceTime;
+		uint64_t SourceHash;
+		uint64_t LoaderKey;
+		// Describes the vertex data, which is followed by AttributeCount CacheAttributes
+		uint32_t VertexSize;
+		uint32_t AttributeCount;
+		uint64_t VertexCount;
+		uint64_t VertexOffset;
+		// Describes the index data
+		uint32_t IndexType;
+		uint32_t IndexSize;
+		uint64_t IndexCount;
+		uint64_t IndexOffset;
+	};
+
+	// A fixed size copy of BufferAttribute, since that struct's layout depends on the platform
+	struct CacheAttribute {
+		uint32_t Slot;
+		int32_t  Size;
+		uint32_t Type;
+		uint32_t Normalized;
+		int32_t  Stride;
+		uint32_t Usage;
+		uint64_t Offset;
+	};
+
+	inline uint64_t Align(uint64_t value) {
+		return (value + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+	}
+
+	/*
+	 * Gets the size and modification time of a file, without reading it
+	 * @returns True if the file exists, false if otherwise
+	 */
+	bool GetFileStamp(const std::string& path, uint64_t& size, int64_t& time) {
+		std::error_code error;
+		size = std::filesystem::file_size(path, error);
+		if (error) {
+			return false;
+		}
+		time = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+		return !error;
+	}
+
+	/*
+	 * Hashes the entire contents of a file
+	 * @returns True if the file could be read, false if otherwise
+	 */
+	bool HashFile(const std::string& path, uint64_t& hash) {
+		MappedFile file(path);
+		if (!file.IsOpen()) {
+			return false;
+		}
+		hash = HashBytes(file.GetData(), file.GetSize());
+		return true;
+	}
+}
+
+std::string MeshCache::GetCachePath(const std::string& sourcePath) {
+	return sourcePath + ".meshcache";
+}
+
+VertexArrayObject::sptr MeshCache::Load(const std::string& cachePath, const std::string& sourcePath, uint64_t loaderKey) {
+	MappedFile file(cachePath);
+	if (!file.IsOpen() || file.GetSize() < sizeof(CacheHeader)) {
+		return nullptr;
+	}
+
+	CacheHeader header;
+	memcpy(&header, file.GetData(), sizeof(CacheHeader));
+	if (memcmp(header.Magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.Version != CACHE_VERSION || header.LoaderKey != loaderKey) {
+		return nullptr;
+	}
+
+	// Make sure the sections actually fit in the file, in case it was truncated while being written
+	const uint64_t attributeEnd = sizeof(CacheHeader) + header.AttributeCount * sizeof(CacheAttribute);
+	if (attributeEnd > file.GetSize() ||
+		header.VertexOffset < attributeEnd || header.VertexOffset + header.VertexCount * header.VertexSize > file.GetSize() ||
+		header.IndexOffset + header.IndexCount * header.IndexSize > file.GetSize()) {
+		LOG_WARN("Mesh cache \"{}\" is corrupt, it will be rebuilt", cachePath);
+		return nullptr;
+	}
+
+	// If we know the source, make sure it hasn't changed since the cache was written. We only hash the source when the
+	// size matches but the timestamp does not (ex: the file was touched by version control, but has the same contents)
+	bool isTimeStale = false;
+	int64_t sourceTime = 0;
+	if (!sourcePath.empty()) {
+		uint64_t size;
+		if (!GetFileStamp(sourcePath, size, sourceTime) || size != header.SourceSize) {
+			return nullptr;
+		}
+		if (sourceTime != header.SourceTime) {
+			uint64_t hash;
+			if (!HashFile(sourcePath, hash) || hash != header.SourceHash) {
+				return nullptr;
+			}
+			isTimeStale = true;
+		}
+	}
+
+	std::vector<BufferAttribute> layout;
+	layout.reserve(header.AttributeCount);
+	const CacheAttribute* attributes = reinterpret_cast<const CacheAttribute*>(file.GetData() + sizeof(CacheHeader));
+	for (uint32_t ix = 0; ix < header.AttributeCount; ix++) {
+		const CacheAttribute& attrib = attributes[ix];
+		layout.emplace_back(attrib.Slot, attrib.Size, attrib.Type, attrib.Normalized != 0, attrib.Stride, attrib.Offset, static_cast<AttribUsage>(attrib.Usage));
+	}
+
+	// Upload straight out of the mapping, the OS will page the file in as the driver copies it
+	VertexBuffer::sptr vbo = VertexBuffer::Create();
+	vbo->LoadData(file.GetData() + header.VertexOffset, header.VertexSize, header.VertexCount);
+
+	IndexBuffer::sptr ebo = IndexBuffer::Create();
+	ebo->LoadData(file.GetData() + header.IndexOffset, header.IndexSize, header.IndexCount, header.IndexType);
+
+	VertexArrayObject::sptr result = VertexArrayObject::Create();
+	result->AddVertexBuffer(vbo, layout);
+	result->SetIndexBuffer(ebo);
+
+	// Work out the bounds from the positions, the same way MeshBuilder::Bake does
+	for (const BufferAttribute& attrib : layout) {
+		if (attrib.Usage == AttribUsage::Position && attrib.Type == GL_FLOAT && attrib.Size >= 3 && header.VertexCount > 0) {
+			const char* positions = file.GetData() + header.VertexOffset + attrib.Offset;
+			const AABB bounds = AABB::FromPoints(positions, header.VertexCount, header.VertexSize);
+			result->SetBounds(bounds, BoundingSphere::FromPoints(bounds, positions, header.VertexCount, header.VertexSize));
+			break;
+		}
+	}
+
+	// The contents matched but the timestamp did not, so we update the cache's timestamp to skip hashing next time
+	if (isTimeStale) {
+		file.Close();
+		std::fstream stream(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+		stream.seekp(offsetof(CacheHeader, SourceTime));
+		stream.write(reinterpret_cast<const char*>(&sourceTime), sizeof(int64_t));
+	}
+	return result;
+}
+
+bool MeshCache::Save(const std::string& cachePath, const std::string& sourcePath, uint64_t loaderKey,
+	const void* vertices, size_t vertexSize, size_t vertexCount, const std::vector<BufferAttribute>& layout,
+	const uint32_t* indices, size_t indexCount)
+{
+	CacheHeader header;
+	memset(&header, 0, sizeof(CacheHeader));
+	memcpy(header.Magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.Version = CACHE_VERSION;
+	header.LoaderKey = loaderKey;
+	if (!sourcePath.empty()) {
+		if (!GetFileStamp(sourcePath, header.SourceSize, header.SourceTime) || !HashFile(sourcePath, header.SourceHash)) {
+			LOG_WARN("Could not read \"{}\" to write its mesh cache", sourcePath);
+			return false;
+		}
+	}
+
+	// If every index fits in 16 bits, we can halve the size of the index buffer
+	const bool useShortIndices = vertexCount <= UINT16_MAX + 1ull;
+	std::vector<uint16_t> shortIndices;
+	if (useShortIndices) {
+		shortIndices.assign(indices, indices + indexCount);
+	}
+
+	header.VertexSize = static_cast<uint32_t>(vertexSize);
+	header.AttributeCount = static_cast<uint32_t>(layout.size());
+	header.VertexCount = vertexCount;
+	header.VertexOffset = Align(sizeof(CacheHeader) + layout.size() * sizeof(CacheAttribute));
+	header.IndexType = useShortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	header.IndexSize = useShortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+	header.IndexCount = indexCount;
+	header.IndexOffset = Align(header.VertexOffset + vertexCount * vertexSize);
+
+	// We write to a temporary file and then move it into place, so that a crash part way through can't leave behind
+	// a cache that looks valid
+	const std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			LOG_WARN("Could not open \"{}\" to write a mesh cache", tempPath);
+			return false;
+		}
+
+		const char padding[CACHE_ALIGNMENT] = { 0 };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+		for (const BufferAttribute& attrib : layout) {
+			CacheAttribute record;
+			record.Slot = attrib.Slot;
+			record.Size = attrib.Size;
+			record.Type = attrib.Type;
+			record.Normalized = attrib.Normalized ? 1 : 0;
+			record.Stride = attrib.Stride;
+			record.Usage = static_cast<uint32_t>(attrib.Usage);
+			record.Offset = attrib.Offset;
+			file.write(reinterpret_cast<const char*>(&record), sizeof(CacheAttribute));
+		}
+		file.write(padding, header.VertexOffset - (sizeof(CacheHeader) + layout.size() * sizeof(CacheAttribute)));
+		file.write(static_cast<const char*>(vertices), vertexCount * vertexSize);
+		file.write(padding, header.IndexOffset - (header.VertexOffset + vertexCount * vertexSize));
+		if (useShortIndices) {
+			file.write(reinterpret_cast<const char*>(shortIndices.data()), indexCount * sizeof(uint16_t));
+		} else {
+			file.write(reinterpret_cast<const char*>(indices), indexCount * sizeof(uint32_t));
+		}
+
+		if (!file) {
+			LOG_WARN("Failed to write mesh cache \"{}\"", tempPath);
+			file.close();
+			std::error_code error;
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error) {
+		LOG_WARN("Failed to move mesh cache into place at \"{}\": {}", cachePath, error.message());
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
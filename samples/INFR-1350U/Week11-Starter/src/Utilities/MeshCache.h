@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Graphics/VertexArrayObject.h"
+
+/// <summary>
+/// Handles reading and writing baked meshes in a simple binary format. A cache file stores the raw vertex and index data
+/// along with the vertex layout, so loading one is just a memory map and a buffer upload. Text loaders (like ObjLoader)
+/// store a cache next to their source file, and will use it on the next load if the source has not changed
+/// </summary>
+class MeshCache
+{
+public:
+	/// <summary>
+	/// Enables or disables the automatic caching performed by the mesh loaders (enabled by default)
+	/// </summary>
+	static void SetEnabled(bool enabled) { _isEnabled = enabled; }
+	/// <summary>
+	/// Returns true if loaders should read and write mesh caches
+	/// </summary>
+	static bool IsEnabled() { return _isEnabled; }
+
+	/// <summary>
+	/// Gets the path of the cache file for a source asset
+	/// </summary>
+	/// <param name="sourcePath">The path of the source asset (ex: models/monkey.obj)</param>
+	static std::string GetCachePath(const std::string& sourcePath);
+
+	/// <summary>
+	/// Loads a mesh from a cache file, uploading the data straight from the mapped file
+	/// </summary>
+	/// <param name="cachePath">The path of the cache file to load</param>
+	/// <param name="sourcePath">The source asset the cache was built from, or an empty string to skip checking if the cache is up to date</param>
+	/// <param name="loaderKey">A key identifying the loader settings used to build the cache, must match the key it was saved with</param>
+	/// <returns>The loaded mesh, or nullptr if the cache is missing, invalid or out of date</returns>
+	static VertexArrayObject::sptr Load(const std::string& cachePath, const std::string& sourcePath = "", uint64_t loaderKey = 0);
+
+	/// <summary>
+	/// Writes a mesh to a cache file. Indices are stored as 16 bit values if every vertex can be addressed that way,
+	/// matching what MeshBuilder::Bake will upload
+	/// </summary>
+	/// <param name="cachePath">The path of the cache file to write</param>
+	/// <param name="sourcePath">The source asset the mesh was built from, or an empty string if there is none</param>
+	/// <param name="loaderKey">A key identifying the loader settings used to build the mesh</param>
+	/// <param name="vertices">A pointer to the vertex data</param>
+	/// <param name="vertexSize">The size of a single vertex, in bytes</param>
+	/// <param name="vertexCount">The number of vertices</param>
+	/// <param name="layout">The attribute layout for the vertices (ex: VertexPosNormTexCol::V_DECL)</param>
+	/// <param name="indices">A pointer to the index data</param>
+	/// <param name="indexCount">The number of indices</param>
+	/// <returns>True if the file was written, false if otherwise</returns>
+	static bool Save(const std::string& cachePath, const std::string& sourcePath, uint64_t loaderKey,
+		const void* vertices, size_t vertexSize, size_t vertexCount, const std::vector<BufferAttribute>& layout,
+		const uint32_t* indices, size_t indexCount);
+
+protected:
+	MeshCache() = default;
+	~MeshCache() = default;
+
+	static bool _isEnabled;
+};
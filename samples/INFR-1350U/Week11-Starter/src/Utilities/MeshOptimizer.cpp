@@ -0,0 +1,282 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <GLM/glm.hpp>
+
+namespace {
+	// Tuning values for the Forsyth scoring function, these are the values from the original article
+	constexpr int   FORSYTH_CACHE_SIZE = 32;
+	constexpr float CACHE_DECAY_POWER = 1.5f;
+	constexpr float LAST_TRI_SCORE = 0.75f;
+	constexpr float VALENCE_BOOST_SCALE = 2.0f;
+	constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+	/*
+	 * Scores a vertex based on where it sits in the simulated cache, and how many triangles still need it. Vertices
+	 * used by the last triangle get a fixed score (so we don't just keep grabbing the same triangles), and vertices
+	 * with only a few remaining triangles get a boost so that we don't leave lonely triangles behind
+	 */
+	float ScoreVertex(int cachePosition, uint32_t remainingTriangles) {
+		if (remainingTriangles == 0) {
+			return -1.0f;
+		}
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			if (cachePosition < 3) {
+				score = LAST_TRI_SCORE;
+			} else {
+				const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+				score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+			}
+		}
+		return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+	}
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t cacheSize) {
+	CacheStats result;
+	if (indexCount < 3 || vertexCount == 0) {
+		return result;
+	}
+
+	// We store the time each vertex entered the cache, a vertex is still cached if fewer than cacheSize vertices have
+	// been added since. This is exactly a FIFO cache, without having to shift anything around
+	std::vector<size_t> timestamps(vertexCount, 0);
+	size_t time = cacheSize + 1;
+	for (size_t ix = 0; ix < indexCount; ix++) {
+		const uint32_t vertex = indices[ix];
+		if (time - timestamps[vertex] > cacheSize) {
+			timestamps[vertex] = time++;
+			result.VerticesTransformed++;
+		}
+	}
+
+	result.ACMR = static_cast<float>(result.VerticesTransformed) / (indexCount / 3);
+	result.ATVR = static_cast<float>(result.VerticesTransformed) / vertexCount;
+	return result;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Build the list of triangles that use each vertex, we'll shrink these as triangles get added
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (size_t ix = 0; ix < triangleCount * 3; ix++) {
+		remaining[indices[ix]]++;
+	}
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t ix = 0; ix < vertexCount; ix++) {
+		adjacencyOffsets[ix + 1] = adjacencyOffsets[ix] + remaining[ix];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t ix = 0; ix < triangleCount * 3; ix++) {
+			adjacency[fill[indices[ix]]++] = static_cast<uint32_t>(ix / 3);
+		}
+	}
+
+	std::vector<int>   cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t ix = 0; ix < vertexCount; ix++) {
+		vertexScores[ix] = ScoreVertex(-1, remaining[ix]);
+	}
+	std::vector<float> triangleScores(triangleCount);
+	for (size_t ix = 0; ix < triangleCount; ix++) {
+		triangleScores[ix] = vertexScores[indices[ix * 3]] + vertexScores[indices[ix * 3 + 1]] + vertexScores[indices[ix * 3 + 2]];
+	}
+	std::vector<bool> isAdded(triangleCount, false);
+
+	// The simulated cache holds 3 extra entries, so the vertices pushed out by a new triangle can still be rescored
+	uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+	uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+
+	std::vector<uint32_t> result(triangleCount * 3);
+	size_t nextUnadded = 0;
+	int64_t bestTriangle = -1;
+
+	for (size_t output = 0; output < triangleCount; output++) {
+		// If nothing in the cache has triangles left, we start again from the next triangle in the original order
+		if (bestTriangle < 0) {
+			while (isAdded[nextUnadded]) {
+				nextUnadded++;
+			}
+			bestTriangle = static_cast<int64_t>(nextUnadded);
+		}
+
+		const uint32_t* triangle = indices + bestTriangle * 3;
+		isAdded[bestTriangle] = true;
+		result[output * 3] = triangle[0];
+		result[output * 3 + 1] = triangle[1];
+		result[output * 3 + 2] = triangle[2];
+
+		// Remove the triangle from each of its vertex's adjacency lists
+		for (int ix = 0; ix < 3; ix++) {
+			const uint32_t vertex = triangle[ix];
+			uint32_t* list = adjacency.data() + adjacencyOffsets[vertex];
+			const uint32_t count = remaining[vertex];
+			for (uint32_t jx = 0; jx < count; jx++) {
+				if (list[jx] == bestTriangle) {
+					list[jx] = list[count - 1];
+					break;
+				}
+			}
+			remaining[vertex]--;
+		}
+
+		// Push the triangle's vertices to the front of the cache (checking for degenerate triangles)
+		int newCount = 0;
+		newCache[newCount++] = triangle[0];
+		if (triangle[1] != triangle[0]) {
+			newCache[newCount++] = triangle[1];
+		}
+		if (triangle[2] != triangle[0] && triangle[2] != triangle[1]) {
+			newCache[newCount++] = triangle[2];
+		}
+		for (int ix = 0; ix < cacheCount; ix++) {
+			const uint32_t vertex = cache[ix];
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+				newCache[newCount++] = vertex;
+			}
+		}
+		cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+
+		// Rescore everything that was touched
+		for (int ix = 0; ix < newCount; ix++) {
+			const uint32_t vertex = newCache[ix];
+			cachePositions[vertex] = ix < FORSYTH_CACHE_SIZE ? ix : -1;
+			const float score = ScoreVertex(cachePositions[vertex], remaining[vertex]);
+			const float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+
+			const uint32_t* list = adjacency.data() + adjacencyOffsets[vertex];
+			for (uint32_t jx = 0; jx < remaining[vertex]; jx++) {
+				triangleScores[list[jx]] += delta;
+			}
+		}
+
+		// Then pick the best triangle that uses one of the cached vertices
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (int ix = 0; ix < cacheCount; ix++) {
+			const uint32_t vertex = newCache[ix];
+			const uint32_t* list = adjacency.data() + adjacencyOffsets[vertex];
+			for (uint32_t jx = 0; jx < remaining[vertex]; jx++) {
+				if (triangleScores[list[jx]] > bestScore) {
+					bestScore = triangleScores[list[jx]];
+					bestTriangle = list[jx];
+				}
+			}
+		}
+		std::copy(newCache, newCache + cacheCount, cache);
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount) {
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+	auto position = [&](uint32_t vertex) {
+		const float* value = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * positionStride);
+		return glm::vec3(value[0], value[1], value[2]);
+	};
+
+	// Split the triangles into clusters wherever the simulated cache has to start over (all 3 vertices miss), that way
+	// moving the clusters around costs us almost nothing in vertex cache efficiency
+	const size_t cacheSize = 16;
+	std::vector<size_t> timestamps(vertexCount, 0);
+	size_t time = cacheSize + 1;
+	std::vector<size_t> clusterStarts;
+	for (size_t tri = 0; tri < triangleCount; tri++) {
+		int misses = 0;
+		for (int ix = 0; ix < 3; ix++) {
+			const uint32_t vertex = indices[tri * 3 + ix];
+			if (time - timestamps[vertex] > cacheSize) {
+				timestamps[vertex] = time++;
+				misses++;
+			}
+		}
+		if (misses == 3 || tri == 0) {
+			clusterStarts.push_back(tri);
+		}
+	}
+	clusterStarts.push_back(triangleCount);
+	const size_t clusterCount = clusterStarts.size() - 1;
+
+	// Find the area weighted center and normal of each cluster, and of the mesh as a whole
+	std::vector<glm::vec3> clusterCenters(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+	glm::vec3 meshCenter = glm::vec3(0.0f);
+	float meshArea = 0.0f;
+	for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+		float clusterArea = 0.0f;
+		for (size_t tri = clusterStarts[cluster]; tri < clusterStarts[cluster + 1]; tri++) {
+			const glm::vec3 a = position(indices[tri * 3]);
+			const glm::vec3 b = position(indices[tri * 3 + 1]);
+			const glm::vec3 c = position(indices[tri * 3 + 2]);
+			const glm::vec3 normal = glm::cross(b - a, c - a);
+			const float area = glm::length(normal);
+			clusterCenters[cluster] += (a + b + c) * (area / 3.0f);
+			clusterNormals[cluster] += normal;
+			clusterArea += area;
+		}
+		meshCenter += clusterCenters[cluster];
+		meshArea += clusterArea;
+		clusterCenters[cluster] = clusterArea > 0.0f ? clusterCenters[cluster] / clusterArea : position(indices[clusterStarts[cluster] * 3]);
+	}
+	meshCenter = meshArea > 0.0f ? meshCenter / meshArea : glm::vec3(0.0f);
+
+	// Clusters that face away from the center are more likely to be in front of others, so we want to draw them first
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+		const float length = glm::length(clusterNormals[cluster]);
+		const glm::vec3 normal = length > 0.0f ? clusterNormals[cluster] / length : glm::vec3(0.0f);
+		sortKeys[cluster] = glm::dot(clusterCenters[cluster] - meshCenter, normal);
+	}
+	std::vector<uint32_t> order(clusterCount);
+	for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+		order[cluster] = static_cast<uint32_t>(cluster);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+	for (uint32_t cluster : order) {
+		result.insert(result.end(), indices + clusterStarts[cluster] * 3, indices + clusterStarts[cluster + 1] * 3);
+	}
+	std::copy(result.begin(), result.end(), indices);
+}
+
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+	const uint32_t UNUSED = UINT32_MAX;
+	std::vector<uint32_t> newIndices(vertexCount, UNUSED);
+	std::vector<uint32_t> result;
+	result.reserve(vertexCount);
+
+	// Number each vertex in the order it first appears in the index buffer
+	for (size_t ix = 0; ix < indexCount; ix++) {
+		uint32_t& newIndex = newIndices[indices[ix]];
+		if (newIndex == UNUSED) {
+			newIndex = static_cast<uint32_t>(result.size());
+			result.push_back(indices[ix]);
+		}
+		indices[ix] = newIndex;
+	}
+
+	// Keep any vertices that aren't referenced, so that the vertex count doesn't change
+	for (size_t ix = 0; ix < vertexCount; ix++) {
+		if (newIndices[ix] == UNUSED) {
+			result.push_back(static_cast<uint32_t>(ix));
+		}
+	}
+	return result;
+}
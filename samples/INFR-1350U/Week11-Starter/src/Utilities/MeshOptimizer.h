@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Tools for reordering the triangles and vertices of an indexed mesh so that the GPU can render it more efficiently.
+/// These all work on raw index arrays, see MeshBuilder::Optimize for the easy way to use them
+/// </summary>
+class MeshOptimizer
+{
+public:
+	/// <summary>
+	/// The results of simulating the post-transform vertex cache over an index buffer
+	/// </summary>
+	struct CacheStats {
+		/// <summary>
+		/// The number of vertices that had to be transformed (ie: cache misses)
+		/// </summary>
+		size_t VerticesTransformed = 0;
+		/// <summary>
+		/// Average cache miss ratio, the number of vertices transformed per triangle (lower is better, 0.5 is the best case for a grid)
+		/// </summary>
+		float ACMR = 0.0f;
+		/// <summary>
+		/// Average transform to vertex ratio, the number of vertices transformed per vertex in the mesh (lower is better, 1.0 is ideal)
+		/// </summary>
+		float ATVR = 0.0f;
+	};
+
+	/// <summary>
+	/// The simulated vertex cache results for a mesh before and after it was optimized
+	/// </summary>
+	struct OptimizeReport {
+		CacheStats Before;
+		CacheStats After;
+	};
+
+	/// <summary>
+	/// Simulates a FIFO post-transform vertex cache on the CPU, to measure how well an index buffer will use it
+	/// </summary>
+	/// <param name="indices">The index buffer to analyze, must be a triangle list</param>
+	/// <param name="indexCount">The number of indices in the buffer</param>
+	/// <param name="vertexCount">The number of vertices in the mesh</param>
+	/// <param name="cacheSize">The number of entries in the simulated cache</param>
+	static CacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t cacheSize = 16);
+
+	/// <summary>
+	/// Reorders triangles so that vertices are reused while they are still in the post-transform cache, using
+	/// Tom Forsyth's linear-speed vertex cache optimization
+	/// </summary>
+	/// <param name="indices">The index buffer to reorder in place, must be a triangle list</param>
+	/// <param name="indexCount">The number of indices in the buffer</param>
+	/// <param name="vertexCount">The number of vertices in the mesh</param>
+	static void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+	/// <summary>
+	/// Reorders clusters of triangles so that those facing outwards from the center of the mesh are drawn first, which
+	/// lets the depth test reject more of the hidden fragments. Clusters are split where the vertex cache would restart
+	/// anyways, so this should be run after OptimizeVertexCache and will not hurt its results much
+	/// </summary>
+	/// <param name="indices">The index buffer to reorder in place, must be a triangle list</param>
+	/// <param name="indexCount">The number of indices in the buffer</param>
+	/// <param name="positions">A pointer to the position of the first vertex, positions must be 3 floats</param>
+	/// <param name="positionStride">The number of bytes between the positions of two vertices</param>
+	/// <param name="vertexCount">The number of vertices in the mesh</param>
+	static void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount);
+
+	/// <summary>
+	/// Calculates a new order for the vertices in a mesh so that they are stored in the order they are first used,
+	/// improving the locality of vertex fetches. The index buffer is updated to match, and unused vertices are moved to the end
+	/// </summary>
+	/// <param name="indices">The index buffer to remap in place</param>
+	/// <param name="indexCount">The number of indices in the buffer</param>
+	/// <param name="vertexCount">The number of vertices in the mesh</param>
+	/// <returns>For each new vertex index, the index of the vertex in the original order</returns>
+	static std::vector<uint32_t> OptimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+protected:
+	MeshOptimizer() = default;
+	~MeshOptimizer() = default;
+};
@@ -0,0 +1,352 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+	constexpr uint32_t NONE = UINT32_MAX;
+
+	/*
+	 * A quadric stores the sum of squared distances to a set of planes as a symmetric 4x4 matrix. We also track the
+	 * total weight of the planes, so that we can turn the error back into an average distance
+	 */
+	struct Quadric {
+		double A2, AB, AC, AD, B2, BC, BD, C2, CD, D2;
+		double Weight;
+
+		Quadric() : A2(0), AB(0), AC(0), AD(0), B2(0), BC(0), BD(0), C2(0), CD(0), D2(0), Weight(0) { }
+
+		void AddPlane(const glm::dvec3& normal, double distance, double weight) {
+			A2 += normal.x * normal.x * weight; AB += normal.x * normal.y * weight; AC += normal.x * normal.z * weight; AD += normal.x * distance * weight;
+			B2 += normal.y * normal.y * weight; BC += normal.y * normal.z * weight; BD += normal.y * distance * weight;
+			C2 += normal.z * normal.z * weight; CD += normal.z * distance * weight;
+			D2 += distance * distance * weight;
+			Weight += weight;
+		}
+
+		Quadric& operator +=(const Quadric& other) {
+			A2 += other.A2; AB += other.AB; AC += other.AC; AD += other.AD;
+			B2 += other.B2; BC += other.BC; BD += other.BD;
+			C2 += other.C2; CD += other.CD;
+			D2 += other.D2;
+			Weight += other.Weight;
+			return *this;
+		}
+
+		/*
+		 * Gets the weighted sum of squared distances from the point to all of the planes in the quadric
+		 */
+		double Evaluate(const glm::dvec3& p) const {
+			const double result =
+				A2 * p.x * p.x + 2 * AB * p.x * p.y + 2 * AC * p.x * p.z + 2 * AD * p.x +
+				B2 * p.y * p.y + 2 * BC * p.y * p.z + 2 * BD * p.y +
+				C2 * p.z * p.z + 2 * CD * p.z +
+				D2;
+			return std::max(result, 0.0);
+		}
+	};
+
+	struct Collapse {
+		uint32_t From;
+		uint32_t To;
+		double   Cost;
+	};
+
+	inline glm::dvec3 TriangleNormal(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c) {
+		return glm::cross(b - a, c - a);
+	}
+}
+
+MeshSimplifier::SimplifiedMesh MeshSimplifier::Simplify(const MeshBuilder<VertexPosNormTexCol>& mesh, float targetRatio) {
+	const VertexPosNormTexCol* vertices = mesh.GetVertexDataPtr();
+	const size_t vertexCount = mesh.GetVertexCount();
+	const size_t triangleCount = mesh.GetIndexCount() / 3;
+	const size_t targetCount = static_cast<size_t>(std::max(0.0f, targetRatio) * triangleCount);
+
+	// Vertices that only differ by their normal or UV are copies of the same point on the surface. We'll call these
+	// copies "wedges", and do all of our topology work on the shared positions instead
+	std::vector<uint32_t> wedgePositions(vertexCount);
+	std::vector<glm::dvec3> positions;
+	std::vector<uint32_t> wedgeCounts;
+	{
+		std::vector<uint32_t> order(vertexCount);
+		for (size_t ix = 0; ix < vertexCount; ix++) {
+			order[ix] = static_cast<uint32_t>(ix);
+		}
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return memcmp(&vertices[a].Position, &vertices[b].Position, sizeof(glm::vec3)) < 0;
+		});
+		uint32_t groupCount = 0;
+		for (size_t ix = 0; ix < vertexCount; ix++) {
+			if (ix > 0 && memcmp(&vertices[order[ix]].Position, &vertices[order[ix - 1]].Position, sizeof(glm::vec3)) != 0) {
+				groupCount++;
+			}
+			wedgePositions[order[ix]] = groupCount;
+		}
+
+		// Number the positions in the order the vertices use them, so that our working data has the same locality as the mesh
+		std::vector<uint32_t> groupPositions(vertexCount > 0 ? groupCount + 1 : 0, NONE);
+		for (size_t ix = 0; ix < vertexCount; ix++) {
+			uint32_t& position = groupPositions[wedgePositions[ix]];
+			if (position == NONE) {
+				position = static_cast<uint32_t>(positions.size());
+				positions.push_back(glm::dvec3(vertices[ix].Position));
+				wedgeCounts.push_back(0);
+			}
+			wedgePositions[ix] = position;
+			wedgeCounts[position]++;
+		}
+	}
+	const size_t positionCount = positions.size();
+
+	std::vector<uint32_t> triangles(mesh.GetIndexDataPtr(), mesh.GetIndexDataPtr() + triangleCount * 3);
+	std::vector<bool> isTriangleAlive(triangleCount, true);
+	size_t aliveCount = triangleCount;
+	auto cornerPosition = [&](size_t triangle, int corner) { return wedgePositions[triangles[triangle * 3 + corner]]; };
+
+	// Lock any position that sits on a seam (has more than one wedge), or on a border or non-manifold edge
+	std::vector<bool> isLocked(positionCount, false);
+	for (size_t ix = 0; ix < positionCount; ix++) {
+		isLocked[ix] = wedgeCounts[ix] > 1;
+	}
+	{
+		std::vector<uint64_t> edges;
+		edges.reserve(triangleCount * 3);
+		for (size_t tri = 0; tri < triangleCount; tri++) {
+			for (int corner = 0; corner < 3; corner++) {
+				const uint64_t a = cornerPosition(tri, corner);
+				const uint64_t b = cornerPosition(tri, (corner + 1) % 3);
+				edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t ix = 0; ix < edges.size(); ) {
+			size_t end = ix + 1;
+			while (end < edges.size() && edges[end] == edges[ix]) {
+				end++;
+			}
+			if (end - ix != 2) {
+				isLocked[edges[ix] >> 32] = true;
+				isLocked[edges[ix] & 0xFFFFFFFF] = true;
+			}
+			ix = end;
+		}
+	}
+
+	// Every position starts with the planes of the triangles around it, weighted by area
+	std::vector<Quadric> quadrics(positionCount);
+	for (size_t tri = 0; tri < triangleCount; tri++) {
+		const glm::dvec3& a = positions[cornerPosition(tri, 0)];
+		const glm::dvec3 normal = TriangleNormal(a, positions[cornerPosition(tri, 1)], positions[cornerPosition(tri, 2)]);
+		const double length = glm::length(normal);
+		if (length <= 0.0) {
+			continue;
+		}
+		const glm::dvec3 unitNormal = normal / length;
+		const double distance = -glm::dot(unitNormal, a);
+		for (int corner = 0; corner < 3; corner++) {
+			quadrics[cornerPosition(tri, corner)].AddPlane(unitNormal, distance, length * 0.5);
+		}
+	}
+
+	std::vector<bool> isPositionAlive(positionCount, true);
+	std::vector<uint32_t> aliveTriangles(triangleCount);
+	for (size_t ix = 0; ix < triangleCount; ix++) {
+		aliveTriangles[ix] = static_cast<uint32_t>(ix);
+	}
+	std::vector<uint32_t> adjacencyOffsets(positionCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<bool> isTouched(positionCount);
+	double maxError = 0.0;
+
+	// We collapse in passes, each pass picks the cheapest collapses that don't overlap with each other. This is a lot
+	// simpler (and faster) than keeping a priority queue up to date as the mesh changes
+	while (aliveCount > targetCount) {
+		// Build the list of live triangles around each position
+		aliveTriangles.erase(std::remove_if(aliveTriangles.begin(), aliveTriangles.end(), [&](uint32_t tri) { return !isTriangleAlive[tri]; }), aliveTriangles.end());
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (uint32_t tri : aliveTriangles) {
+			for (int corner = 0; corner < 3; corner++) {
+				adjacencyOffsets[cornerPosition(tri, corner) + 1]++;
+			}
+		}
+		for (size_t ix = 0; ix < positionCount; ix++) {
+			adjacencyOffsets[ix + 1] += adjacencyOffsets[ix];
+		}
+		adjacency.resize(adjacencyOffsets[positionCount]);
+		{
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t tri : aliveTriangles) {
+				for (int corner = 0; corner < 3; corner++) {
+					adjacency[fill[cornerPosition(tri, corner)]++] = tri;
+				}
+			}
+		}
+
+		// Find the cheapest edge to collapse each unlocked position along. We only ever move a vertex onto one of
+		// its neighbours, so we never have to make up new attributes
+		collapses.clear();
+		for (uint32_t from = 0; from < positionCount; from++) {
+			if (isLocked[from] || !isPositionAlive[from]) {
+				continue;
+			}
+			Collapse best = { from, NONE, 0.0 };
+			for (uint32_t ix = adjacencyOffsets[from]; ix < adjacencyOffsets[from + 1]; ix++) {
+				for (int corner = 0; corner < 3; corner++) {
+					const uint32_t to = cornerPosition(adjacency[ix], corner);
+					if (to == from) {
+						continue;
+					}
+					Quadric combined = quadrics[from];
+					combined += quadrics[to];
+					const double cost = combined.Evaluate(positions[to]);
+					if (best.To == NONE || cost < best.Cost) {
+						best.To = to;
+						best.Cost = cost;
+					}
+				}
+			}
+			if (best.To != NONE) {
+				collapses.push_back(best);
+			}
+		}
+		if (collapses.empty()) {
+			break;
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Cost < b.Cost; });
+
+		// Each collapse removes about two triangles, so we don't want to do more than this many before re-checking
+		const size_t collapseLimit = (aliveCount - targetCount + 1) / 2;
+		size_t collapseCount = 0;
+		std::fill(isTouched.begin(), isTouched.end(), false);
+		for (const Collapse& collapse : collapses) {
+			if (collapseCount >= collapseLimit) {
+				break;
+			}
+			if (isTouched[collapse.From] || isTouched[collapse.To]) {
+				continue;
+			}
+
+			// Make sure the collapse won't flip any triangles over, and find out which of the target's wedges we
+			// should use (since we're not on a seam, every triangle around us uses the same one)
+			uint32_t targetWedge = NONE;
+			bool isValid = true;
+			for (uint32_t ix = adjacencyOffsets[collapse.From]; ix < adjacencyOffsets[collapse.From + 1] && isValid; ix++) {
+				const uint32_t tri = adjacency[ix];
+				glm::dvec3 corners[3];
+				bool hasTarget = false;
+				for (int corner = 0; corner < 3; corner++) {
+					const uint32_t position = cornerPosition(tri, corner);
+					if (position == collapse.To) {
+						hasTarget = true;
+						targetWedge = targetWedge == NONE ? triangles[tri * 3 + corner] : targetWedge;
+					}
+					corners[corner] = positions[position];
+				}
+				if (hasTarget) {
+					continue;
+				}
+				const glm::dvec3 before = TriangleNormal(corners[0], corners[1], corners[2]);
+				for (int corner = 0; corner < 3; corner++) {
+					if (cornerPosition(tri, corner) == collapse.From) {
+						corners[corner] = positions[collapse.To];
+					}
+				}
+				const glm::dvec3 after = TriangleNormal(corners[0], corners[1], corners[2]);
+				isValid = glm::dot(before, after) > 0.0;
+			}
+			if (!isValid || targetWedge == NONE) {
+				continue;
+			}
+
+			// Move every triangle onto the target, removing the ones that become degenerate
+			for (uint32_t ix = adjacencyOffsets[collapse.From]; ix < adjacencyOffsets[collapse.From + 1]; ix++) {
+				const uint32_t tri = adjacency[ix];
+				bool hasTarget = false;
+				for (int corner = 0; corner < 3; corner++) {
+					const uint32_t position = cornerPosition(tri, corner);
+					hasTarget |= position == collapse.To;
+					isTouched[position] = true;
+				}
+				if (hasTarget) {
+					isTriangleAlive[tri] = false;
+					aliveCount--;
+				} else {
+					for (int corner = 0; corner < 3; corner++) {
+						if (cornerPosition(tri, corner) == collapse.From) {
+							triangles[tri * 3 + corner] = targetWedge;
+						}
+					}
+				}
+			}
+			quadrics[collapse.To] += quadrics[collapse.From];
+			isPositionAlive[collapse.From] = false;
+			maxError = std::max(maxError, quadrics[collapse.To].Weight > 0.0 ? collapse.Cost / quadrics[collapse.To].Weight : 0.0);
+			collapseCount++;
+		}
+		if (collapseCount == 0) {
+			break;
+		}
+	}
+
+	// Copy the surviving triangles out, keeping only the vertices they use (in their original order)
+	SimplifiedMesh result;
+	result.Error = static_cast<float>(std::sqrt(maxError));
+	std::vector<uint32_t> newIndices(vertexCount, NONE);
+	for (size_t tri = 0; tri < triangleCount; tri++) {
+		if (isTriangleAlive[tri]) {
+			for (int corner = 0; corner < 3; corner++) {
+				newIndices[triangles[tri * 3 + corner]] = 0;
+			}
+		}
+	}
+	result.Mesh.ReserveIndexSpace(aliveCount * 3);
+	for (size_t ix = 0; ix < vertexCount; ix++) {
+		if (newIndices[ix] != NONE) {
+			newIndices[ix] = result.Mesh.AddVertex(vertices[ix]);
+		}
+	}
+	for (size_t tri = 0; tri < triangleCount; tri++) {
+		if (isTriangleAlive[tri]) {
+			result.Mesh.AddIndexTri(newIndices[triangles[tri * 3]], newIndices[triangles[tri * 3 + 1]], newIndices[triangles[tri * 3 + 2]]);
+		}
+	}
+	return result;
+}
+
+std::vector<MeshSimplifier::SimplifiedMesh> MeshSimplifier::GenerateLods(const MeshBuilder<VertexPosNormTexCol>& mesh, const std::vector<float>& ratios) {
+	std::vector<SimplifiedMesh> result;
+	result.reserve(ratios.size());
+	const float triangleCount = static_cast<float>(mesh.GetTriangleCount());
+	for (float ratio : ratios) {
+		// Simplifying from the previous level is much faster than starting from the full mesh every time
+		const MeshBuilder<VertexPosNormTexCol>& source = result.empty() ? mesh : result.back().Mesh;
+		const float sourceError = result.empty() ? 0.0f : result.back().Error;
+		const float sourceCount = static_cast<float>(source.GetTriangleCount());
+		SimplifiedMesh level = Simplify(source, sourceCount > 0.0f ? ratio * triangleCount / sourceCount : 0.0f);
+		level.Error = std::max(level.Error, sourceError);
+		result.push_back(std::move(level));
+	}
+	return result;
+}
+
+float MeshSimplifier::CalculateBoundingRadius(const MeshBuilder<VertexPosNormTexCol>& mesh) {
+	float result = 0.0f;
+	const VertexPosNormTexCol* vertices = mesh.GetVertexDataPtr();
+	for (size_t ix = 0; ix < mesh.GetVertexCount(); ix++) {
+		result = std::max(result, glm::dot(vertices[ix].Position, vertices[ix].Position));
+	}
+	return std::sqrt(result);
+}
+
+float MeshSimplifier::CalculateLodScreenSize(float error, float radius, float pixelError, float screenHeight) {
+	// An object covering a fraction S of the screen's height shows its error at roughly (error / diameter) * S * height
+	// pixels, so we solve for the S where that hits our pixel limit
+	if (error <= 0.0f) {
+		return std::numeric_limits<float>::max();
+	}
+	return (2.0f * radius * pixelError) / (error * screenHeight);
+}
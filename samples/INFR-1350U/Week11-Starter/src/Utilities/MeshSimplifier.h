@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+
+#include "MeshBuilder.h"
+#include "VertexTypes.h"
+
+/// <summary>
+/// Reduces the number of triangles in a mesh using quadric error metrics (Garland and Heckbert), so that we can draw
+/// far away objects with less detail. Vertices on UV or normal seams, and on the open borders of a mesh, are never
+/// removed, so textures and hard edges stay intact
+/// </summary>
+class MeshSimplifier
+{
+public:
+	/// <summary>
+	/// A simplified version of a mesh, along with how far it strays from the original
+	/// </summary>
+	struct SimplifiedMesh {
+		MeshBuilder<VertexPosNormTexCol> Mesh;
+		/// <summary>
+		/// The approximate (RMS) distance between the simplified surface and the original, in model space units
+		/// </summary>
+		float Error = 0.0f;
+	};
+
+	/// <summary>
+	/// Simplifies a mesh down to a target fraction of its triangles. The result may have more triangles than requested
+	/// if there are no more vertices that can be removed safely
+	/// </summary>
+	/// <param name="mesh">The mesh to simplify, must be a triangle list</param>
+	/// <param name="targetRatio">The fraction of triangles to keep (ex: 0.25 to keep a quarter of the triangles)</param>
+	static SimplifiedMesh Simplify(const MeshBuilder<VertexPosNormTexCol>& mesh, float targetRatio);
+
+	/// <summary>
+	/// Generates a chain of LODs for a mesh, where each level is simplified from the one before it
+	/// </summary>
+	/// <param name="mesh">The full detail mesh</param>
+	/// <param name="ratios">The fraction of the original triangles to keep for each level, from most to least detailed</param>
+	static std::vector<SimplifiedMesh> GenerateLods(const MeshBuilder<VertexPosNormTexCol>& mesh, const std::vector<float>& ratios);
+
+	/// <summary>
+	/// Gets the radius of a sphere around the mesh's origin that contains all of its vertices
+	/// </summary>
+	static float CalculateBoundingRadius(const MeshBuilder<VertexPosNormTexCol>& mesh);
+
+	/// <summary>
+	/// Gets the largest size on screen (as a fraction of the screen's height) that an object can be drawn with a
+	/// simplified mesh before its error becomes noticeable
+	/// </summary>
+	/// <param name="error">The error of the simplified mesh</param>
+	/// <param name="radius">The bounding radius of the mesh</param>
+	/// <param name="pixelError">The largest error we're willing to accept, in pixels</param>
+	/// <param name="screenHeight">The height of the screen that the pixel error is measured on</param>
+	static float CalculateLodScreenSize(float error, float radius, float pixelError = 1.0f, float screenHeight = 1080.0f);
+
+protected:
+	MeshSimplifier() = default;
+	~MeshSimplifier() = default;
+};
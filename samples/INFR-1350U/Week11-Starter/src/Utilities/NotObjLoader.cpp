@@ -6,9 +6,23 @@
 #include <iostream>
 
 #include "StringUtils.h"
+#include "Hash.h"
+#include "MeshCache.h"
 
 VertexArrayObject::sptr NotObjLoader::LoadFromFile(const std::string& filename)
 {
+	// Mixed into the cache key, change this whenever the loader's output changes so that old caches get rebuilt
+	const uint64_t cacheKey = HashBytes(nullptr, 0, 0x4E4F544F424A3031ull);
+	const std::string cachePath = MeshCache::GetCachePath(filename);
+
+	// If we've already baked this file, and it hasn't changed since, we can skip parsing it entirely
+	if (MeshCache::IsEnabled()) {
+		VertexArrayObject::sptr cached = MeshCache::Load(cachePath, filename, cacheKey);
+		if (cached != nullptr) {
+			return cached;
+		}
+	}
+
 	// Open our file in binary mode
 	std::ifstream file;
 	file.open(filename, std::ios::binary);
@@ -108,5 +122,8 @@ VertexArrayObject::sptr NotObjLoader::LoadFromFile(const std::string& filename)
 	// You'll need to keep track of these and create vertex entries for each vertex in the face
 	// If you want to get fancy, you can track which vertices you've already added
 
+	if (MeshCache::IsEnabled()) {
+		mesh.SaveCache(cachePath, filename, cacheKey);
+	}
 	return mesh.Bake();
 }
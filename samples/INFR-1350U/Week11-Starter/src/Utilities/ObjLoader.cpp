@@ -1,129 +1,682 @@
 #include "ObjLoader.h"
 
 #include <string>
-#include <sstream>
-#include <fstream>
-#include <iostream>
-#include <unordered_map>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
-#include "StringUtils.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "ThreadPool.h"
+
+// These are small hand written scanners for walking the OBJ text in place. They never allocate, and
+// each one advances the cursor past whatever it consumed
+namespace {
+	inline bool IsInlineSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline void SkipSpaces(const char*& cursor, const char* end) {
+		while (cursor < end && IsInlineSpace(*cursor)) {
+			cursor++;
+		}
+	}
+
+	inline void SkipLine(const char*& cursor, const char* end) {
+		while (cursor < end && *cursor != '\n') {
+			cursor++;
+		}
+		if (cursor < end) {
+			cursor++;
+		}
+	}
+
+	inline bool IsDigit(char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	// Powers of ten for the float scanner, anything outside of this range falls back to strtod
+	constexpr double POW10[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	/*
+	 * Parses a decimal float (ex: -1.25e-3) at the cursor
+	 * @param cursor The cursor to read from, will be advanced past the number
+	 * @param end The end of the buffer
+	 * @returns The parsed value, or 0 if no number was found
+	 */
+	float ParseFloat(const char*& cursor, const char* end) {
+		SkipSpaces(cursor, end);
+		const char* start = cursor;
+
+		bool negative = false;
+		if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+			negative = *cursor == '-';
+			cursor++;
+		}
+
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		while (cursor < end && IsDigit(*cursor)) {
+			if (digits < 19) { mantissa = mantissa * 10 + (*cursor - '0'); digits++; }
+			else { exponent++; }
+			cursor++;
+		}
+		if (cursor < end && *cursor == '.') {
+			cursor++;
+			while (cursor < end && IsDigit(*cursor)) {
+				if (digits < 19) { mantissa = mantissa * 10 + (*cursor - '0'); digits++; exponent--; }
+				cursor++;
+			}
+		}
+		if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+			cursor++;
+			bool negativeExp = false;
+			if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+				negativeExp = *cursor == '-';
+				cursor++;
+			}
+			int value = 0;
+			while (cursor < end && IsDigit(*cursor)) {
+				if (value < 10000) { value = value * 10 + (*cursor - '0'); }
+				cursor++;
+			}
+			exponent += negativeExp ? -value : value;
+		}
+
+		// Things like nan, inf, or crazy exponents are rare enough that we let the C runtime deal with them
+		// Note that the mapped file is not null terminated, so we copy the token into a small buffer first
+		if ((cursor < end && !IsInlineSpace(*cursor) && *cursor != '\n') || exponent < -22 || exponent > 22) {
+			while (cursor < end && !IsInlineSpace(*cursor) && *cursor != '\n') {
+				cursor++;
+			}
+			char buffer[64];
+			const size_t length = std::min<size_t>(cursor - start, sizeof(buffer) - 1);
+			memcpy(buffer, start, length);
+			buffer[length] = '\0';
+			return static_cast<float>(strtod(buffer, nullptr));
+		}
+
+		double result = static_cast<double>(mantissa);
+		result = exponent < 0 ? result / POW10[-exponent] : result * POW10[exponent];
+		return static_cast<float>(negative ? -result : result);
+	}
+
+	/*
+	 * Parses a signed integer at the cursor, does not skip leading whitespace
+	 * @param cursor The cursor to read from, will be advanced past the number
+	 * @param end The end of the buffer
+	 * @returns The parsed value, or 0 if no number was found
+	 */
+	inline int64_t ParseInt(const char*& cursor, const char* end) {
+		bool negative = false;
+		if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+			negative = *cursor == '-';
+			cursor++;
+		}
+		int64_t result = 0;
+		while (cursor < end && IsDigit(*cursor)) {
+			result = result * 10 + (*cursor - '0');
+			cursor++;
+		}
+		return negative ? -result : result;
+	}
+
+	/*
+	 * Resolves an OBJ attribute index (1 based, or negative to reference from the last added
+	 * attribute) into a 1 based absolute index, where 0 means the attribute was not specified
+	 */
+	inline uint32_t ResolveIndex(int64_t index, size_t count) {
+		if (index < 0) {
+			index = static_cast<int64_t>(count) + 1 + index;
+		}
+		return static_cast<uint32_t>(index);
+	}
+
+	/*
+	 * Gets the command (ex: v, vn, f) for the line at the cursor, and moves the cursor to the first argument
+	 */
+	enum class ObjCommand { None, Position, Normal, TexCoord, Face };
+	inline ObjCommand ReadCommand(const char*& cursor, const char* end) {
+		SkipSpaces(cursor, end);
+		if (cursor + 1 >= end) return ObjCommand::None;
+		ObjCommand result = ObjCommand::None;
+		if (cursor[0] == 'v') {
+			if (IsInlineSpace(cursor[1]))                             { result = ObjCommand::Position; cursor += 1; }
+			else if (cursor[1] == 'n' && cursor + 2 < end && IsInlineSpace(cursor[2])) { result = ObjCommand::Normal;   cursor += 2; }
+			else if (cursor[1] == 't' && cursor + 2 < end && IsInlineSpace(cursor[2])) { result = ObjCommand::TexCoord; cursor += 2; }
+		}
+		else if (cursor[0] == 'f' && IsInlineSpace(cursor[1])) {
+			result = ObjCommand::Face;
+			cursor += 1;
+		}
+		return result;
+	}
+
+	/*
+	 * Counts the number of attribute sets (ex: 1/2/3) in a face line, leaving the cursor where it started
+	 */
+	inline int CountFaceCorners(const char* cursor, const char* end) {
+		int result = 0;
+		bool inToken = false;
+		for (; cursor < end && *cursor != '\n'; cursor++) {
+			const bool isSpace = IsInlineSpace(*cursor);
+			if (!isSpace && !inToken) { result++; }
+			inToken = !isSpace;
+		}
+		return result;
+	}
+
+	enum class CornerResult { EndOfFace, Valid, Invalid };
+	/*
+	 * Reads the next set of attribute indices (v, v/vt, v//vn or v/vt/vn) from a face line, resolving them into 1 based
+	 * absolute indices (where 0 means the attribute was not specified)
+	 * @param cursor The cursor to read from, will be advanced past the corner
+	 * @param end The end of the buffer
+	 * @param counts The number of positions, texture coords and normals that have been declared so far
+	 * @param result Will store the resolved indices
+	 * @returns Whether a corner was read, and if it references attributes that actually exist
+	 */
+	inline CornerResult ReadFaceCorner(const char*& cursor, const char* end, const glm::u64vec3& counts, glm::uvec3& result) {
+		SkipSpaces(cursor, end);
+		if (cursor >= end || *cursor == '\n' || !(IsDigit(*cursor) || *cursor == '-' || *cursor == '+')) {
+			return CornerResult::EndOfFace;
+		}
+		result = glm::uvec3(0);
+		result.x = ResolveIndex(ParseInt(cursor, end), counts.x);
+		if (cursor < end && *cursor == '/') {
+			cursor++;
+			if (cursor < end && *cursor != '/') {
+				result.y = ResolveIndex(ParseInt(cursor, end), counts.y);
+			}
+			if (cursor < end && *cursor == '/') {
+				cursor++;
+				result.z = ResolveIndex(ParseInt(cursor, end), counts.z);
+			}
+		}
+		if (result.x == 0 || result.x > counts.x || result.y > counts.y || result.z > counts.z) {
+			return CornerResult::Invalid;
+		}
+		return CornerResult::Valid;
+	}
+
+	/*
+	 * Maps a set of 1 based attribute indices to a vertex index. Since every vertex has a position, we bucket vertices
+	 * by their position index, and chain together the (usually very few) vertices that share a position but have a
+	 * different texture coordinate or normal. This needs no hashing at all, works for the full 32 bit index range, and
+	 * keeps the same memory locality as the face list itself
+	 */
+	class VertexIndexMap {
+	public:
+		VertexIndexMap() : _heads(), _links() { }
+
+		/*
+		 * Prepares the map for the given number of positions, and reserves space for the expected number of vertices
+		 */
+		void Reserve(size_t positionCount, size_t vertexCount) {
+			_heads.assign(positionCount, NONE);
+			_links.reserve(vertexCount);
+		}
+
+		/*
+		 * Finds the vertex for the given attribute indices, or adds a new one if it does not exist yet. New vertices are
+		 * numbered in the order they are added
+		 * @param key The 1 based attribute indices for the vertex, the position index must be within the reserved range
+		 * @param added Will be set to true if the vertex was added, false if it already existed
+		 * @returns The index of the vertex
+		 */
+		uint32_t FindOrAdd(const glm::uvec3& key, bool& added) {
+			uint32_t& head = _heads[key.x - 1];
+			for (uint32_t ix = head; ix != NONE; ix = _links[ix].Next) {
+				if (_links[ix].TexCoord == key.y && _links[ix].Normal == key.z) {
+					added = false;
+					return ix;
+				}
+			}
+			const uint32_t result = static_cast<uint32_t>(_links.size());
+			_links.push_back({ key.y, key.z, head });
+			head = result;
+			added = true;
+			return result;
+		}
+
+	private:
+		static constexpr uint32_t NONE = UINT32_MAX;
+		struct Link {
+			uint32_t TexCoord;
+			uint32_t Normal;
+			uint32_t Next;
+		};
+		// The most recently added vertex for each position, and the chain of vertices leading back from it
+		std::vector<uint32_t> _heads;
+		std::vector<Link>     _links;
+	};
+
+	/*
+	 * Orders attribute index sets lexicographically, so that the parallel loader can sort identical vertices together
+	 */
+	inline bool KeyLess(const glm::uvec3& a, const glm::uvec3& b) {
+		if (a.x != b.x) return a.x < b.x;
+		if (a.y != b.y) return a.y < b.y;
+		return a.z < b.z;
+	}
+
+	/*
+	 * Constructs a new vertex using the 1 based attribute indices for the vertex
+	 */
+	inline VertexPosNormTexCol MakeVertex(const glm::uvec3& indices, const std::vector<glm::vec3>& positions,
+		const std::vector<glm::vec2>& textureCoords, const std::vector<glm::vec3>& normals, const glm::vec4& color)
+	{
+		VertexPosNormTexCol vertex;
+		vertex.Position = positions[indices.x - 1];
+		vertex.UV = indices.y != 0 ? textureCoords[indices.y - 1] : glm::vec2(0.0f);
+		vertex.Normal = indices.z != 0 ? normals[indices.z - 1] : glm::vec3(0.0f, 0.0f, 1.0f);
+		vertex.Color = color;
+		return vertex;
+	}
+
+	// Mixed into the cache key, change this whenever the loader's output changes so that old caches get rebuilt
+	constexpr uint64_t CACHE_SEED = 0x4F424A4C4F414431ull;
+
+	/*
+	 * Loads the baked version of an OBJ file, if it exists and is up to date
+	 * @returns The cached mesh, or nullptr if the file needs to be parsed
+	 */
+	VertexArrayObject::sptr TryLoadCache(const std::string& filename, const glm::vec4& color) {
+		if (!MeshCache::IsEnabled()) {
+			return nullptr;
+		}
+		return MeshCache::Load(MeshCache::GetCachePath(filename), filename, HashBytes(&color, sizeof(glm::vec4), CACHE_SEED));
+	}
+
+	/*
+	 * Stores the baked version of an OBJ file next to the source, so that we can skip parsing it next time
+	 */
+	void SaveCache(const MeshBuilder<VertexPosNormTexCol>& mesh, const std::string& filename, const glm::vec4& color) {
+		if (MeshCache::IsEnabled()) {
+			mesh.SaveCache(MeshCache::GetCachePath(filename), filename, HashBytes(&color, sizeof(glm::vec4), CACHE_SEED));
+		}
+	}
+}
 
 VertexArrayObject::sptr ObjLoader::LoadFromFile(const std::string& filename, const glm::vec4& inColor)
-{	
-	// Open our file in binary mode
-	std::ifstream file;
-	file.open(filename, std::ios::binary);
+{
+	// If we've already baked this file, and it hasn't changed since, we can skip parsing it entirely
+	VertexArrayObject::sptr cached = TryLoadCache(filename, inColor);
+	if (cached != nullptr) {
+		return cached;
+	}
+
+	MeshBuilder<VertexPosNormTexCol> mesh = LoadMeshFromFile(filename, inColor);
+	SaveCache(mesh, filename, inColor);
+	return mesh.Bake();
+}
+
+MeshBuilder<VertexPosNormTexCol> ObjLoader::LoadMeshFromFile(const std::string& filename, const glm::vec4& inColor)
+{
+	// Map the file into memory, this lets the OS page the file in as we scan it instead of copying it into a stream
+	MappedFile file(filename);
 
 	// If our file fails to open, we will throw an error
-	if (!file) {
+	if (!file.IsOpen()) {
 		throw std::runtime_error("Failed to open file");
 	}
 
+	const char* const begin = file.GetData();
+	const char* const end = begin + file.GetSize();
+
+	// Do a quick counting pass over the file so that we can reserve all our storage up front
+	size_t positionCount = 0, normalCount = 0, uvCount = 0, indexCount = 0;
+	for (const char* cursor = begin; cursor < end; SkipLine(cursor, end)) {
+		switch (ReadCommand(cursor, end)) {
+			case ObjCommand::Position: positionCount++; break;
+			case ObjCommand::Normal:   normalCount++; break;
+			case ObjCommand::TexCoord: uvCount++; break;
+			case ObjCommand::Face: {
+				const int corners = CountFaceCorners(cursor, end);
+				if (corners >= 3) { indexCount += (corners - 2) * 3ull; }
+				break;
+			}
+			default: break;
+		}
+	}
+
 	// Stores attributes
 	std::vector<glm::vec3> positions;
 	std::vector<glm::vec3> normals;
 	std::vector<glm::vec2> textureCoords;
+	positions.reserve(positionCount);
+	normals.reserve(normalCount);
+	textureCoords.reserve(uvCount);
 
-	// We'll use bitmask keys and a map to avoid duplicate vertices
-	std::unordered_map<uint64_t, uint32_t> indexMap;
+	// We'll use a map from attribute indices to vertex indices to avoid duplicate vertices
+	VertexIndexMap indexMap;
+	indexMap.Reserve(positionCount, positionCount);
 
-	// We'll leverage the mesh builder class
+	// We'll leverage the mesh builder class, most meshes have about as many vertices as positions
 	MeshBuilder<VertexPosNormTexCol> mesh;
+	mesh.ReserveVertexSpace(positionCount);
+	mesh.ReserveIndexSpace(indexCount);
 
-	// Temporaries for loading data
-	glm::vec3 temp;
-	glm::ivec3 vertexIndices;
-	
-	std::string line;
-	// Iterate as long as there is content to read
-	while (file.peek() != EOF) {
-		std::string command;
-		file >> command;
-
-		// Load in vertex positions
-		if (command == "v") {
-			file >> temp.x >> temp.y >> temp.z;
-			positions.push_back(temp);
-		}
-		// Load in vertex normals
-		else if (command == "vn") {
-			file >> temp.x >> temp.y >> temp.z;
-			normals.push_back(temp);
-		}
-		// Load in UV coordinates
-		else if (command == "vt") {
-			file >> temp.x >> temp.y;
-			textureCoords.push_back(temp);
-		}
-		// Load in face lines
-		else if (command == "f") {
-			// Read the entire line, trim it, and stuff it into a string stream
-			std::string line;
-			std::getline(file, line);
-			trim(line);			
-			std::stringstream stream = std::stringstream(line);
-
-			// We'll store the edges in case we added a quad
-			uint32_t edges[4];
-			int ix = 0;
-			// Iterate over up to 4 sets of attributes
-			for (; ix < 4; ix++) {
-				if (stream.peek() != EOF) {
-					// Load in the faces, split up by slashes
-					char tempChar;
-					vertexIndices = glm::ivec3(0);
-					stream >> vertexIndices.x >> tempChar >> vertexIndices.y >> tempChar >> vertexIndices.z;
-					// The OBJ format can have negative values, which are a reference from the last added attributes
-					if (vertexIndices.x < 0) { vertexIndices.x = positions.size() - 1 + vertexIndices.x; }
-					if (vertexIndices.y < 0) { vertexIndices.y = textureCoords.size() - 1 + vertexIndices.y; }
-					if (vertexIndices.z < 0) { vertexIndices.z = normals.size() - 1 + vertexIndices.z; }
-					// We can construct a key using a bitmask of the attribute indices
-					// This let's us quickly look up a combination of attributes to see if it's already been added
-					// Note that this limits us to 2,097,150 unique attributes for positions, normals and textures
-					const uint64_t mask = 0b0'000000000000000000000'000000000000000000000'111111111111111111111;
-					uint64_t key = ((vertexIndices.x & mask) << 42) | ((vertexIndices.y & mask) << 21) | (vertexIndices.z & mask);
-
-					// Find the index associated with the combination of attributes
-					auto it = indexMap.find(key);
-
-					// If it exists, we push the index to our indices
-					if (it != indexMap.end()) {
-						edges[ix] = it->second;
+	for (const char* cursor = begin; cursor < end; SkipLine(cursor, end)) {
+		switch (ReadCommand(cursor, end)) {
+			// Load in vertex positions
+			case ObjCommand::Position: {
+				glm::vec3& value = positions.emplace_back();
+				value.x = ParseFloat(cursor, end);
+				value.y = ParseFloat(cursor, end);
+				value.z = ParseFloat(cursor, end);
+				break;
+			}
+			// Load in vertex normals
+			case ObjCommand::Normal: {
+				glm::vec3& value = normals.emplace_back();
+				value.x = ParseFloat(cursor, end);
+				value.y = ParseFloat(cursor, end);
+				value.z = ParseFloat(cursor, end);
+				break;
+			}
+			// Load in UV coordinates
+			case ObjCommand::TexCoord: {
+				glm::vec2& value = textureCoords.emplace_back();
+				value.x = ParseFloat(cursor, end);
+				value.y = ParseFloat(cursor, end);
+				break;
+			}
+			// Load in face lines, any polygon with more than 3 corners is triangulated as a fan
+			case ObjCommand::Face: {
+				uint32_t first = 0, previous = 0;
+				int ix = 0;
+				const glm::u64vec3 counts = glm::u64vec3(positions.size(), textureCoords.size(), normals.size());
+				glm::uvec3 vertexIndices;
+				CornerResult corner;
+				while ((corner = ReadFaceCorner(cursor, end, counts, vertexIndices)) != CornerResult::EndOfFace) {
+					// Skip any corners that reference attributes that do not exist
+					if (corner == CornerResult::Invalid) {
+						continue;
 					}
-					else {
-						// Construct a new vertex using the indices for the vertex
-						VertexPosNormTexCol vertex;
-						vertex.Position = positions[vertexIndices.x - 1];
-						vertex.UV = vertexIndices.y != 0 ? textureCoords[vertexIndices.y - 1] : glm::vec2(0.0f);
-						vertex.Normal = vertexIndices.z != 0 ? normals[vertexIndices.z - 1] : glm::vec3(0.0f, 0.0f, 1.0f);
-						vertex.Color = inColor;
-
-						// Add to the mesh, get index of the added vertex
-						uint32_t index = mesh.AddVertex(vertex);
-						// Cache the index based on our key
-						indexMap[key] = index;
-						// Add index to mesh, and add to edges list for if we are using quads
-						edges[ix] = index;
+
+					// Find the index associated with the combination of attributes, or add a new vertex if it does not exist yet
+					bool isNew;
+					const uint32_t index = indexMap.FindOrAdd(vertexIndices, isNew);
+					if (isNew) {
+						mesh.AddVertex(MakeVertex(vertexIndices, positions, textureCoords, normals, inColor));
 					}
-				} else {
-					break;
+
+					if (ix == 0) {
+						first = index;
+					} else if (ix >= 2) {
+						mesh.AddIndexTri(first, previous, index);
+					}
+					previous = index;
+					ix++;
 				}
+				break;
 			}
-			// Handling for trangle faces
-			if (ix == 3) {
-				mesh.AddIndexTri(edges[0], edges[1], edges[2]);
+			default: break;
+		}
+	}
+
+	return mesh;
+}
+
+// The parallel loader works in a few phases, each of which is spread across the thread pool:
+//   1) The file is split into chunks at line boundaries, and we count the attributes in each chunk
+//   2) A prefix sum over those counts tells each chunk where its attributes live in the global arrays, so that
+//      every chunk can parse in isolation and still resolve relative (negative) indices exactly like the serial path
+//   3) Every face corner is tagged with its position in the file, and we sort the (key, corner) pairs. The first
+//      corner of each run of equal keys is where the serial loader would have added that vertex
+//   4) A prefix sum over those first occurrences gives us the vertex ids in first-seen order, so the output matches
+//      LoadFromFile byte for byte
+namespace {
+	// Small files aren't worth splitting up, so we never make a chunk smaller than this
+	constexpr size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+	struct ObjChunk {
+		const char* Begin;
+		const char* End;
+		// The number of attributes declared in this chunk, and then the number declared before it
+		glm::u64vec3 Counts;
+		glm::u64vec3 Offsets;
+		// The attribute indices for every valid face corner, and the number of valid corners in each face
+		std::vector<glm::uvec3> Keys;
+		std::vector<uint32_t> FaceSizes;
+		// The index of this chunk's first corner and first triangle index in the whole mesh
+		size_t CornerOffset;
+		size_t IndexOffset;
+	};
+
+	struct CornerRecord {
+		glm::uvec3 Key;
+		uint32_t   Corner;
+		bool operator <(const CornerRecord& other) const {
+			return Key != other.Key ? KeyLess(Key, other.Key) : Corner < other.Corner;
+		}
+	};
+}
+
+VertexArrayObject::sptr ObjLoader::LoadFromFileParallel(const std::string& filename, const glm::vec4& inColor, size_t threadCount)
+{
+	// If we've already baked this file, and it hasn't changed since, we can skip parsing it entirely
+	VertexArrayObject::sptr cached = TryLoadCache(filename, inColor);
+	if (cached != nullptr) {
+		return cached;
+	}
+
+	MappedFile file(filename);
+
+	// If our file fails to open, we will throw an error
+	if (!file.IsOpen()) {
+		throw std::runtime_error("Failed to open file");
+	}
+
+	ThreadPool& pool = ThreadPool::Instance();
+	const size_t threads = threadCount == 0 ? pool.GetThreadCount() + 1 : threadCount;
+
+	const char* const begin = file.GetData();
+	const char* const end = begin + file.GetSize();
+
+	// Split the file into a few chunks per thread so that uneven chunks still balance out, moving each split
+	// forward to the start of the next line
+	const size_t chunkCount = std::max<size_t>(1, std::min(threads * 4, file.GetSize() / MIN_CHUNK_SIZE));
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* split = begin;
+	for (size_t ix = 0; ix < chunkCount; ix++) {
+		chunks[ix].Begin = split;
+		split = ix + 1 == chunkCount ? end : std::max(split, begin + file.GetSize() * (ix + 1) / chunkCount);
+		while (split > chunks[ix].Begin && split < end && split[-1] != '\n') {
+			split++;
+		}
+		chunks[ix].End = split;
+	}
+
+	// Count the attributes and face corners in each chunk
+	pool.ParallelFor(chunkCount, [&](size_t ix) {
+		ObjChunk& chunk = chunks[ix];
+		chunk.Counts = glm::u64vec3(0);
+		size_t faceCount = 0, cornerCount = 0;
+		for (const char* cursor = chunk.Begin; cursor < chunk.End; SkipLine(cursor, chunk.End)) {
+			switch (ReadCommand(cursor, chunk.End)) {
+				case ObjCommand::Position: chunk.Counts.x++; break;
+				case ObjCommand::TexCoord: chunk.Counts.y++; break;
+				case ObjCommand::Normal:   chunk.Counts.z++; break;
+				case ObjCommand::Face:
+					faceCount++;
+					cornerCount += CountFaceCorners(cursor, chunk.End);
+					break;
+				default: break;
 			}
-			// Handling for quad faces
-			else if (ix == 4) {
-				mesh.AddIndexTri(edges[0], edges[1], edges[2]);
-				mesh.AddIndexTri(edges[0], edges[2], edges[3]);
+		}
+		chunk.Keys.reserve(cornerCount);
+		chunk.FaceSizes.reserve(faceCount);
+	}, threads);
+
+	glm::u64vec3 totals = glm::u64vec3(0);
+	for (ObjChunk& chunk : chunks) {
+		chunk.Offsets = totals;
+		totals += chunk.Counts;
+	}
+
+	std::vector<glm::vec3> positions(totals.x);
+	std::vector<glm::vec2> textureCoords(totals.y);
+	std::vector<glm::vec3> normals(totals.z);
+
+	// Parse each chunk straight into the global attribute arrays. Face corners are resolved against the number of
+	// attributes declared before that line in the whole file, which is what the serial loader would see
+	pool.ParallelFor(chunkCount, [&](size_t ix) {
+		ObjChunk& chunk = chunks[ix];
+		glm::u64vec3 counts = chunk.Offsets;
+		for (const char* cursor = chunk.Begin; cursor < chunk.End; SkipLine(cursor, chunk.End)) {
+			switch (ReadCommand(cursor, chunk.End)) {
+				case ObjCommand::Position: {
+					glm::vec3& value = positions[counts.x++];
+					value.x = ParseFloat(cursor, chunk.End);
+					value.y = ParseFloat(cursor, chunk.End);
+					value.z = ParseFloat(cursor, chunk.End);
+					break;
+				}
+				case ObjCommand::TexCoord: {
+					glm::vec2& value = textureCoords[counts.y++];
+					value.x = ParseFloat(cursor, chunk.End);
+					value.y = ParseFloat(cursor, chunk.End);
+					break;
+				}
+				case ObjCommand::Normal: {
+					glm::vec3& value = normals[counts.z++];
+					value.x = ParseFloat(cursor, chunk.End);
+					value.y = ParseFloat(cursor, chunk.End);
+					value.z = ParseFloat(cursor, chunk.End);
+					break;
+				}
+				case ObjCommand::Face: {
+					uint32_t size = 0;
+					glm::uvec3 vertexIndices;
+					CornerResult corner;
+					while ((corner = ReadFaceCorner(cursor, chunk.End, counts, vertexIndices)) != CornerResult::EndOfFace) {
+						if (corner == CornerResult::Valid) {
+							chunk.Keys.push_back(vertexIndices);
+							size++;
+						}
+					}
+					if (size > 0) {
+						chunk.FaceSizes.push_back(size);
+					}
+					break;
+				}
+				default: break;
 			}
 		}
+	}, threads);
+
+	size_t cornerCount = 0, indexCount = 0;
+	for (ObjChunk& chunk : chunks) {
+		chunk.CornerOffset = cornerCount;
+		chunk.IndexOffset = indexCount;
+		cornerCount += chunk.Keys.size();
+		for (uint32_t size : chunk.FaceSizes) {
+			if (size >= 3) { indexCount += (size - 2) * 3ull; }
+		}
+	}
+
+	// We store corner positions as 32 bit values, which is already well past what a 32 bit index buffer can hold
+	if (cornerCount > UINT32_MAX) {
+		throw std::runtime_error("Mesh has too many face corners");
+	}
+
+	// Gather all the corners into one list, tagged with where they appear in the file, and sort them so that
+	// identical vertices end up next to each other
+	std::vector<CornerRecord> records(cornerCount);
+	pool.ParallelFor(chunkCount, [&](size_t ix) {
+		ObjChunk& chunk = chunks[ix];
+		for (size_t corner = 0; corner < chunk.Keys.size(); corner++) {
+			records[chunk.CornerOffset + corner] = { chunk.Keys[corner], static_cast<uint32_t>(chunk.CornerOffset + corner) };
+		}
+		std::vector<glm::uvec3>().swap(chunk.Keys);
+	}, threads);
+	pool.ParallelSort(records.begin(), records.end(), std::less<CornerRecord>(), threads);
+
+	// We work on the corner list in fixed blocks, so that our scans can run in parallel
+	const size_t blockCount = std::max<size_t>(1, std::min(threads * 4, cornerCount / 4096));
+	auto blockStart = [&](size_t block) { return cornerCount * block / blockCount; };
+
+	// Flag the first time each unique vertex shows up in the file
+	std::vector<uint32_t> cornerVertex(cornerCount);
+	std::vector<uint8_t> isFirst(cornerCount);
+	pool.ParallelFor(blockCount, [&](size_t block) {
+		for (size_t ix = blockStart(block); ix < blockStart(block + 1); ix++) {
+			isFirst[records[ix].Corner] = ix == 0 || records[ix].Key != records[ix - 1].Key;
+		}
+	}, threads);
+
+	// Number the first occurrences in file order, this is the order the serial loader adds vertices in
+	std::vector<size_t> blockVertices(blockCount + 1, 0);
+	pool.ParallelFor(blockCount, [&](size_t block) {
+		size_t count = 0;
+		for (size_t ix = blockStart(block); ix < blockStart(block + 1); ix++) {
+			count += isFirst[ix];
+		}
+		blockVertices[block + 1] = count;
+	}, threads);
+	for (size_t block = 0; block < blockCount; block++) {
+		blockVertices[block + 1] += blockVertices[block];
 	}
+	pool.ParallelFor(blockCount, [&](size_t block) {
+		uint32_t vertex = static_cast<uint32_t>(blockVertices[block]);
+		for (size_t ix = blockStart(block); ix < blockStart(block + 1); ix++) {
+			if (isFirst[ix]) {
+				cornerVertex[ix] = vertex++;
+			}
+		}
+	}, threads);
+	std::vector<uint8_t>().swap(isFirst);
 
-	// Note: with actual OBJ files you're going to run into the issue where faces are composited of different indices
-	// You'll need to keep track of these and create vertex entries for each vertex in the face
-	// If you want to get fancy, you can track which vertices you've already added
+	MeshBuilder<VertexPosNormTexCol> mesh;
+	mesh._vertices.resize(blockVertices[blockCount]);
+	mesh._indices.resize(indexCount);
+
+	// Every corner takes the vertex id of the first corner in its run, and the first corners build the vertices
+	pool.ParallelFor(blockCount, [&](size_t block) {
+		size_t ix = blockStart(block);
+		if (ix >= blockStart(block + 1)) {
+			return;
+		}
+		// Our block may have started in the middle of a run, so we need to find where that run began
+		size_t runStart = ix;
+		while (runStart > 0 && records[runStart - 1].Key == records[ix].Key) {
+			runStart--;
+		}
+		uint32_t vertex = cornerVertex[records[runStart].Corner];
+		for (; ix < blockStart(block + 1); ix++) {
+			const CornerRecord& record = records[ix];
+			if (ix == runStart || record.Key != records[ix - 1].Key) {
+				vertex = cornerVertex[record.Corner];
+				mesh._vertices[vertex] = MakeVertex(record.Key, positions, textureCoords, normals, inColor);
+			} else {
+				cornerVertex[record.Corner] = vertex;
+			}
+		}
+	}, threads);
+
+	// Finally we can triangulate each face as a fan, in the same order as they appear in the file
+	pool.ParallelFor(chunkCount, [&](size_t ix) {
+		const ObjChunk& chunk = chunks[ix];
+		const uint32_t* corner = cornerVertex.data() + chunk.CornerOffset;
+		uint32_t* index = mesh._indices.data() + chunk.IndexOffset;
+		for (uint32_t size : chunk.FaceSizes) {
+			for (uint32_t tri = 2; tri < size; tri++) {
+				*index++ = corner[0];
+				*index++ = corner[tri - 1];
+				*index++ = corner[tri];
+			}
+			corner += size;
+		}
+	}, threads);
 
+	SaveCache(mesh, filename, inColor);
 	return mesh.Bake();
 }
@@ -5,6 +5,21 @@ class ObjLoader
 {
 public:
 	static VertexArrayObject::sptr LoadFromFile(const std::string& filename, const glm::vec4& inColor = glm::vec4(1.0f));
+	/// <summary>
+	/// Parses an OBJ file into a mesh builder without baking it, so that it can be processed further (ex: simplified
+	/// or optimized) before being uploaded. Note that this never reads or writes the mesh cache
+	/// </summary>
+	/// <param name="filename">The path of the file to load</param>
+	/// <param name="inColor">The color to apply to all vertices of the mesh</param>
+	static MeshBuilder<VertexPosNormTexCol> LoadMeshFromFile(const std::string& filename, const glm::vec4& inColor = glm::vec4(1.0f));
+	/// <summary>
+	/// Loads an OBJ file by splitting it into chunks that are parsed and deduplicated across the thread pool. The
+	/// resulting mesh is identical to the one produced by LoadFromFile
+	/// </summary>
+	/// <param name="filename">The path of the file to load</param>
+	/// <param name="inColor">The color to apply to all vertices of the mesh</param>
+	/// <param name="threadCount">The maximum number of threads to use, or 0 to use the whole thread pool</param>
+	static VertexArrayObject::sptr LoadFromFileParallel(const std::string& filename, const glm::vec4& inColor = glm::vec4(1.0f), size_t threadCount = 0);
 
 protected:
 	ObjLoader() = default;
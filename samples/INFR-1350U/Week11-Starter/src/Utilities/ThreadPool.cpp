@@ -0,0 +1,124 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t threadCount) :
+	_isShuttingDown(false)
+{
+	if (threadCount == 0) {
+		// The thread calling ParallelFor also does work, so we leave one hardware thread for it
+		const size_t hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+	_workers.reserve(threadCount);
+	for (size_t ix = 0; ix < threadCount; ix++) {
+		_workers.emplace_back(&ThreadPool::_WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_isShuttingDown = true;
+	}
+	_signal.notify_all();
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::Enqueue(std::function<void()> task, const void* group) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_tasks.push_back({ std::move(task), group });
+	}
+	_signal.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& body, size_t maxThreads) {
+	if (count == 0) {
+		return;
+	}
+
+	size_t threads = std::min(count, GetThreadCount() + 1);
+	if (maxThreads > 0) {
+		threads = std::min(threads, maxThreads);
+	}
+	if (threads <= 1) {
+		for (size_t ix = 0; ix < count; ix++) {
+			body(ix);
+		}
+		return;
+	}
+
+	// Each participating thread pulls the next index off a shared counter until we run out of work
+	std::atomic<size_t> next(0);
+	size_t remainingHelpers = threads - 1; // Guarded by doneMutex
+	std::mutex doneMutex;
+	std::condition_variable doneSignal;
+
+	auto work = [&]() {
+		for (size_t ix = next.fetch_add(1); ix < count; ix = next.fetch_add(1)) {
+			body(ix);
+		}
+	};
+
+	for (size_t ix = 0; ix < threads - 1; ix++) {
+		Enqueue([&]() {
+			work();
+			// The counter is only touched under the lock, so the calling thread can't see it hit zero and
+			// tear down our stack while we're still signalling it
+			std::lock_guard<std::mutex> lock(doneMutex);
+			remainingHelpers--;
+			doneSignal.notify_one();
+		}, &next);
+	}
+
+	work();
+
+	// We have to wait for all the helpers to exit, since they reference our stack. While we wait we run any of our
+	// helpers that are still queued, so that calling ParallelFor from inside a worker can't starve them
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lock(doneMutex);
+			if (remainingHelpers == 0) {
+				break;
+			}
+		}
+		if (!TryRunPendingTask(&next)) {
+			// Nothing is queued, so all of our helpers have already been picked up by a worker
+			std::unique_lock<std::mutex> lock(doneMutex);
+			doneSignal.wait(lock, [&]() { return remainingHelpers == 0; });
+			break;
+		}
+	}
+}
+
+bool ThreadPool::TryRunPendingTask(const void* group) {
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = std::find_if(_tasks.begin(), _tasks.end(), [group](const Task& queued) { return queued.Group == group; });
+		if (it == _tasks.end()) {
+			return false;
+		}
+		task = std::move(it->Func);
+		_tasks.erase(it);
+	}
+	task();
+	return true;
+}
+
+void ThreadPool::_WorkerLoop() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_signal.wait(lock, [this]() { return _isShuttingDown || !_tasks.empty(); });
+			if (_isShuttingDown && _tasks.empty()) {
+				return;
+			}
+			task = std::move(_tasks.front().Func);
+			_tasks.pop_front();
+		}
+		task();
+	}
+}
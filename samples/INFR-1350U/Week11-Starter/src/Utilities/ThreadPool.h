@@ -0,0 +1,126 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// A simple fixed size pool of worker threads, used to spread data-parallel work (like mesh loading) across
+/// all the cores of the machine
+/// </summary>
+class ThreadPool final
+{
+public:
+	// We'll disallow moving and copying, since the workers hold a pointer back to the pool
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool(ThreadPool&& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+	ThreadPool& operator=(ThreadPool&& other) = delete;
+
+	/// <summary>
+	/// Gets the shared pool for the application, which has one worker per hardware thread
+	/// </summary>
+	static ThreadPool& Instance() {
+		static ThreadPool instance;
+		return instance;
+	}
+
+	/// <summary>
+	/// Creates a new thread pool
+	/// </summary>
+	/// <param name="threadCount">The number of worker threads to create, or 0 to use one per hardware thread</param>
+	ThreadPool(size_t threadCount = 0);
+	~ThreadPool();
+
+	/// <summary>
+	/// Gets the number of worker threads in this pool
+	/// </summary>
+	size_t GetThreadCount() const { return _workers.size(); }
+
+	/// <summary>
+	/// Queues a single task to be run on one of the workers, without waiting for it to complete
+	/// </summary>
+	/// <param name="task">The task to run</param>
+	/// <param name="group">An optional tag for the task, so that whoever queued it can run it early with TryRunPendingTask</param>
+	void Enqueue(std::function<void()> task, const void* group = nullptr);
+
+	/// <summary>
+	/// Invokes body for every index in [0, count), spread across the pool. The calling thread helps with the
+	/// work, and this will not return until every index has been processed
+	/// </summary>
+	/// <param name="count">The number of items to process</param>
+	/// <param name="body">The function to invoke for each item index</param>
+	/// <param name="maxThreads">The maximum number of threads (including the caller) to use, or 0 for no limit</param>
+	void ParallelFor(size_t count, const std::function<void(size_t)>& body, size_t maxThreads = 0);
+
+	/// <summary>
+	/// Runs the next queued task from the given group on the calling thread, so that a thread waiting on it's own tasks
+	/// can help out. Only the waiter's own tasks are run, so a long unrelated task (ex: decoding an image) can never end
+	/// up on a thread that's in the middle of something else
+	/// </summary>
+	/// <param name="group">The tag that the tasks were queued with</param>
+	/// <returns>True if a task was run, false if no tasks from the group are queued</returns>
+	bool TryRunPendingTask(const void* group);
+
+	/// <summary>
+	/// Sorts the range [first, last) by splitting it into blocks that are sorted in parallel, then merged pairwise
+	/// </summary>
+	/// <param name="first">The first element of the range to sort</param>
+	/// <param name="last">One past the last element of the range to sort</param>
+	/// <param name="comp">The strict weak ordering to sort by</param>
+	/// <param name="maxThreads">The maximum number of threads (including the caller) to use, or 0 for no limit</param>
+	template <typename RandomIt, typename Compare>
+	void ParallelSort(RandomIt first, RandomIt last, Compare comp, size_t maxThreads = 0) {
+		const size_t count = static_cast<size_t>(last - first);
+		size_t blocks = maxThreads == 0 ? GetThreadCount() + 1 : maxThreads;
+		// Below this size it's not worth the overhead of splitting the work up
+		blocks = std::min(blocks, count / 4096);
+		if (blocks <= 1) {
+			std::sort(first, last, comp);
+			return;
+		}
+
+		std::vector<size_t> bounds(blocks + 1);
+		for (size_t ix = 0; ix <= blocks; ix++) {
+			bounds[ix] = count * ix / blocks;
+		}
+		ParallelFor(blocks, [&](size_t ix) {
+			std::sort(first + bounds[ix], first + bounds[ix + 1], comp);
+		}, maxThreads);
+
+		// Merge neighbouring blocks together until only one is left
+		while (bounds.size() > 2) {
+			const size_t merges = (bounds.size() - 1) / 2;
+			ParallelFor(merges, [&](size_t ix) {
+				std::inplace_merge(first + bounds[ix * 2], first + bounds[ix * 2 + 1], first + bounds[ix * 2 + 2], comp);
+			}, maxThreads);
+			std::vector<size_t> merged;
+			merged.reserve(merges + 2);
+			for (size_t ix = 0; ix < bounds.size(); ix += 2) {
+				merged.push_back(bounds[ix]);
+			}
+			if (merged.back() != bounds.back()) {
+				merged.push_back(bounds.back());
+			}
+			bounds = std::move(merged);
+		}
+	}
+
+private:
+	struct Task {
+		std::function<void()> Func;
+		const void*           Group;
+	};
+
+	std::vector<std::thread> _workers;
+	std::deque<Task> _tasks;
+	std::mutex _mutex;
+	std::condition_variable _signal;
+	bool _isShuttingDown;
+
+	void _WorkerLoop();
+};
@@ -7,15 +7,18 @@
 #include <filesystem>
 #include <json.hpp>
 #include <fstream>
+#include <cstring>
 
 #include <GLM/glm.hpp>
 #include <GLM/gtc/matrix_transform.hpp>
 #include <GLM/gtc/type_ptr.hpp>
 
+#include "Graphics/GLState.h"
 #include "Graphics/IndexBuffer.h"
 #include "Graphics/VertexBuffer.h"
 #include "Graphics/VertexArrayObject.h"
 #include "Graphics/Shader.h"
+#include "Graphics/ShaderVariantSet.h"
 #include "Gameplay/Camera.h"
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -24,23 +27,31 @@
 #include "Behaviours/FollowPathBehaviour.h"
 #include "Behaviours/SimpleMoveBehaviour.h"
 #include "Gameplay/Application.h"
+#include "Gameplay/BehaviourSystem.h"
+#include "Gameplay/CullingSystem.h"
+#include "Gameplay/OccluderComponent.h"
 #include "Gameplay/GameObjectTag.h"
 #include "Gameplay/IBehaviour.h"
 #include "Gameplay/Transform.h"
+#include "Gameplay/TransformSystem.h"
 #include "Graphics/Texture2D.h"
 #include "Graphics/Texture2DData.h"
 #include "Utilities/InputHelpers.h"
 #include "Utilities/MeshBuilder.h"
 #include "Utilities/MeshFactory.h"
+#include "Utilities/MeshSimplifier.h"
 #include "Utilities/NotObjLoader.h"
 #include "Utilities/ObjLoader.h"
 #include "Utilities/VertexTypes.h"
 #include "Gameplay/Scene.h"
 #include "Gameplay/ShaderMaterial.h"
 #include "Gameplay/RendererComponent.h"
+#include "Gameplay/RenderQueue.h"
 #include "Gameplay/Timing.h"
 #include "Graphics/TextureCubeMap.h"
 #include "Graphics/TextureCubeMapData.h"
+#include "Graphics/TextureStreamer.h"
+#include "Utilities/BlockCompressor.h"
 
 #define LOG_GL_NOTIFICATIONS
 
@@ -191,16 +202,18 @@ void RenderImGui() {
 	}
 }
 
-void RenderVAO(
-	const Shader::sptr& shader,
-	const VertexArrayObject::sptr& vao,
-	const glm::mat4& viewProjection,
-	const Transform& transform)
-{
-	shader->SetUniformMatrix("u_ModelViewProjection", viewProjection * transform.WorldTransform());
-	shader->SetUniformMatrix("u_Model", transform.WorldTransform()); 
-	shader->SetUniformMatrix("u_NormalMatrix", transform.WorldNormalMatrix());
-	vao->Render();
+/// <summary>
+/// Estimates how much of the screen's height an object covers, using it's bounding sphere
+/// </summary>
+float CalculateScreenSize(const RendererComponent& renderer, const Transform& transform, const glm::vec3& camPos, const glm::mat4& projection, bool isOrtho) {
+	const glm::mat4& world = transform.WorldTransform();
+	const float scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+	// projection[1][1] is 1 / tan(fov / 2) in perspective mode, or 1 / (half the view height) in ortho mode
+	const float radius = renderer.BoundingRadius * scale * projection[1][1];
+	if (isOrtho) {
+		return radius;
+	}
+	return radius / glm::max(glm::length(glm::vec3(world[3]) - camPos), 0.0001f);
 }
 
 void SetupShaderForFrame(const Shader::sptr& shader, const glm::mat4& view, const glm::mat4& projection) {
@@ -213,9 +226,45 @@ void SetupShaderForFrame(const Shader::sptr& shader, const glm::mat4& view, cons
 	shader->SetUniform("u_CamPos", camPos);
 }
 
-int main() {
+/// <summary>
+/// Gets the block compressed version of an image if one has been made (see CompressTextures), otherwise the image itself
+/// </summary>
+std::string PreferCompressed(const std::string& path) {
+	const std::string compressed = BlockCompressor::GetCompressedPath(path);
+	return std::filesystem::exists(compressed) ? compressed : path;
+}
+
+/// <summary>
+/// Handles running with --compress, which encodes images into KTX2 files next to them ahead of time
+/// Usage: --compress [--format BC1|BC3|BC4|BC5|BC7] images/box.bmp images/stone.jpg ...
+/// </summary>
+/// <returns>The exit code for the application, 0 if every image was compressed</returns>
+int CompressTextures(int argc, char** argv) {
+	InternalFormat format = InternalFormat::Unknown;
+	int failures = 0;
+	for (int ix = 0; ix < argc; ix++) {
+		if (strcmp(argv[ix], "--format") == 0 && ix + 1 < argc) {
+			format = ParseInternalFormat(argv[++ix], InternalFormat::Unknown);
+			if (!IsCompressedFormat(format)) {
+				LOG_ERROR("\"{}\" is not a compressed format, expected one of BC1, BC3, BC4, BC5 or BC7", argv[ix]);
+				return 1;
+			}
+		} else if (!BlockCompressor::CompressFile(argv[ix], "", format)) {
+			LOG_ERROR("Failed to compress \"{}\"", argv[ix]);
+			failures++;
+		}
+	}
+	return failures > 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
 	Logger::Init(); // We'll borrow the logger from the toolkit, but we need to initialize it
 
+	// Compressing textures doesn't need a window, so we do that and exit
+	if (argc > 1 && strcmp(argv[1], "--compress") == 0) {
+		return CompressTextures(argc - 2, argv + 2);
+	}
+
 	//Initialize GLFW
 	if (!initGLFW())
 		return 1;
@@ -241,11 +290,28 @@ int main() {
 	{
 		#pragma region Shader and ImGui
 
-		// Load our shaders
-		Shader::sptr shader = Shader::Create();
-		shader->LoadShaderPartFromFile("shaders/vertex_shader.glsl", GL_VERTEX_SHADER);
-		shader->LoadShaderPartFromFile("shaders/frag_blinn_phong_textured.glsl", GL_FRAGMENT_SHADER);
-		shader->Link();
+		// Load our shaders, our lit objects all use variants of the same shader
+		ShaderVariantSet::sptr litShaders = ShaderVariantSet::Create("shaders/vertex_shader.glsl", "shaders/frag_lit.glsl");
+		const uint32_t LIGHTING   = litShaders->GetFeature("LIGHTING");
+		const uint32_t REFLECTIVE = litShaders->GetFeature("REFLECTIVE");
+
+		Shader::sptr skybox = Shader::Create();
+		skybox->LoadShaderPartFromFile("shaders/skybox-shader.vert.glsl", GL_VERTEX_SHADER);
+		skybox->LoadShaderPartFromFile("shaders/skybox-shader.frag.glsl", GL_FRAGMENT_SHADER);
+
+		// Compile the variants we know we'll need up front so we don't hitch on first use. They get compiled in parallel
+		// with the skybox where possible, and programs from the last run come from the shader cache (so the first launch
+		// is a cold start, and later launches are warm)
+		const double shaderStart = glfwGetTime();
+		litShaders->Precompile({ LIGHTING, LIGHTING | REFLECTIVE, REFLECTIVE }, { skybox });
+		const double shaderTime = glfwGetTime() - shaderStart;
+		const std::vector<Shader::sptr> allShaders = { litShaders->Get(LIGHTING), litShaders->Get(LIGHTING | REFLECTIVE), litShaders->Get(REFLECTIVE), skybox };
+		int cachedShaders = 0;
+		for (const Shader::sptr& linked : allShaders) {
+			cachedShaders += linked->IsFromCache() ? 1 : 0;
+		}
+		LOG_INFO("Linked {} shaders in {:.2f} ms ({} from cache, {} start)", allShaders.size(), shaderTime * 1000.0,
+			cachedShaders, cachedShaders == (int)allShaders.size() ? "warm" : "cold");
 
 		glm::vec3 lightPos = glm::vec3(0.0f, 0.0f, 2.0f);
 		glm::vec3 lightCol = glm::vec3(0.9f, 0.85f, 0.5f);
@@ -256,48 +322,57 @@ int main() {
 		float     lightLinearFalloff = 0.09f;
 		float     lightQuadraticFalloff = 0.032f;
 
-		// These are our application / scene level uniforms that don't necessarily update
-		// every frame
-		shader->SetUniform("u_LightPos", lightPos);
-		shader->SetUniform("u_LightCol", lightCol);
-		shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-		shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-		shader->SetUniform("u_AmbientCol", ambientCol);
-		shader->SetUniform("u_AmbientStrength", ambientPow);
-		shader->SetUniform("u_LightAttenuationConstant", 1.0f);
-		shader->SetUniform("u_LightAttenuationLinear", lightLinearFalloff);
-		shader->SetUniform("u_LightAttenuationQuadratic", lightQuadraticFalloff);
+		// These are our application / scene level values that don't necessarily update every frame. They live in the
+		// material block of our lit shaders, so we set them on every lit material
+		std::vector<ShaderMaterial::sptr> litMaterials;
+		auto setLightValue = [&](const std::string& name, const auto& value) {
+			for (const ShaderMaterial::sptr& material : litMaterials) {
+				material->Set(name, value);
+			}
+		};
+		auto setAllLightValues = [&](const ShaderMaterial::sptr& material) {
+			material->Set("u_LightPos", lightPos);
+			material->Set("u_LightCol", lightCol);
+			material->Set("u_AmbientLightStrength", lightAmbientPow);
+			material->Set("u_SpecularLightStrength", lightSpecularPow);
+			material->Set("u_AmbientCol", ambientCol);
+			material->Set("u_AmbientStrength", ambientPow);
+			material->Set("u_LightAttenuationConstant", 1.0f);
+			material->Set("u_LightAttenuationLinear", lightLinearFalloff);
+			material->Set("u_LightAttenuationQuadratic", lightQuadraticFalloff);
+			litMaterials.push_back(material);
+		};
 
 		// We'll add some ImGui controls to control our shader
 		imGuiCallbacks.push_back([&]() {
 			if (ImGui::CollapsingHeader("Scene Level Lighting Settings"))
 			{
 				if (ImGui::ColorPicker3("Ambient Color", glm::value_ptr(ambientCol))) {
-					shader->SetUniform("u_AmbientCol", ambientCol);
+					setLightValue("u_AmbientCol", ambientCol);
 				}
 				if (ImGui::SliderFloat("Fixed Ambient Power", &ambientPow, 0.01f, 1.0f)) {
-					shader->SetUniform("u_AmbientStrength", ambientPow);
+					setLightValue("u_AmbientStrength", ambientPow);
 				}
 			}
 			if (ImGui::CollapsingHeader("Light Level Lighting Settings"))
 			{
 				if (ImGui::DragFloat3("Light Pos", glm::value_ptr(lightPos), 0.01f, -10.0f, 10.0f)) {
-					shader->SetUniform("u_LightPos", lightPos);
+					setLightValue("u_LightPos", lightPos);
 				}
 				if (ImGui::ColorPicker3("Light Col", glm::value_ptr(lightCol))) {
-					shader->SetUniform("u_LightCol", lightCol);
+					setLightValue("u_LightCol", lightCol);
 				}
 				if (ImGui::SliderFloat("Light Ambient Power", &lightAmbientPow, 0.0f, 1.0f)) {
-					shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
+					setLightValue("u_AmbientLightStrength", lightAmbientPow);
 				}
 				if (ImGui::SliderFloat("Light Specular Power", &lightSpecularPow, 0.0f, 1.0f)) {
-					shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
+					setLightValue("u_SpecularLightStrength", lightSpecularPow);
 				}
 				if (ImGui::DragFloat("Light Linear Falloff", &lightLinearFalloff, 0.01f, 0.0f, 1.0f)) {
-					shader->SetUniform("u_LightAttenuationLinear", lightLinearFalloff);
+					setLightValue("u_LightAttenuationLinear", lightLinearFalloff);
 				}
 				if (ImGui::DragFloat("Light Quadratic Falloff", &lightQuadraticFalloff, 0.01f, 0.0f, 1.0f)) {
-					shader->SetUniform("u_LightAttenuationQuadratic", lightQuadraticFalloff);
+					setLightValue("u_LightAttenuationQuadratic", lightQuadraticFalloff);
 				}
 			}
 
@@ -322,22 +397,29 @@ int main() {
 
 		#pragma endregion 
 
+		// Collects our renderers each frame, and draws the ones sharing a mesh and material together
+		RenderQueue::sptr renderQueue = RenderQueue::Create();
+		double renderCpuTime = 0.0;
+
 		// GL states
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_CULL_FACE);
-		glDepthFunc(GL_LEQUAL); // New 
+		GLState::SetEnabled(GL_DEPTH_TEST, true);
+		GLState::SetEnabled(GL_CULL_FACE, true);
+		GLState::DepthFunc(GL_LEQUAL); // New 
 
 		#pragma region TEXTURE LOADING
 
-		// Load some textures from files
-		Texture2D::sptr diffuse = Texture2D::LoadFromFile("images/Stone_001_Diffuse.png");
-		Texture2D::sptr diffuse2 = Texture2D::LoadFromFile("images/box.bmp");
-		Texture2D::sptr specular = Texture2D::LoadFromFile("images/Stone_001_Specular.png");
-		Texture2D::sptr reflectivity = Texture2D::LoadFromFile("images/box-reflections.bmp");
+		// Load some textures from files, these get decoded in the background and streamed in over the first few frames.
+		// Until then they're a flat grey, call textureStreamer->Wait() if you need them to be ready. If a texture has
+		// been compressed ahead of time (run with --compress), we load that instead
+		TextureStreamer::sptr textureStreamer = TextureStreamer::Create();
+		Texture2D::sptr diffuse = textureStreamer->LoadTexture2D(PreferCompressed("images/Stone_001_Diffuse.png"));
+		Texture2D::sptr diffuse2 = textureStreamer->LoadTexture2D(PreferCompressed("images/box.bmp"));
+		Texture2D::sptr specular = textureStreamer->LoadTexture2D(PreferCompressed("images/Stone_001_Specular.png"));
+		Texture2D::sptr reflectivity = textureStreamer->LoadTexture2D(PreferCompressed("images/box-reflections.bmp"));
 
 		// Load the cube map
 		//TextureCubeMap::sptr environmentMap = TextureCubeMap::LoadFromImages("images/cubemaps/skybox/sample.jpg");
-		TextureCubeMap::sptr environmentMap = TextureCubeMap::LoadFromImages("images/cubemaps/skybox/ocean.jpg"); 
+		TextureCubeMap::sptr environmentMap = textureStreamer->LoadCubeMap("images/cubemaps/skybox/ocean.jpg"); 
 
 		// Creating an empty texture
 		Texture2DDescription desc = Texture2DDescription();  
@@ -355,60 +437,41 @@ int main() {
 		
 		// We need to tell our scene system what extra component types we want to support
 		GameScene::RegisterComponentType<RendererComponent>();
-		GameScene::RegisterComponentType<BehaviourBinding>();
 		GameScene::RegisterComponentType<Camera>();
+		GameScene::RegisterComponentType<OccluderComponent>();
 
 		// Create a scene, and set it to be the active scene in the application
 		GameScene::sptr scene = GameScene::Create("test");
 		Application::Instance().ActiveScene = scene;
 
-		// We can create a group ahead of time to make iterating on the group faster
-		entt::basic_group<entt::entity, entt::exclude_t<>, entt::get_t<Transform>, RendererComponent> renderGroup =
-			scene->Registry().group<RendererComponent>(entt::get_t<Transform>());
+		// Hook up culling before any systems run, so renderers leave the BVH when they're destroyed
+		CullingSystem::Initialize(scene->Registry());
 
 		// Create a material and set some properties for it
 		ShaderMaterial::sptr material0 = ShaderMaterial::Create();  
-		material0->Shader = shader;
+		material0->SetShaderVariant(litShaders, LIGHTING);
+		setAllLightValues(material0);
 		material0->Set("s_Diffuse", diffuse);
 		material0->Set("s_Diffuse2", diffuse2);
 		material0->Set("s_Specular", specular);
 		material0->Set("u_Shininess", 8.0f);
 		material0->Set("u_TextureMix", 0.5f); 
 
-		// Load a second material for our reflective material!
-		Shader::sptr reflectiveShader = Shader::Create();
-		reflectiveShader->LoadShaderPartFromFile("shaders/vertex_shader.glsl", GL_VERTEX_SHADER);
-		reflectiveShader->LoadShaderPartFromFile("shaders/frag_reflection.frag.glsl", GL_FRAGMENT_SHADER);
-		reflectiveShader->Link();
-
-		Shader::sptr reflective = Shader::Create();
-		reflective->LoadShaderPartFromFile("shaders/vertex_shader.glsl", GL_VERTEX_SHADER);
-		reflective->LoadShaderPartFromFile("shaders/frag_blinn_phong_reflection.glsl", GL_FRAGMENT_SHADER);
-		reflective->Link();
-		
 		// 
 		ShaderMaterial::sptr material1 = ShaderMaterial::Create(); 
-		material1->Shader = reflective;
+		material1->SetShaderVariant(litShaders, LIGHTING | REFLECTIVE);
+		setAllLightValues(material1);
 		material1->Set("s_Diffuse", diffuse);
 		material1->Set("s_Diffuse2", diffuse2);
 		material1->Set("s_Specular", specular);
 		material1->Set("s_Reflectivity", reflectivity); 
 		material1->Set("s_Environment", environmentMap); 
-		material1->Set("u_LightPos", lightPos);
-		material1->Set("u_LightCol", lightCol);
-		material1->Set("u_AmbientLightStrength", lightAmbientPow); 
-		material1->Set("u_SpecularLightStrength", lightSpecularPow); 
-		material1->Set("u_AmbientCol", ambientCol);
-		material1->Set("u_AmbientStrength", ambientPow);
-		material1->Set("u_LightAttenuationConstant", 1.0f);
-		material1->Set("u_LightAttenuationLinear", lightLinearFalloff);
-		material1->Set("u_LightAttenuationQuadratic", lightQuadraticFalloff);
 		material1->Set("u_Shininess", 8.0f);
 		material1->Set("u_TextureMix", 0.5f);
 		material1->Set("u_EnvironmentRotation", glm::mat3(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1, 0, 0))));
 		
 		ShaderMaterial::sptr reflectiveMat = ShaderMaterial::Create();
-		reflectiveMat->Shader = reflectiveShader;
+		reflectiveMat->SetShaderVariant(litShaders, REFLECTIVE);
 		reflectiveMat->Set("s_Environment", environmentMap);
 		reflectiveMat->Set("u_EnvironmentRotation", glm::mat3(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1, 0, 0))));
 
@@ -429,8 +492,14 @@ int main() {
 
 		GameObject obj3 = scene->CreateEntity("monkey_tris");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/monkey.obj");
-			obj3.emplace<RendererComponent>().SetMesh(vao).SetMaterial(reflectiveMat);
+			// We'll generate some lower detail versions of this monkey to swap to as it gets further away
+			MeshBuilder<VertexPosNormTexCol> builder = ObjLoader::LoadMeshFromFile("models/monkey.obj");
+			const float radius = MeshSimplifier::CalculateBoundingRadius(builder);
+			RendererComponent& renderer = obj3.emplace<RendererComponent>();
+			renderer.SetMesh(builder.Bake()).SetMaterial(reflectiveMat).SetBoundingRadius(radius);
+			for (MeshSimplifier::SimplifiedMesh& lod : MeshSimplifier::GenerateLods(builder, { 0.5f, 0.25f })) {
+				renderer.AddLod(lod.Mesh.Bake(), MeshSimplifier::CalculateLodScreenSize(lod.Error, radius));
+			}
 			obj3.get<Transform>().SetLocalPosition(2.0f, 0.0f, 1.0f);
 			BehaviourBinding::BindDisabled<SimpleMoveBehaviour>(obj3);
 		}
@@ -457,7 +526,7 @@ int main() {
 			obj4.emplace<RendererComponent>().SetMesh(vao).SetMaterial(material0);
 			obj4.get<Transform>().SetLocalPosition(-2.0f, 0.0f, 1.0f);
 
-			// Bind returns a smart pointer to the behaviour that was added
+			// Bind returns a pointer to the behaviour that was added, which is only valid until the next behaviour of this type is bound
 			auto pathing = BehaviourBinding::Bind<FollowPathBehaviour>(obj4);
 			// Set up a path for the object to follow
 			pathing->Points.push_back({ -4.0f, -4.0f, 0.0f });
@@ -501,12 +570,6 @@ int main() {
 
 		/////////////////////////////////// SKYBOX ///////////////////////////////////////////////
 		{
-			// Load our shaders
-			Shader::sptr skybox = std::make_shared<Shader>();
-			skybox->LoadShaderPartFromFile("shaders/skybox-shader.vert.glsl", GL_VERTEX_SHADER);
-			skybox->LoadShaderPartFromFile("shaders/skybox-shader.frag.glsl", GL_FRAGMENT_SHADER);
-			skybox->Link();
-
 			ShaderMaterial::sptr skyboxMat = ShaderMaterial::Create();
 			skyboxMat->Shader = skybox;  
 			skyboxMat->Set("s_Environment", environmentMap);
@@ -520,7 +583,8 @@ int main() {
 			
 			GameObject skyboxObj = scene->CreateEntity("skybox");  
 			skyboxObj.get<Transform>().SetLocalPosition(0.0f, 0.0f, 0.0f);
-			skyboxObj.get_or_emplace<RendererComponent>().SetMesh(meshVao).SetMaterial(skyboxMat);
+			// The skybox is drawn around the camera, so it's mesh being out of view doesn't mean the sky is
+			skyboxObj.get_or_emplace<RendererComponent>().SetMesh(meshVao).SetMaterial(skyboxMat).SetNeverCulled(true);
 		}
 		////////////////////////////////////////////////////////////////////////////////////////
 
@@ -558,6 +622,126 @@ int main() {
 				});
 		}
 		
+		// Some debug info and a stress test for the renderer, which spawns a grid of props from a prefab sharing a mesh and material
+		entt::entity stressPrefab = entt::null;
+		imGuiCallbacks.push_back([&]() {
+			if (ImGui::CollapsingHeader("Renderer")) {
+				bool instancing = renderQueue->IsInstancingEnabled();
+				if (ImGui::Checkbox("Instanced Batching", &instancing)) {
+					renderQueue->SetInstancingEnabled(instancing);
+				}
+				const RenderQueue::Stats& stats = renderQueue->GetStats();
+				ImGui::Text("Objects: %d Draw Calls: %d", (int)stats.Objects, (int)stats.DrawCalls);
+				ImGui::Text("Shader Changes: %d Material Changes: %d", (int)stats.ShaderChanges, (int)stats.MaterialChanges);
+				ImGui::Text("Draw Order: %s", stats.Resorted ? "Re-sorted" : "Reused");
+				ImGui::Text("CPU Render Time: %.3f ms", renderCpuTime * 1000.0);
+				ImGui::Text("Shader Startup: %.2f ms (%d/%d from cache)", shaderTime * 1000.0, cachedShaders, (int)allShaders.size());
+				ImGui::Text("Lit Shader Programs: %d", (int)litShaders->GetProgramCount());
+				const GLState::Stats& glStats = GLState::GetStats();
+				ImGui::Text("GL State Changes: %d Elided: %d", (int)glStats.Issued, (int)glStats.Elided);
+				if (ImGui::Button("Spawn 10k Props")) {
+					if (stressPrefab == entt::null) {
+						entt::registry& prefabs = GameScene::Prefabs();
+						stressPrefab = prefabs.create();
+						prefabs.emplace<Transform>(stressPrefab, entt::handle(prefabs, stressPrefab));
+						prefabs.emplace<GameObjectTag>(stressPrefab, "stress_prop");
+						prefabs.emplace<RendererComponent>(stressPrefab).SetMesh(ObjLoader::LoadFromFile("models/monkey.obj")).SetMaterial(reflectiveMat);
+					}
+					const std::vector<entt::entity> props = scene->CreateEntities(stressPrefab, 10000);
+					for (size_t ix = 0; ix < props.size(); ix++) {
+						scene->Registry().get<Transform>(props[ix]).SetLocalPosition((ix % 100) * 1.5f - 75.0f, (ix / 100) * 1.5f - 75.0f, -2.0f);
+					}
+				}
+				const BehaviourSystem::Stats& behaviourStats = BehaviourSystem::GetStats();
+				ImGui::Text("Behaviours: %d (%d types) Update: %.3f ms", (int)behaviourStats.Behaviours, (int)behaviourStats.Types, behaviourStats.UpdateMs);
+				bool culling = CullingSystem::IsEnabled(scene->Registry());
+				if (ImGui::Checkbox("Frustum Culling", &culling)) {
+					CullingSystem::SetEnabled(scene->Registry(), culling);
+				}
+				bool occlusion = CullingSystem::IsOcclusionEnabled(scene->Registry());
+				if (ImGui::Checkbox("Occlusion Culling", &occlusion)) {
+					CullingSystem::SetOcclusionEnabled(scene->Registry(), occlusion);
+				}
+				const CullingSystem::Stats& cullStats = CullingSystem::GetStats(scene->Registry());
+				ImGui::Text("Visible: %d/%d Nodes Tested: %d Tree Height: %d", (int)cullStats.Visible, (int)cullStats.Renderers, (int)cullStats.NodesTested, cullStats.TreeHeight);
+				ImGui::Text("Cull: %.3f ms BVH Update: %.3f ms (%d moved)", cullStats.CullMs, cullStats.UpdateMs, (int)cullStats.ProxiesMoved);
+				const size_t occlusionTested = cullStats.Visible + cullStats.Occluded;
+				ImGui::Text("Occluded: %d (%.1f%%) Occluders: %d (%d tris) Occlusion: %.3f ms", (int)cullStats.Occluded,
+					occlusionTested > 0 ? 100.0 * cullStats.Occluded / occlusionTested : 0.0, (int)cullStats.Occluders, (int)cullStats.OccluderTriangles, cullStats.OcclusionMs);
+				const TextureStreamer::Stats& textureStats = textureStreamer->GetStats();
+				ImGui::Text("Textures: %d loading, %d loaded, Upload: %d KB in %.3f ms", (int)textureStats.Pending, (int)textureStats.Completed,
+					(int)(textureStats.FrameUploadBytes / 1024), textureStats.FrameMs);
+			}
+		});
+
+		///////////////////////////////////// Systems //////////////////////////////////////////////////
+		#pragma region Systems
+
+		// Behaviours can read input and bind new behaviours, so they run by themselves on the main thread
+		scene->Systems().AddSystem("Behaviours", SystemScheduler::Read<>(), SystemScheduler::Write<Transform>(),
+			[](entt::registry& registry) {
+				BehaviourSystem::Update(registry);
+			}, SystemScheduler::MainThread | SystemScheduler::Exclusive);
+
+		// Update all world matrices for this frame
+		scene->Systems().AddSystem("World Transforms", SystemScheduler::Read<>(), SystemScheduler::Write<Transform>(),
+			[](entt::registry& registry) {
+				TransformSystem::UpdateWorldMatrices(registry);
+			});
+
+		// Point the cameras' view matrices at where their objects ended up, the later systems and the draws read them from there
+		scene->Systems().AddSystem("Camera View", SystemScheduler::Read<Transform>(), SystemScheduler::Write<Camera>(),
+			[](entt::registry& registry) {
+				registry.view<Camera, Transform>().each([](Camera& camera, const Transform& transform) {
+					camera.SetView(glm::inverse(transform.WorldTransform()));
+				});
+			});
+
+		// Refit the BVH for anything that moved, and find what the camera can see. Update adds culling proxies to new
+		// renderers, which changes the registry's structure, so this has to run by itself
+		scene->Systems().AddSystem("Culling", SystemScheduler::Read<Transform, RendererComponent, OccluderComponent, Camera>(), SystemScheduler::Write<CullingProxy>(),
+			[&](entt::registry& registry) {
+				// We don't use GetViewProjection here, since it caches the result and other systems may be reading the camera
+				const Camera& camera = registry.get<Camera>(cameraObject.entity());
+				CullingSystem::Update(registry);
+				CullingSystem::Cull(registry, camera.GetProjection() * camera.GetView());
+			}, SystemScheduler::Exclusive);
+
+		// Queue up all our visible renderers, the queue will take care of sorting and batching them. Submitting a renderer
+		// updates the sort key that it caches, so this writes to the renderers. The render queue isn't a component, so the
+		// scheduler can't track it, this has to stay the only system that touches it (it's flushed once all systems are done)
+		scene->Systems().AddSystem("Render Submit", SystemScheduler::Read<Transform, CullingProxy, Camera>(), SystemScheduler::Write<RendererComponent>(),
+			[&](entt::registry& registry) {
+				const glm::vec3 camPos = registry.get<Transform>(cameraObject.entity()).WorldTransform()[3];
+				const Camera& camera = registry.get<Camera>(cameraObject.entity());
+				const glm::mat4& projection = camera.GetProjection();
+				const bool isOrtho = camera.GetIsOrtho();
+
+				for (entt::entity entity : CullingSystem::GetVisible(registry)) {
+					RendererComponent& renderer = registry.get<RendererComponent>(entity);
+					const Transform& transform = registry.get<Transform>(entity);
+					// Pick a lower detail version of the mesh if it's small enough on screen
+					const VertexArrayObject::sptr& mesh = renderer.Lods.empty() ? renderer.Mesh :
+						renderer.GetMeshForScreenSize(CalculateScreenSize(renderer, transform, camPos, projection, isOrtho));
+					const float viewDepth = glm::length(glm::vec3(transform.WorldTransform()[3]) - camPos);
+					renderQueue->Submit(renderer, mesh, transform, viewDepth);
+				}
+			});
+
+		imGuiCallbacks.push_back([&]() {
+			if (ImGui::CollapsingHeader("Systems")) {
+				const SystemScheduler& systems = scene->Systems();
+				ImGui::Text("Frame: %.3f ms", systems.GetFrameMs());
+				for (const SystemScheduler::SystemTiming& timing : systems.GetTimings()) {
+					ImGui::Text("%s: %.3f ms (at %.3f ms, %s)", timing.Name.c_str(), timing.DurationMs, timing.StartMs,
+						timing.OnMainThread ? "main thread" : "worker");
+				}
+			}
+		});
+
+		#pragma endregion
+		//////////////////////////////////////////////////////////////////////////////////////////
+
 		InitImGui();
 
 		// Initialize our timing instance and grab a reference for our use
@@ -590,80 +774,40 @@ int main() {
 				}
 			}
 
-			// Iterate over all the behaviour binding components
-			scene->Registry().view<BehaviourBinding>().each([&](entt::entity entity, BehaviourBinding& binding) {
-				// Iterate over all the behaviour scripts attached to the entity, and update them in sequence (if enabled)
-				for (const auto& behaviour : binding.Behaviours) {
-					if (behaviour->Enabled) {
-						behaviour->Update(entt::handle(scene->Registry(), entity));
-					}
-				}
-			});
+			// Upload whatever textures have finished decoding, up to this frame's upload budget
+			textureStreamer->Update();
+
+			// Run the behaviours, transforms and render submission, the scheduler overlaps anything that doesn't conflict
+			scene->RunSystems();
 
 			// Clear the screen
 			glClearColor(0.08f, 0.17f, 0.31f, 1.0f);
-			glEnable(GL_DEPTH_TEST);
+			GLState::SetEnabled(GL_DEPTH_TEST, true);
 			glClearDepth(1.0f);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			// Update all world matrices for this frame
-			scene->Registry().view<Transform>().each([](entt::entity entity, Transform& t) {
-				t.UpdateWorldMatrix();
-			});
-			
-			// Grab out camera info from the camera object
-			Transform& camTransform = cameraObject.get<Transform>();
-			glm::mat4 view = glm::inverse(camTransform.LocalTransform());
-			glm::mat4 projection = cameraObject.get<Camera>().GetProjection();
-			glm::mat4 viewProjection = projection * view;
-						
-			// Sort the renderers by shader and material, we will go for a minimizing context switches approach here,
-			// but you could for instance sort front to back to optimize for fill rate if you have intensive fragment shaders
-			renderGroup.sort<RendererComponent>([](const RendererComponent& l, const RendererComponent& r) {
-				// Sort by render layer first, higher numbers get drawn last
-				if (l.Material->RenderLayer < r.Material->RenderLayer) return true;
-				if (l.Material->RenderLayer > r.Material->RenderLayer) return false;
-
-				// Sort by shader pointer next (so materials using the same shader run sequentially where possible)
-				if (l.Material->Shader < r.Material->Shader) return true;
-				if (l.Material->Shader > r.Material->Shader) return false;
-
-				// Sort by material pointer last (so we can minimize switching between materials)
-				if (l.Material < r.Material) return true;
-				if (l.Material > r.Material) return false;
-				
-				return false;
+			// The queue was filled by the render submit system, the draws themselves need the GL context
+			const double renderStart = glfwGetTime();
+			const Camera& camera = cameraObject.get<Camera>();
+			renderQueue->Flush([&](const Shader::sptr& shader) {
+				SetupShaderForFrame(shader, camera.GetView(), camera.GetProjection());
 			});
+			renderCpuTime = glfwGetTime() - renderStart;
 
-			// Start by assuming no shader or material is applied
-			Shader::sptr current = nullptr;
-			ShaderMaterial::sptr currentMat = nullptr;
-
-			// Iterate over the render group components and draw them
-			renderGroup.each( [&](entt::entity e, RendererComponent& renderer, Transform& transform) {
-				// If the shader has changed, set up it's uniforms
-				if (current != renderer.Material->Shader) {
-					current = renderer.Material->Shader;
-					current->Bind();
-					SetupShaderForFrame(current, view, projection);
-				}
-				// If the material has changed, apply it
-				if (currentMat != renderer.Material) {
-					currentMat = renderer.Material;
-					currentMat->Apply();
-				}
-				// Render the mesh
-				RenderVAO(renderer.Material->Shader, renderer.Mesh, viewProjection, transform);
-			});
-
-			// Draw our ImGui content
+			// Draw our ImGui content, it changes GL state without going through GLState so we need to forget what we know
 			RenderImGui();
+			GLState::Invalidate();
+			GLState::EndFrame();
 
 			scene->Poll();
 			glfwSwapBuffers(window);
 			time.LastFrame = time.CurrentFrame;
 		}
 
+		// The prefab registry is static, so we need to let go of the stress test's mesh and material while we still have a context
+		if (stressPrefab != entt::null) {
+			GameScene::Prefabs().destroy(stressPrefab);
+		}
 		// Nullify scene so that we can release references
 		Application::Instance().ActiveScene = nullptr;
 		ShutdownImGui();